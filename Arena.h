@@ -0,0 +1,110 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <memory_resource>
+#include <optional>
+#include <ostream>
+#include <vector>
+using namespace std;
+
+//pass-through memory resource that counts what goes through it
+class Counting_Resource : public pmr::memory_resource {
+    pmr::memory_resource* upstream;
+
+public:
+    size_t allocations = 0;
+    size_t deallocations = 0;
+    size_t bytes = 0;
+
+    explicit Counting_Resource(pmr::memory_resource* upstream = pmr::new_delete_resource())
+        : upstream(upstream) {}
+
+    void set_upstream(pmr::memory_resource* resource) {
+        upstream = resource;
+    }
+
+    void clear() {
+        allocations = 0;
+        deallocations = 0;
+        bytes = 0;
+    }
+
+private:
+    void* do_allocate(size_t size, size_t alignment) override {
+        allocations++;
+        bytes += size;
+        return upstream->allocate(size, alignment);
+    }
+
+    void do_deallocate(void* p, size_t size, size_t alignment) override {
+        deallocations++;
+        upstream->deallocate(p, size, alignment);
+    }
+
+    bool do_is_equal(const pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+//memory for one compilation: tokens, symbol table, instruction table and the
+//parser stacks all allocate from here and are released together by reset()
+//with the arena disabled every request goes straight to the global heap
+class Compilation_Arena {
+    bool enabled;
+    vector<byte> firstChunk;      //reused across compilations, grown to the largest one seen
+    Counting_Resource heap;       //chunks the arena takes from the global heap
+    optional<pmr::monotonic_buffer_resource> arena;
+    Counting_Resource requests;   //allocations made by the compiler
+
+    void start() {
+        arena.emplace(firstChunk.data(), firstChunk.size(), &heap);
+    }
+
+public:
+    explicit Compilation_Arena(bool enabled, size_t initialSize = 64 * 1024)
+        : enabled(enabled),
+          firstChunk(enabled ? initialSize : 0) {
+        if (enabled) {
+            start();
+            requests.set_upstream(&*arena);
+        }
+    }
+
+    Compilation_Arena(const Compilation_Arena&) = delete;
+    Compilation_Arena& operator=(const Compilation_Arena&) = delete;
+
+    pmr::memory_resource* resource() {
+        return &requests;
+    }
+
+    //frees everything allocated since the last reset in one step
+    //nothing allocated from the arena may be used afterwards
+    void reset() {
+        if (enabled) {
+            size_t used = firstChunk.size() + heap.bytes;
+            arena->release();
+            if (used > firstChunk.size()) {
+                firstChunk = vector<byte>(used);
+            }
+            start();
+        }
+        heap.clear();
+        requests.clear();
+    }
+
+    //what went through resource(), the chunks the arena took for it and
+    //heapAllocations, every operator new of the compilation (main.cpp
+    //counts them), which also covers memory the compiler does not route here
+    void write_stats(ostream& out, size_t heapAllocations) const {
+        out << "arena-routed allocations: " << requests.allocations
+            << "\tbytes: " << requests.bytes;
+        if (enabled) {
+            out << "\tarena chunks: " << heap.allocations
+                << "\tfirst chunk: " << firstChunk.size();
+        }
+        out << "\theap allocations: " << heapAllocations << "\n";
+    }
+};
+
+#endif
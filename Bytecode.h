@@ -0,0 +1,398 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Type.h"
+#include "Instruction.h"
+#include "Listing.h"
+#include "Instruction_Sink.h"
+#ifdef _WIN32
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+// ---- file format -----------------------------------------------------------
+//a header followed by sections, each starting on an 8 byte boundary
+//records are stored in the host's byte order (checked through byteOrder) and
+//layout, so a mapped file is used in place: the code section is an array of
+//Instruction, the constant section an array of int64_t
+//names are offsets into the string section, which holds NUL terminated names
+//the debug section is optional (count 0), it gives for each instruction the
+//index of the token it was generated from (the lexer does not track lines)
+
+inline constexpr char BYTECODE_MAGIC[8] = { 'R', 'A', 'T', '2', '5', 'S', 'B', 'C' };
+inline constexpr uint32_t BYTECODE_VERSION = 7;
+inline constexpr uint32_t BYTECODE_BYTE_ORDER = 0x01020304;
+
+struct Bytecode_Section {
+    uint32_t offset; //from the start of the file
+    uint32_t count;  //records
+};
+
+struct Bytecode_Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    Bytecode_Section code;      //Instruction
+    Bytecode_Section constants; //int64_t
+    Bytecode_Section symbols;   //Bytecode_Symbol, in listing order
+    Bytecode_Section functions; //Bytecode_Function
+    Bytecode_Section strings;   //char
+    Bytecode_Section debug;     //uint32_t token index per instruction
+    int64_t stackDepth;         //operand stack entries the program needs (see write_stack_listing())
+};
+
+struct Bytecode_Symbol {
+    uint32_t name;
+    int32_t address; //frame slot for a local
+    uint8_t type;    //Type
+    uint8_t local;
+    uint16_t reserved;
+};
+
+struct Bytecode_Function {
+    uint32_t name;
+    int32_t entry; //instruction address
+};
+
+static_assert(sizeof(Bytecode_Header) == 72);
+static_assert(sizeof(Bytecode_Symbol) == 12 && sizeof(Bytecode_Function) == 8);
+static_assert(offsetof(Instruction, Operator) == 0 && offsetof(Instruction, hasOperand) == 1 &&
+              offsetof(Instruction, Operand) == 4, "the code section is laid out as Instruction");
+
+//collects the tables of a program and writes them as one bytecode file
+class Bytecode_Writer {
+    vector<Instruction> code;
+    vector<int64_t> constants;
+    vector<Bytecode_Symbol> symbols;
+    vector<Bytecode_Function> functions;
+    string strings;
+    vector<uint32_t> debug;
+    long stackDepth = STACK_NOT_VERIFIED;
+
+    uint32_t add_string(string_view name) {
+        uint32_t offset = strings.size();
+        strings.append(name);
+        strings.push_back('\0');
+        return offset;
+    }
+
+    //appends count records of size bytes at the next 8 byte boundary, file
+    //holds the bytes from offset base on
+    static Bytecode_Section append(string& file, size_t base, const void* records, size_t count, size_t size) {
+        file.resize(((base + file.size() + 7) & ~size_t(7)) - base, '\0');
+        Bytecode_Section section{uint32_t(base + file.size()), uint32_t(count)};
+        file.append(static_cast<const char*>(records), count * size);
+        return section;
+    }
+
+public:
+    void set_code(span<const Instruction> instructions) {
+        code.assign(instructions.begin(), instructions.end());
+    }
+
+    void set_constants(span<const int64_t> values) {
+        constants.assign(values.begin(), values.end());
+    }
+
+    //one token index per instruction, or none
+    void set_debug(span<const uint32_t> tokens) {
+        debug.assign(tokens.begin(), tokens.end());
+    }
+
+    void set_stack_depth(long depth) {
+        stackDepth = depth;
+    }
+
+    void add_symbol(string_view name, int address, Type type, bool local) {
+        symbols.push_back({add_string(name), address, uint8_t(type), uint8_t(local), 0});
+    }
+
+    void add_function(string_view name, int entry) {
+        functions.push_back({add_string(name), entry});
+    }
+
+    //code records, copied field by field so the padding is always 0
+    static vector<char> pack(span<const Instruction> code) {
+        vector<char> packed(code.size() * sizeof(Instruction), '\0');
+        for (size_t i = 0; i < code.size(); i++) {
+            char* record = packed.data() + i * sizeof(Instruction);
+            record[offsetof(Instruction, Operator)] = char(code[i].Operator);
+            record[offsetof(Instruction, hasOperand)] = code[i].hasOperand;
+            memcpy(record + offsetof(Instruction, Operand), &code[i].Operand, sizeof(int32_t));
+        }
+        return packed;
+    }
+
+    void write(ostream& out) const {
+        vector<char> packed = pack(code);
+        string file(sizeof(Bytecode_Header), '\0');
+        Bytecode_Header header = layout(file, 0, packed.data(), code.size());
+        memcpy(file.data(), &header, sizeof(header));
+        out.write(file.data(), file.size());
+    }
+
+    //out already holds the header space and codeCount instructions written by a
+    //Bytecode_Sink, the other sections are appended and the header filled in
+    void finish(ostream& out, size_t codeCount) const {
+        string file;
+        Bytecode_Header header = layout(file, sizeof(Bytecode_Header) + codeCount * sizeof(Instruction), nullptr, codeCount);
+        out.seekp(0, ios::end);
+        out.write(file.data(), file.size());
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.seekp(0, ios::end);
+    }
+
+private:
+    //appends the sections to file (the bytes from offset base on), code is
+    //nullptr when the code section is already in place after the header
+    Bytecode_Header layout(string& file, size_t base, const char* code, size_t codeCount) const {
+        Bytecode_Header header{};
+        if (code) {
+            header.code = append(file, base, code, codeCount, sizeof(Instruction));
+        }
+        else {
+            header.code = {uint32_t(sizeof(Bytecode_Header)), uint32_t(codeCount)};
+        }
+        header.constants = append(file, base, constants.data(), constants.size(), sizeof(int64_t));
+        header.symbols = append(file, base, symbols.data(), symbols.size(), sizeof(Bytecode_Symbol));
+        header.functions = append(file, base, functions.data(), functions.size(), sizeof(Bytecode_Function));
+        header.strings = append(file, base, strings.data(), strings.size(), 1);
+        header.debug = append(file, base, debug.data(), debug.size(), sizeof(uint32_t));
+        if (base + file.size() > UINT32_MAX) {
+            throw runtime_error("Program too large for a bytecode file");
+        }
+
+        memcpy(header.magic, BYTECODE_MAGIC, sizeof(header.magic));
+        header.version = BYTECODE_VERSION;
+        header.byteOrder = BYTECODE_BYTE_ORDER;
+        header.stackDepth = stackDepth;
+        return header;
+    }
+};
+
+//the code section of a bytecode file, written as the program is generated
+//records have a fixed size, so a patch is a positioned write
+//Bytecode_Writer::finish() adds the rest of the file
+class Bytecode_Sink : public Instruction_Sink {
+    ostream& out;
+
+    static streamoff offset(size_t index) {
+        return streamoff(sizeof(Bytecode_Header) + index * sizeof(Instruction));
+    }
+
+public:
+    explicit Bytecode_Sink(ostream& out) : out(out) {
+        Bytecode_Header header{};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+
+    void write(size_t index, span<const Instruction> code) override {
+        vector<char> packed = Bytecode_Writer::pack(code);
+        out.seekp(offset(index));
+        out.write(packed.data(), packed.size());
+    }
+
+    bool can_patch() const override {
+        return true;
+    }
+
+    void patch(size_t index, const Instruction& instr) override {
+        vector<char> packed = Bytecode_Writer::pack(span<const Instruction>(&instr, 1));
+        streampos end = out.tellp();
+        out.seekp(offset(index));
+        out.write(packed.data(), packed.size());
+        out.seekp(end);
+    }
+};
+
+//a bytecode file mapped read-only (read into memory where mmap is not available)
+//the sections are checked once when it is opened and then used in place
+class Bytecode_Image {
+    const char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    vector<uint64_t> buffer; //8 byte aligned copy of the file
+#endif
+
+    const Bytecode_Header& header() const {
+        return *reinterpret_cast<const Bytecode_Header*>(data);
+    }
+
+    template <typename Record>
+    span<const Record> section(const Bytecode_Section& section) const {
+        return span<const Record>(reinterpret_cast<const Record*>(data + section.offset), section.count);
+    }
+
+    void check_section(const Bytecode_Section& section, size_t recordSize) const {
+        if (section.offset % 8 != 0 || section.offset < sizeof(Bytecode_Header) ||
+            section.offset > size || section.count > (size - section.offset) / recordSize) {
+            throw runtime_error("Corrupt bytecode file: section out of bounds");
+        }
+    }
+
+    void check() const {
+        if (size < sizeof(Bytecode_Header) || memcmp(header().magic, BYTECODE_MAGIC, sizeof(BYTECODE_MAGIC)) != 0) {
+            throw runtime_error("Not a Rat25S bytecode file");
+        }
+        if (header().version != BYTECODE_VERSION) {
+            throw runtime_error("Unsupported bytecode version " + to_string(header().version));
+        }
+        if (header().byteOrder != BYTECODE_BYTE_ORDER) {
+            throw runtime_error("Bytecode file was written with another byte order");
+        }
+        check_section(header().code, sizeof(Instruction));
+        check_section(header().constants, sizeof(int64_t));
+        check_section(header().symbols, sizeof(Bytecode_Symbol));
+        check_section(header().functions, sizeof(Bytecode_Function));
+        check_section(header().strings, 1);
+        check_section(header().debug, sizeof(uint32_t));
+
+        const Bytecode_Section& strings = header().strings;
+        if (strings.count > 0 && data[strings.offset + strings.count - 1] != '\0') {
+            throw runtime_error("Corrupt bytecode file: unterminated string section");
+        }
+        for (const auto& symbol : symbols()) {
+            if (symbol.name >= strings.count || symbol.type > Type::REAL) {
+                throw runtime_error("Corrupt bytecode file: bad symbol");
+            }
+        }
+        for (const auto& function : functions()) {
+            if (function.name >= strings.count) {
+                throw runtime_error("Corrupt bytecode file: bad function");
+            }
+        }
+        if (header().debug.count != 0 && header().debug.count != header().code.count) {
+            throw runtime_error("Corrupt bytecode file: debug table does not match the code");
+        }
+
+        //the bytes must be valid Instruction values before they are used as such
+        const char* code = data + header().code.offset;
+        for (size_t i = 0; i < header().code.count; i++) {
+            const char* record = code + i * sizeof(Instruction);
+            if (uint8_t(record[offsetof(Instruction, Operator)]) >= OPCODE_COUNT ||
+                uint8_t(record[offsetof(Instruction, hasOperand)]) > 1) {
+                throw runtime_error("Corrupt bytecode file: bad instruction " + to_string(i + 1));
+            }
+        }
+    }
+
+public:
+    explicit Bytecode_Image(const string& path) {
+#ifdef _WIN32
+        ifstream in(path, ios::binary);
+        if (!in) {
+            throw runtime_error("Cannot open bytecode file " + path);
+        }
+        string bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+        buffer.resize((bytes.size() + 7) / 8);
+        memcpy(buffer.data(), bytes.data(), bytes.size());
+        data = reinterpret_cast<const char*>(buffer.data());
+        size = bytes.size();
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw runtime_error("Cannot open bytecode file " + path);
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            close(fd);
+            throw runtime_error("Not a Rat25S bytecode file");
+        }
+        size = info.st_size;
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            throw runtime_error("Cannot map bytecode file " + path);
+        }
+        data = static_cast<const char*>(mapped);
+#endif
+        try {
+            check();
+        }
+        catch (...) {
+            release();
+            throw;
+        }
+    }
+
+    ~Bytecode_Image() {
+        release();
+    }
+
+    Bytecode_Image(const Bytecode_Image&) = delete;
+    Bytecode_Image& operator=(const Bytecode_Image&) = delete;
+
+    span<const Instruction> code() const {
+        return section<Instruction>(header().code);
+    }
+
+    span<const int64_t> constants() const {
+        return section<int64_t>(header().constants);
+    }
+
+    span<const Bytecode_Symbol> symbols() const {
+        return section<Bytecode_Symbol>(header().symbols);
+    }
+
+    span<const Bytecode_Function> functions() const {
+        return section<Bytecode_Function>(header().functions);
+    }
+
+    //empty when the file has no debug table
+    span<const uint32_t> debug() const {
+        return section<uint32_t>(header().debug);
+    }
+
+    const char* name(uint32_t offset) const {
+        return data + header().strings.offset + offset;
+    }
+
+    long stack_depth() const {
+        return header().stackDepth;
+    }
+
+    //the same listing display_RPD() writes for the program
+    void disassemble(ostream& out) const {
+        write_instruction_listing(out, code());
+        write_stack_listing(out, stack_depth());
+        vector<char> reals(constants().size(), 0);
+        for (const Instruction& instr : code()) {
+            if (instr.Operator == Opcode::PUSHF && size_t(instr.Operand) < reals.size()) {
+                reals[instr.Operand] = 1;
+            }
+        }
+        write_constant_listing(out, constants(), reals);
+        write_symbol_listing_header(out);
+        for (const auto& symbol : symbols()) {
+            write_symbol_row(out, name(symbol.name), symbol.local, symbol.address, Type(symbol.type));
+        }
+    }
+
+private:
+    void release() {
+#ifndef _WIN32
+        if (data) {
+            munmap(const_cast<char*>(data), size);
+        }
+#endif
+        data = nullptr;
+    }
+};
+
+#endif
@@ -0,0 +1,344 @@
+#ifndef CFG_H
+#define CFG_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory_resource>
+#include <ostream>
+#include <vector>
+#include "Instruction.h"
+using namespace std;
+
+//basic blocks of an instruction table and the jumps between them
+//a block starts at an entry, at a jump target or after a jump or RET and
+//ends before the next start
+//the entries are the roots: address 1 and every function's ENTER (a CALL
+//returns to the instruction after it, so it does not end a block)
+//dominators are computed over a virtual root above all entries
+class Control_Flow_Graph {
+public:
+    static constexpr int ROOT = -1;        //idom of an entry block
+    static constexpr int UNREACHABLE = -2; //idom of a block no entry reaches
+
+    struct Block {
+        size_t begin;            //first instruction index
+        size_t end;              //one past the last
+        vector<int> successors;  //falling through first, then the jump target
+        vector<int> predecessors;
+        int idom = UNREACHABLE;
+        bool entry = false;
+    };
+
+    //a natural loop laid out as the contiguous blocks header..last
+    struct Loop {
+        int header; //first block, where the back edges go
+        int last;   //last block
+    };
+
+private:
+    vector<Block> blockList;
+    vector<int> blockOf; //instruction index -> block
+    vector<int> order;   //reachable blocks in reverse postorder
+
+public:
+    //entries are instruction addresses (1-based)
+    Control_Flow_Graph(const pmr::vector<Instruction>& code, const vector<int>& entries) {
+        split(code, entries);
+        connect(code);
+        number();
+        dominators();
+    }
+
+    const vector<Block>& blocks() const {
+        return blockList;
+    }
+
+    const Block& operator[](int block) const {
+        return blockList[block];
+    }
+
+    size_t size() const {
+        return blockList.size();
+    }
+
+    int block_of(size_t index) const {
+        return blockOf[index];
+    }
+
+    //reachable blocks, each one after all of its dominators
+    const vector<int>& reverse_postorder() const {
+        return order;
+    }
+
+    bool reachable(int block) const {
+        return blockList[block].idom != UNREACHABLE;
+    }
+
+    //every path from an entry to b goes through a (a block dominates itself)
+    bool dominates(int a, int b) const {
+        if (!reachable(a) || !reachable(b)) {
+            return false;
+        }
+        while (b != a && b != ROOT) {
+            b = blockList[b].idom;
+        }
+        return b == a;
+    }
+
+    //an edge to a block that dominates its source closes a loop
+    bool is_back_edge(int from, int to) const {
+        return dominates(to, from);
+    }
+
+    //natural loops that are a contiguous run of blocks entered only by falling
+    //into the header from the block before it (e.g. every while), so code put
+    //in front of the header runs once each time the loop is entered
+    //in reverse postorder of their headers, outer loops first
+    vector<Loop> loops(const pmr::vector<Instruction>& code) const {
+        vector<Loop> found;
+        //only an edge going back in reverse postorder can be a back edge,
+        //which saves walking up the dominator tree for every edge
+        vector<int> position(blockList.size(), -1);
+        for (size_t k = 0; k < order.size(); k++) {
+            position[order[k]] = k;
+        }
+        auto back_edge = [&](int from, int to) {
+            return position[from] >= position[to] && is_back_edge(from, to);
+        };
+
+        vector<char> inside(blockList.size(), 0);
+        vector<int> marked;
+        for (int header : order) {
+            const Block& block = blockList[header];
+            int last = -1;
+            for (int predecessor : block.predecessors) {
+                if (back_edge(predecessor, header)) {
+                    last = max(last, predecessor);
+                }
+            }
+            if (last < header || block.entry || header == 0) {
+                continue;
+            }
+
+            //every block the back edges reach without going through the
+            //header, which must be exactly header..last
+            for (int b : marked) {
+                inside[b] = 0;
+            }
+            marked.assign(1, header);
+            inside[header] = 1;
+            vector<int> work;
+            for (int predecessor : block.predecessors) {
+                if (back_edge(predecessor, header) && !inside[predecessor]) {
+                    inside[predecessor] = 1;
+                    marked.push_back(predecessor);
+                    work.push_back(predecessor);
+                }
+            }
+            bool contiguous = true;
+            while (!work.empty() && contiguous) {
+                int b = work.back();
+                work.pop_back();
+                contiguous = b >= header && b <= last;
+                for (int predecessor : blockList[b].predecessors) {
+                    if (!inside[predecessor]) {
+                        inside[predecessor] = 1;
+                        marked.push_back(predecessor);
+                        work.push_back(predecessor);
+                    }
+                }
+            }
+            if (!contiguous || marked.size() != size_t(last - header + 1)) {
+                continue;
+            }
+
+            bool fallsIn = true;
+            for (int predecessor : block.predecessors) {
+                if (inside[predecessor]) {
+                    continue;
+                }
+                const Instruction& tail = code[blockList[predecessor].end - 1];
+                bool jumpsIn = jump(tail.Operator) && size_t(tail.Operand) == block.begin + 1;
+                fallsIn = fallsIn && predecessor == header - 1 && !jumpsIn;
+            }
+            if (fallsIn) {
+                found.push_back({header, last});
+            }
+        }
+        return found;
+    }
+
+    //Graphviz digraph, one box per block listing its instructions
+    //the taken edge of a JMP0 is labelled 0 and that of a JMP1 1, unreachable
+    //blocks are dashed
+    void write_dot(ostream& out, const pmr::vector<Instruction>& code) const {
+        out << "digraph cfg {\n";
+        out << "    node [shape=box, fontname=\"monospace\"];\n";
+        for (size_t b = 0; b < blockList.size(); b++) {
+            const Block& block = blockList[b];
+            out << "    B" << b << " [label=\"B" << b << (block.entry ? " (entry)" : "") << "\\l";
+            for (size_t i = block.begin; i < block.end; i++) {
+                out << i + 1 << "  " << opcode_name(code[i].Operator);
+                if (code[i].hasOperand) {
+                    out << " " << code[i].Operand;
+                }
+                out << "\\l";
+            }
+            out << "\"" << (reachable(b) ? "" : ", style=dashed") << "];\n";
+        }
+        for (size_t b = 0; b < blockList.size(); b++) {
+            const Block& block = blockList[b];
+            const Instruction& last = code[block.end - 1];
+            for (size_t s = 0; s < block.successors.size(); s++) {
+                out << "    B" << b << " -> B" << block.successors[s];
+                bool taken = is_branch(last.Operator) && s + 1 == block.successors.size() && block.successors.size() == 2;
+                out << (taken ? (last.Operator == Opcode::JMP0 ? " [label=\"0\"]" : " [label=\"1\"]") : "") << ";\n";
+            }
+        }
+        out << "}\n";
+    }
+
+private:
+    //index of the instruction a jump goes to, -1 when it has no target in the table
+    static long target(const pmr::vector<Instruction>& code, const Instruction& instr) {
+        if (!instr.hasOperand || instr.Operand < 1 || size_t(instr.Operand) > code.size()) {
+            return -1;
+        }
+        return instr.Operand - 1;
+    }
+
+    static bool jump(Opcode op) {
+        return op == Opcode::JMP || is_branch(op);
+    }
+
+    void split(const pmr::vector<Instruction>& code, const vector<int>& entries) {
+        vector<char> starts(code.size() + 1, 0);
+        vector<char> isEntry(code.size() + 1, 0);
+        starts[0] = 1;
+        for (int address : entries) {
+            if (address >= 1 && size_t(address) <= code.size()) {
+                starts[address - 1] = 1;
+                isEntry[address - 1] = 1;
+            }
+        }
+        isEntry[0] = !code.empty();
+        for (size_t i = 0; i < code.size(); i++) {
+            Opcode op = code[i].Operator;
+            if (jump(op)) {
+                long to = target(code, code[i]);
+                if (to >= 0) {
+                    starts[to] = 1;
+                }
+            }
+            if (jump(op) || op == Opcode::RET) {
+                starts[i + 1] = 1;
+            }
+        }
+
+        blockOf.assign(code.size(), 0);
+        for (size_t i = 0; i < code.size(); i++) {
+            if (starts[i]) {
+                if (!blockList.empty()) {
+                    blockList.back().end = i;
+                }
+                blockList.push_back({i, code.size(), {}, {}, UNREACHABLE, bool(isEntry[i])});
+            }
+            blockOf[i] = blockList.size() - 1;
+        }
+    }
+
+    void connect(const pmr::vector<Instruction>& code) {
+        for (size_t b = 0; b < blockList.size(); b++) {
+            const Instruction& last = code[blockList[b].end - 1];
+            bool fallsThrough = last.Operator != Opcode::JMP && last.Operator != Opcode::RET;
+            if (fallsThrough && b + 1 < blockList.size()) {
+                edge(b, b + 1);
+            }
+            if (jump(last.Operator)) {
+                long to = target(code, last);
+                if (to >= 0) {
+                    edge(b, blockOf[to]);
+                }
+            }
+        }
+    }
+
+    void edge(int from, int to) {
+        blockList[from].successors.push_back(to);
+        blockList[to].predecessors.push_back(from);
+    }
+
+    //reverse postorder of the blocks the entries reach (iterative DFS)
+    void number() {
+        vector<char> visited(blockList.size(), 0);
+        vector<int> postorder;
+        vector<pair<int, size_t>> path;
+        for (size_t root = 0; root < blockList.size(); root++) {
+            if (!blockList[root].entry || visited[root]) {
+                continue;
+            }
+            visited[root] = 1;
+            path.push_back({int(root), 0});
+            while (!path.empty()) {
+                auto& [block, next] = path.back();
+                if (next < blockList[block].successors.size()) {
+                    int successor = blockList[block].successors[next++];
+                    if (!visited[successor]) {
+                        visited[successor] = 1;
+                        path.push_back({successor, 0});
+                    }
+                }
+                else {
+                    postorder.push_back(block);
+                    path.pop_back();
+                }
+            }
+        }
+        order.assign(postorder.rbegin(), postorder.rend());
+    }
+
+    //Cooper, Harvey and Kennedy's iterative algorithm, the virtual root is
+    //position 0 and the blocks follow in reverse postorder
+    void dominators() {
+        vector<int> position(blockList.size(), -1);
+        for (size_t k = 0; k < order.size(); k++) {
+            position[order[k]] = k + 1;
+        }
+        vector<int> idom(order.size() + 1, -1);
+        idom[0] = 0;
+
+        auto intersect = [&](int a, int b) {
+            while (a != b) {
+                while (a > b) a = idom[a];
+                while (b > a) b = idom[b];
+            }
+            return a;
+        };
+
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (size_t k = 0; k < order.size(); k++) {
+                const Block& block = blockList[order[k]];
+                int dominator = block.entry ? 0 : -1;
+                for (int predecessor : block.predecessors) {
+                    int p = position[predecessor];
+                    if (p < 0 || idom[p] < 0) {
+                        continue;
+                    }
+                    dominator = dominator < 0 ? p : intersect(p, dominator);
+                }
+                if (idom[k + 1] != dominator) {
+                    idom[k + 1] = dominator;
+                    changed = true;
+                }
+            }
+        }
+
+        for (size_t k = 0; k < order.size(); k++) {
+            blockList[order[k]].idom = idom[k + 1] == 0 ? ROOT : order[idom[k + 1] - 1];
+        }
+    }
+};
+
+#endif
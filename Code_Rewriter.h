@@ -0,0 +1,113 @@
+#ifndef CODE_REWRITER_H
+#define CODE_REWRITER_H
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+#include "Instruction.h"
+using namespace std;
+
+//builds the replacement instruction table for a pass that removes, replaces or
+//inserts instructions
+//the pass calls begin(i) before emitting what old instruction i becomes, an old
+//address then maps to the first instruction emitted for it (or for the next
+//instruction if it was removed) and jump operands are renumbered by commit()
+//unless they were emitted already placed
+class Code_Rewriter {
+    const pmr::vector<Instruction>& input;
+    vector<Instruction> output;
+    struct Origin {
+        size_t index; //old instruction it was emitted for
+        bool placed;  //operand is already a new address
+    };
+    vector<Origin> origins; //per output instruction
+    vector<int> forward; //old index -> new index, one entry past the end
+    size_t current = 0;  //old index given to the last begin()
+
+public:
+    explicit Code_Rewriter(const pmr::vector<Instruction>& input)
+        : input(input), forward(input.size() + 1, 0) {
+        output.reserve(input.size());
+        origins.reserve(input.size());
+    }
+
+    Code_Rewriter(const Code_Rewriter&) = delete;
+    Code_Rewriter& operator=(const Code_Rewriter&) = delete;
+
+    //the table being rewritten, unchanged until commit()
+    const pmr::vector<Instruction>& code() const {
+        return input;
+    }
+
+    void begin(size_t oldIndex) {
+        forward[oldIndex] = output.size();
+        current = oldIndex;
+    }
+
+    //old instruction oldIndex is the same as the already emitted newIndex
+    //(e.g. a LABEL merged into the one before it) and emits nothing
+    void merge(size_t oldIndex, size_t newIndex) {
+        forward[oldIndex] = newIndex;
+        current = oldIndex;
+    }
+
+    void emit(const Instruction& instr) {
+        output.push_back(instr);
+        origins.push_back({current, false});
+    }
+
+    //emits a jump whose operand is a new address, for code the pass lays out
+    //itself (e.g. a copied function body)
+    void emit_placed(const Instruction& instr) {
+        output.push_back(instr);
+        origins.push_back({current, true});
+    }
+
+    //instructions emitted so far
+    vector<Instruction>& emitted() {
+        return output;
+    }
+
+    //removes an already emitted instruction, old instructions that started
+    //after it move back with the rest of the output
+    void erase(size_t newIndex) {
+        output.erase(output.begin() + newIndex);
+        origins.erase(origins.begin() + newIndex);
+        for (size_t i = current + 1; i-- > 0 && forward[i] > int(newIndex);) {
+            forward[i]--;
+        }
+    }
+
+    //erases everything emitted from newIndex on
+    void truncate(size_t newIndex) {
+        while (output.size() > newIndex) {
+            erase(output.size() - 1);
+        }
+    }
+
+    //old index of the instruction newIndex was emitted for (e.g. to carry debug
+    //information over)
+    size_t origin(size_t newIndex) const {
+        return origins[newIndex].index;
+    }
+
+    //new address (1-based) of an old address
+    int address(int oldAddress) const {
+        return forward[oldAddress - 1] + 1;
+    }
+
+    //replaces code (normally the input table) with the output and renumbers
+    //instruction operands, address() stays valid afterwards
+    void commit(pmr::vector<Instruction>& code) {
+        forward[input.size()] = output.size();
+        for (size_t i = 0; i < output.size(); i++) {
+            Instruction& instr = output[i];
+            if (instr.hasOperand && instr.info().operand == Operand_Kind::INSTRUCTION && !origins[i].placed) {
+                instr.Operand = address(instr.Operand);
+            }
+        }
+        code.assign(output.begin(), output.end());
+    }
+};
+
+#endif
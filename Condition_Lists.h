@@ -0,0 +1,100 @@
+#ifndef CONDITION_LISTS_H
+#define CONDITION_LISTS_H
+
+#include <utility>
+using namespace std;
+
+//the code of a condition falls through when it is true and ends with the
+//last branch of its false list; and, or and not combine the two lists on
+//top of a jump stack (see Symbol_and_Assembly::JumpStack), so later
+//comparisons are skipped once the outcome is known
+//Lists is a stack of int vectors, the false list below the true list on top;
+//Code has invert(index), JMP0 <-> JMP1, and patch_here(list), a LABEL the
+//branches of list jump to
+//used by Symbol_and_Assembly and Constexpr_Compiler
+template <typename Code>
+struct Condition_Lists {
+    //a comparison ending in the JMP0 at branch: the false list {branch}, the true list empty
+    template <typename Lists>
+    static constexpr void comparison(Lists& lists, int branch) {
+        lists.emplace_back(1, branch);
+        lists.emplace_back();
+    }
+
+    //empty lists for a comparison that had a syntax error
+    template <typename Lists>
+    static constexpr void missing_comparison(Lists& lists) {
+        lists.emplace_back();
+        lists.emplace_back();
+    }
+
+    //after the left operand of and: its true branches go to the right operand
+    template <typename Lists>
+    static constexpr void begin_and(Lists& lists, Code& code) {
+        code.patch_here(lists.back());
+    }
+
+    //after the right operand: false when either is, true when the right one is
+    template <typename Lists>
+    static constexpr void end_and(Lists& lists) {
+        auto whenTrue = std::move(lists.back());
+        lists.pop_back();
+        auto whenFalse = std::move(lists.back());
+        lists.pop_back();
+        lists.back() = std::move(whenTrue); //the left operand's was patched
+        auto& leftFalse = lists[lists.size() - 2];
+        leftFalse.insert(leftFalse.end(), whenFalse.begin(), whenFalse.end());
+    }
+
+    //after the left operand of or: its last branch jumps when it is true
+    //instead, so false falls through to the right operand
+    template <typename Lists>
+    static constexpr void begin_or(Lists& lists, Code& code) {
+        auto& whenTrue = lists.back();
+        auto& whenFalse = lists[lists.size() - 2];
+        if (!whenFalse.empty()) {
+            code.invert(whenFalse.back());
+            whenTrue.push_back(whenFalse.back());
+            whenFalse.pop_back();
+        }
+        code.patch_here(whenFalse);
+    }
+
+    //after the right operand: true when either is, false when the right one is
+    template <typename Lists>
+    static constexpr void end_or(Lists& lists) {
+        auto whenTrue = std::move(lists.back());
+        lists.pop_back();
+        auto whenFalse = std::move(lists.back());
+        lists.pop_back();
+        lists.back().insert(lists.back().end(), whenTrue.begin(), whenTrue.end());
+        lists[lists.size() - 2] = std::move(whenFalse); //the left operand's was patched
+    }
+
+    //after the operand of not: the lists swap, its last branch is inverted so
+    //that true still falls through
+    template <typename Lists>
+    static constexpr void negate(Lists& lists, Code& code) {
+        auto& whenTrue = lists.back();
+        auto& whenFalse = lists[lists.size() - 2];
+        if (whenFalse.empty()) {
+            swap(whenTrue, whenFalse);
+            return;
+        }
+        int last = whenFalse.back();
+        whenFalse.pop_back();
+        code.invert(last);
+        swap(whenTrue, whenFalse);
+        whenFalse.push_back(last);
+    }
+
+    //the condition's true branches go to the code after it, its false list
+    //stays for back_patch
+    template <typename Lists>
+    static constexpr void end_condition(Lists& lists, Code& code) {
+        code.patch_here(lists.back());
+        lists.pop_back();
+    }
+};
+
+#endif
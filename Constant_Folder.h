@@ -0,0 +1,238 @@
+#ifndef CONSTANT_FOLDER_H
+#define CONSTANT_FOLDER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Instruction.h"
+#include "Code_Rewriter.h"
+using namespace std;
+
+//-O1: evaluates operators whose operands are literals, applies x+0, 0+x, x-0,
+//x*1, 1*x, x/1, x*0, 0*x and x-x, and turns a JMP0 or JMP1 on a constant into
+//a JMP or nothing, and an ITOF of an integer literal into a PUSHF
+//works on one straight-line stretch at a time, what is on the stack at a LABEL
+//or after a jump is never folded
+class Constant_Folder {
+    Code_Rewriter* current = nullptr; //rewriter of the run in progress
+    Constant_Pool& pool;
+    vector<int> starts; //for each stack entry, the emitted index where its computation starts, -1 unknown
+
+public:
+    size_t folded = 0;     //operators evaluated
+    size_t identities = 0; //identities applied
+    size_t branches = 0;   //JMP0 and JMP1 made unconditional or removed
+
+    explicit Constant_Folder(Constant_Pool& pool) : pool(pool) {}
+
+    //returns the number of changes made
+    size_t run(Code_Rewriter& rewriter) {
+        current = &rewriter;
+        starts.clear();
+        size_t before = folded + identities + branches;
+        const auto& code = rewriter.code();
+        for (size_t i = 0; i < code.size(); i++) {
+            rewriter.begin(i);
+            const Instruction& instr = code[i];
+
+            if (is_branch(instr.Operator)) {
+                branch(instr);
+            }
+            else if (instr.info().rule != Type_Rule::NONE) {
+                binary(instr);
+            }
+            else {
+                other(instr);
+            }
+        }
+        return folded + identities + branches - before;
+    }
+
+private:
+    vector<Instruction>& out() {
+        return current->emitted();
+    }
+
+    int pop() {
+        if (starts.empty()) {
+            return -1;
+        }
+        int start = starts.back();
+        starts.pop_back();
+        return start;
+    }
+
+    //literal value of a PUSHI, PUSHK or (unless integerOnly) PUSHB
+    bool literal(int index, int64_t& value, bool integerOnly = false) const {
+        const Instruction& instr = current->emitted()[index];
+        switch (instr.Operator) {
+            case Opcode::PUSHI:
+                value = instr.Operand;
+                return true;
+            case Opcode::PUSHK:
+                value = pool[instr.Operand];
+                return true;
+            case Opcode::PUSHB:
+                value = instr.Operand;
+                return !integerOnly;
+            default:
+                return false;
+        }
+    }
+
+    Instruction integer(int64_t value) {
+        return fits_operand(value) ? Instruction(Opcode::PUSHI, int(value))
+                                   : Instruction(Opcode::PUSHK, pool.index(value));
+    }
+
+    //second op first, false when the result is not defined or does not fit
+    static bool evaluate(Opcode op, int64_t second, int64_t first, int64_t& result) {
+        switch (op) {
+            case Opcode::A: return !__builtin_add_overflow(second, first, &result);
+            case Opcode::S: return !__builtin_sub_overflow(second, first, &result);
+            case Opcode::M: return !__builtin_mul_overflow(second, first, &result);
+            case Opcode::D:
+                if (first == 0 || (second == INT64_MIN && first == -1)) {
+                    return false;
+                }
+                result = second / first;
+                return true;
+            case Opcode::SHL: result = int64_t(uint64_t(second) << (first & 63)); return true;
+            case Opcode::SHR: result = second >> (first & 63); return true;
+            case Opcode::AND: result = second & first; return true;
+            case Opcode::GRT:
+            case Opcode::GRTB: result = second > first; return true;
+            case Opcode::LES:
+            case Opcode::LESB: result = second < first; return true;
+            case Opcode::EQU:
+            case Opcode::EQUB: result = second == first; return true;
+            case Opcode::NEQ:
+            case Opcode::NEQB: result = second != first; return true;
+            case Opcode::GEQ:
+            case Opcode::GEQB: result = second >= first; return true;
+            case Opcode::LEQ:
+            case Opcode::LEQB: result = second <= first; return true;
+            default: return false;
+        }
+    }
+
+    //no SIN or POPM between from and the end of the output, so the value can be
+    //dropped or recomputed
+    bool pure(size_t from) {
+        for (size_t i = from; i < out().size(); i++) {
+            if (!is_pure(out(), i)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //the operator's two operands were computed from second and from first
+    void binary(const Instruction& instr) {
+        int first = pop();
+        int second = pop();
+        if (first < 0 || second < 0) {
+            current->emit(instr);
+            starts.push_back(-1);
+            return;
+        }
+
+        int64_t a = 0, b = 0, result = 0;
+        bool lhs = first == second + 1 && literal(second, a, instr.info().rule == Type_Rule::ARITHMETIC);
+        bool rhs = size_t(first) + 1 == out().size() && literal(first, b, instr.info().rule == Type_Rule::ARITHMETIC);
+        starts.push_back(second);
+
+        if (lhs && rhs && evaluate(instr.Operator, a, b, result)) {
+            current->truncate(second);
+            current->emit(instr.info().rule == Type_Rule::ARITHMETIC ? integer(result)
+                                                                     : Instruction(Opcode::PUSHB, int(result)));
+            folded++;
+            return;
+        }
+
+        switch (instr.Operator) {
+            case Opcode::A:
+                if (rhs && b == 0) { current->erase(first); identities++; return; }
+                if (lhs && a == 0) { current->erase(second); identities++; return; }
+                break;
+            case Opcode::S:
+                if (rhs && b == 0) { current->erase(first); identities++; return; }
+                if (first - second == int(out().size()) - first && pure(second) &&
+                    equal(out().begin() + second, out().begin() + first, out().begin() + first)) {
+                    current->truncate(second);
+                    current->emit(Instruction(Opcode::PUSHI, 0));
+                    identities++;
+                    return;
+                }
+                break;
+            case Opcode::M:
+                if (rhs && b == 1) { current->erase(first); identities++; return; }
+                if (lhs && a == 1) { current->erase(second); identities++; return; }
+                if (((rhs && b == 0) || (lhs && a == 0)) && pure(second)) {
+                    current->truncate(second);
+                    current->emit(Instruction(Opcode::PUSHI, 0));
+                    identities++;
+                    return;
+                }
+                break;
+            case Opcode::D:
+                if (rhs && b == 1) { current->erase(first); identities++; return; }
+                break;
+            default:
+                break;
+        }
+        current->emit(instr);
+    }
+
+    void branch(const Instruction& instr) {
+        int condition = pop();
+        int64_t value = 0;
+        if (condition >= 0 && size_t(condition) + 1 == out().size() && instr.hasOperand && literal(condition, value)) {
+            current->erase(condition);
+            if ((value == 0) == (instr.Operator == Opcode::JMP0)) {
+                current->emit(Instruction(Opcode::JMP, instr.Operand));
+            }
+            branches++;
+        }
+        else {
+            current->emit(instr);
+        }
+        starts.clear();
+    }
+
+    //every other instruction only moves values, a value it pushes starts at the
+    //first of its operands (the copy DUP adds has no start of its own)
+    void other(const Instruction& instr) {
+        const Opcode_Info& info = instr.info();
+        if (instr.Operator == Opcode::CALL) {
+            //pops as many arguments as the callee has, nothing below is tracked
+            current->emit(instr);
+            starts.assign(starts.size(), -1);
+            starts.push_back(-1);
+            return;
+        }
+        int64_t value = 0;
+        if (instr.Operator == Opcode::ITOF && !starts.empty() && starts.back() >= 0 &&
+            size_t(starts.back()) + 1 == out().size() && literal(starts.back(), value, true)) {
+            current->truncate(starts.back());
+            current->emit(Instruction(Opcode::PUSHF, pool.index(real_bits(double(value)), true)));
+            folded++;
+            return;
+        }
+        int start = int(out().size());
+        for (int i = 0; i < info.pops; i++) {
+            int operand = pop();
+            start = operand < 0 || start < 0 ? -1 : min(start, operand);
+        }
+        current->emit(instr);
+        for (int i = 0; i < info.pushes; i++) {
+            starts.push_back(i == 0 ? start : -1);
+        }
+        if (instr.Operator == Opcode::LABEL || instr.Operator == Opcode::JMP || instr.Operator == Opcode::RET) {
+            starts.clear();
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,775 @@
+#ifndef CONSTEXPR_COMPILER_H
+#define CONSTEXPR_COMPILER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "TokenType.h"
+#include "Type.h"
+#include "Instruction.h"
+#include "Lexical_Analyzer.h"
+#include "Grammar.h"
+#include "Condition_Lists.h"
+#include "Return_Types.h"
+using namespace std;
+
+//parser and Symbol_and_Assembly code generation for use in constant expressions
+//lexes with LexicalAnalyzer and takes its operators, qualifiers, literals,
+//typing, return types and condition lists from the same headers as
+//SyntaxAnalyzer and Symbol_and_Assembly (Grammar.h, Instruction.h,
+//Return_Types.h, Condition_Lists.h); the
+//productions follow SyntaxAnalyzer without its trace and fail the constant
+//evaluation (throw) on the first error
+//a second parser because SyntaxAnalyzer cannot run in a constant expression:
+//its tables live in pmr arenas, it writes trace and listing streams while it
+//parses and can take its tokens from the lexer thread
+//tests/constexpr_test.cpp checks the result against the listings rat25s
+//writes for t1..t5 and for every program in tests/ it compiles
+class Constexpr_Compiler {
+    friend struct Condition_Lists<Constexpr_Compiler>;
+    using Conditions = Condition_Lists<Constexpr_Compiler>;
+
+    struct Symbol {
+        string name;
+        int memoryADDR; //frame slot for a local
+        Type type;
+        int scope;      //0 for globals, otherwise the function's index + 1
+    };
+
+    struct FunctionInfo {
+        string name;
+        int entryADDR;
+        int params;
+        int frameSize;
+        Type returnType;
+    };
+
+    struct Call {
+        int index;
+        string name;
+        int arguments;
+    };
+
+    //characters of the program for LexicalAnalyzer
+    struct Text_Source {
+        string_view text;
+        size_t pos = 0;
+
+        constexpr int get() {
+            return pos < text.size() ? (unsigned char)text[pos++] : EOF;
+        }
+
+        constexpr void unget(int c) {
+            if (c != EOF) {
+                pos--;
+            }
+        }
+    };
+
+    Text_Source source;
+
+    vector<Token> tokens;
+    size_t currentIndex = 0;
+
+    int memoryAddr = 10000;
+    vector<Symbol> SymbolTable;
+    vector<Type> Stack;
+    vector<vector<int>> JumpStack; //see Symbol_and_Assembly::JumpStack
+    vector<Instruction> InstructTable;
+    vector<int64_t> ConstantPool;  //see Constant_Pool
+    vector<FunctionInfo> FunctionTable;
+    vector<Call> PendingCalls;
+    vector<Return_Type> ReturnTypes;
+    int openScope = 0;
+
+    constexpr void lex() {
+        LexicalAnalyzer la;
+        while (true) {
+            Token token = la.lexer(source);
+            if (token.value.empty()) {
+                break;
+            }
+            tokens.push_back(token);
+        }
+    }
+
+    // ---- Symbol_and_Assembly ----------------------------------------------
+
+    constexpr void generate_instruction(Opcode op) {
+        InstructTable.push_back(Instruction(op));
+    }
+
+    constexpr void generate_instruction(Opcode op, int operand) {
+        InstructTable.push_back(Instruction(op, operand));
+    }
+
+    constexpr int getInstructionAddr() const {
+        return int(InstructTable.size()) + 1;
+    }
+
+    //var in scope, nullptr if it is not declared there
+    constexpr Symbol* find(const string& var, int scope) {
+        for (auto& entry : SymbolTable) {
+            if (entry.name == var && entry.scope == scope) {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    //Symbol_and_Assembly::resolve: a name that was not declared is an error
+    constexpr Symbol& symbol(const string& var) {
+        if (!hasSymbol(var)) {
+            throw "Undefined variable";
+        }
+        Symbol* local = openScope ? find(var, openScope) : nullptr;
+        return local ? *local : *find(var, 0);
+    }
+
+    constexpr bool hasSymbol(const string& var) {
+        return (openScope && find(var, openScope)) || find(var, 0);
+    }
+
+    //a declaration in a function is a local in the next frame slot
+    constexpr void declare(const string& var, int memoryADDR, Type type) {
+        if (Symbol* entry = find(var, openScope)) {
+            entry->memoryADDR = memoryADDR;
+            entry->type = type;
+            return;
+        }
+        SymbolTable.push_back({var, memoryADDR, type, openScope});
+    }
+
+    constexpr void generate_symbol(const string& var, Type type) {
+        declare(var, openScope ? FunctionTable.back().frameSize++ : memoryAddr++, type);
+    }
+
+    constexpr Type pop() {
+        if (Stack.empty()) {
+            throw "Stack underflow";
+        }
+        Type type = Stack.back();
+        Stack.pop_back();
+        return type;
+    }
+
+    constexpr void binary_operator(Opcode op) {
+        Type first = pop();
+        Type second = pop();
+        Typed_Operator code = typed_operator(op, first, second);
+        if (code.convert) {
+            generate_instruction(*code.convert);
+        }
+        Stack.push_back(code.result);
+        generate_instruction(code.op);
+    }
+
+    //Symbol_and_Assembly::PUSHI and PUSHF, literals that do not fit an operand go to the pool
+    constexpr int pool_index(int64_t value) {
+        for (size_t i = 0; i < ConstantPool.size(); i++) {
+            if (ConstantPool[i] == value) {
+                return i;
+            }
+        }
+        ConstantPool.push_back(value);
+        return ConstantPool.size() - 1;
+    }
+
+    constexpr void PUSHI(int64_t value) {
+        Stack.push_back(Type::INTEGER);
+        if (fits_operand(value)) {
+            generate_instruction(Opcode::PUSHI, int(value));
+        }
+        else {
+            generate_instruction(Opcode::PUSHK, pool_index(value));
+        }
+    }
+
+    //Symbol_and_Assembly::negate_value
+    constexpr void negate_value() {
+        if (Stack.empty() || Stack.back() == Type::BOOLEAN) {
+            throw "Type mismatch: - of a Boolean value";
+        }
+        if (Stack.back() == Type::REAL) {
+            PUSHF(-1.0);
+        }
+        else {
+            PUSHI(-1);
+        }
+        binary_operator(Opcode::M);
+    }
+
+    constexpr void PUSHF(double value) {
+        Stack.push_back(Type::REAL);
+        generate_instruction(Opcode::PUSHF, pool_index(real_bits(value)));
+    }
+
+    //Symbol_and_Assembly::push_variable and pop_variable
+    constexpr void PUSHM(const string& var) {
+        Symbol& entry = symbol(var);
+        Stack.push_back(entry.type);
+        generate_instruction(entry.scope ? Opcode::PUSHL : Opcode::PUSHM, entry.memoryADDR);
+    }
+
+    constexpr void POPM(const string& var) {
+        Symbol& entry = symbol(var);
+        optional<Opcode> convert = Stack.empty() ? nullopt : widening(entry.type, Stack.back());
+        if (convert) {
+            Stack.back() = Type::REAL;
+            generate_instruction(*convert);
+        }
+        Type type = pop();
+        entry.type = stored_type(entry.type, type, entry.name);
+        generate_instruction(entry.scope ? Opcode::POPL : Opcode::POPM, entry.memoryADDR);
+    }
+
+    constexpr int function(const string& name) const {
+        for (size_t i = 0; i < FunctionTable.size(); i++) {
+            if (FunctionTable[i].name == name) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    //Symbol_and_Assembly::return_type
+    constexpr Type return_type(const string& name) const {
+        for (const Return_Type& function : ReturnTypes) {
+            if (function.name == name) {
+                return function.type;
+            }
+        }
+        throw "Undefined function";
+    }
+
+    constexpr void RET() {
+        const FunctionInfo& current = FunctionTable.back();
+        optional<Opcode> convert = Stack.empty() ? nullopt : widening(current.returnType, Stack.back());
+        if (convert) {
+            Stack.back() = Type::REAL;
+            generate_instruction(*convert);
+        }
+        check_return(current.returnType, pop(), current.name);
+        generate_instruction(Opcode::RET);
+    }
+
+    constexpr void CALL(const string& name, int arguments) {
+        for (int i = 0; i < arguments; i++) {
+            pop();
+        }
+        int callee = function(name);
+        Stack.push_back(callee >= 0 ? FunctionTable[callee].returnType : return_type(name));
+        PendingCalls.push_back({int(InstructTable.size()), name, arguments});
+        generate_instruction(Opcode::CALL);
+    }
+
+    constexpr void resolve_calls() {
+        for (const auto& call : PendingCalls) {
+            int callee = function(call.name);
+            if (callee < 0) {
+                throw "Undefined function";
+            }
+            if (FunctionTable[callee].params != call.arguments) {
+                throw "Wrong number of arguments";
+            }
+            InstructTable[call.index] = Instruction(Opcode::CALL, FunctionTable[callee].entryADDR);
+        }
+    }
+
+    constexpr void SIN(const string& var) {
+        if (!hasSymbol(var)) {
+            throw "Undefined variable";
+        }
+        Type expected = symbol(var).type;
+        Stack.push_back(expected);
+        InstructTable.push_back(scan_placeholder(expected));
+        generate_instruction(scan_opcode(expected));
+        POPM(var);
+    }
+
+    constexpr void back_patch(int JMP_address) {
+        if (!JumpStack.empty()) {
+            patch_branches(JumpStack.back(), JMP_address);
+            JumpStack.pop_back();
+        }
+    }
+
+    constexpr void patch_branches(const vector<int>& branches, int JMP_address) {
+        for (int addr : branches) {
+            if (is_branch(InstructTable[addr].Operator)) {
+                InstructTable[addr] = Instruction(InstructTable[addr].Operator, JMP_address);
+            }
+        }
+    }
+
+    constexpr void patch_here(vector<int>& branches) {
+        if (!branches.empty()) {
+            patch_branches(branches, getInstructionAddr());
+            generate_instruction(Opcode::LABEL);
+            branches.clear();
+        }
+    }
+
+    constexpr void invert(int addr) {
+        Opcode op = InstructTable[addr].Operator;
+        InstructTable[addr].Operator = op == Opcode::JMP0 ? Opcode::JMP1 : Opcode::JMP0;
+    }
+
+    // ---- SyntaxAnalyzer ---------------------------------------------------
+
+    constexpr bool atTokensEnd() const {
+        return currentIndex >= tokens.size();
+    }
+
+    //next token without consuming it, callers check atTokensEnd() first
+    constexpr const Token& peek() const {
+        return tokens[currentIndex];
+    }
+
+    constexpr bool peekIs(TokenType type, string_view value) const {
+        return !atTokensEnd() && tokens[currentIndex].type == type && tokens[currentIndex].value == value;
+    }
+
+    constexpr Token next() {
+        if (atTokensEnd()) {
+            return {TokenType::EMPTY, ""};
+        }
+        return tokens[currentIndex++];
+    }
+
+    constexpr void expect(TokenType type, string_view value, const char* error) {
+        Token token = next();
+        if (token.type != type || token.value != value) {
+            throw error;
+        }
+    }
+
+    constexpr void Rat25S() {
+        expect(TokenType::SEPARATOR, "$$", "Error: Expected '$$' at the start of Opt_Function_Definitions");
+        if (!atTokensEnd() && !peekIs(TokenType::SEPARATOR, "$$")) {
+            //the function bodies are jumped over
+            ReturnTypes = Return_Types<vector<Token>>::infer(tokens, currentIndex);
+            size_t skip = InstructTable.size();
+            generate_instruction(Opcode::JMP);
+            while (!atTokensEnd() && !peekIs(TokenType::SEPARATOR, "$$")) {
+                Function();
+            }
+            InstructTable[skip] = Instruction(Opcode::JMP, getInstructionAddr());
+            generate_instruction(Opcode::LABEL);
+        }
+        expect(TokenType::SEPARATOR, "$$", "Error: Expected '$$' at the end of Opt_Function_Definitions");
+        Opt_Declaration_List();
+        expect(TokenType::SEPARATOR, "$$", "Error: Expected '$$' at the end of Opt_Declaration_List");
+        Statement_List();
+        expect(TokenType::SEPARATOR, "$$", "Error: Expected '$$' at the end of Statement_List");
+        resolve_calls();
+    }
+
+    constexpr void Function() {
+        expect(TokenType::KEYWORD, "function", "Error: Expected 'function' at the start of Function");
+        Token name = next();
+        if (name.type != TokenType::IDENTIFIER) {
+            throw "Error: Invalid Identifier. Expected token type of IDENTIFIER";
+        }
+        if (function(name.value) >= 0) {
+            throw "Duplicate definition of function";
+        }
+        FunctionTable.push_back({name.value, 0, 0, 0, return_type(name.value)});
+        openScope = FunctionTable.size();
+        expect(TokenType::SEPARATOR, "(", "Error: Expected '(' at the start of Function");
+        if (!atTokensEnd() && peek().type != TokenType::SEPARATOR) {
+            //<Parameter> ::= <IDs> <Qualifier>, separated by ','
+            while (true) {
+                vector<string> names = IDS_names();
+                Type type = Qualifier();
+                for (const string& param : names) {
+                    generate_symbol(param, type);
+                    FunctionTable.back().params++;
+                }
+                if (!peekIs(TokenType::SEPARATOR, ",")) {
+                    break;
+                }
+                next();
+            }
+        }
+        expect(TokenType::SEPARATOR, ")", "Error: Expected ')' at the end of Function");
+        Opt_Declaration_List();
+
+        FunctionInfo& current = FunctionTable.back();
+        current.entryADDR = getInstructionAddr();
+        generate_instruction(Opcode::ENTER, current.frameSize);
+        for (int slot = current.params - 1; slot >= 0; slot--) {
+            generate_instruction(Opcode::POPL, slot);
+        }
+        expect(TokenType::SEPARATOR, "{", "Error: Expected '{' at the start of Body");
+        Statement_List();
+        expect(TokenType::SEPARATOR, "}", "Error: Expected '}' at the end of Body");
+        if (InstructTable.back().Operator != Opcode::RET) {
+            generate_instruction(Opcode::PUSHI, 0);
+            generate_instruction(Opcode::RET);
+        }
+        openScope = 0;
+    }
+
+    constexpr Type Qualifier() {
+        Token token = next();
+        Type type = token.type == TokenType::KEYWORD ? qualifier_type(token.value) : Type::UNDEFINED;
+        if (type != Type::UNDEFINED) {
+            return type;
+        }
+        throw "Error: Invalid Qualifier. Expected token type of integer, boolean, or real";
+    }
+
+    constexpr void Opt_Declaration_List() {
+        while (!atTokensEnd() && peek().type == TokenType::KEYWORD && qualifier_type(peek().value) != Type::UNDEFINED) {
+            //<Declaration> ::= <Qualifier> <IDs>
+            Type type = Qualifier();
+            IDS(type);
+            expect(TokenType::SEPARATOR, ";", "Error: Expected ';' at the end of Declaration_List");
+        }
+    }
+
+    //IDs of a scan, each one read into its variable
+    constexpr void IDS() {
+        Identifier();
+        while (peekIs(TokenType::SEPARATOR, ",")) {
+            next();
+            Identifier();
+        }
+    }
+
+    //IDs of a parameter or the arguments of a call
+    constexpr vector<string> IDS_names() {
+        vector<string> names;
+        while (true) {
+            Token token = next();
+            if (token.type != TokenType::IDENTIFIER) {
+                throw "Error: Invalid Identifier. Expected token type of IDENTIFIER";
+            }
+            names.push_back(token.value);
+            if (!peekIs(TokenType::SEPARATOR, ",")) {
+                return names;
+            }
+            next();
+        }
+    }
+
+    //IDs of a declaration
+    constexpr void IDS(Type type) {
+        Identifier(type);
+        while (peekIs(TokenType::SEPARATOR, ",")) {
+            next();
+            Identifier(type);
+        }
+    }
+
+    constexpr void Identifier() {
+        Token token = next();
+        if (token.type != TokenType::IDENTIFIER) {
+            throw "Error: Invalid Identifier. Expected token type of IDENTIFIER";
+        }
+        if (hasSymbol(token.value)) {
+            SIN(token.value);
+        }
+    }
+
+    constexpr void Identifier(Type type) {
+        Token token = next();
+        if (token.type != TokenType::IDENTIFIER) {
+            throw "Error: Invalid Identifier. Expected token type of IDENTIFIER";
+        }
+        if (type != Type::UNDEFINED) {
+            generate_symbol(token.value, type);
+        }
+    }
+
+    constexpr void Statement_List() {
+        Statement();
+        while (!atTokensEnd() && peek().type != TokenType::SEPARATOR) {
+            Statement();
+        }
+    }
+
+    constexpr void Statement() {
+        Token token = next();
+        if (token.type == TokenType::SEPARATOR && token.value == "{") {
+            Statement_List();
+            expect(TokenType::SEPARATOR, "}", "Error in beggining '}' for <Compound>'");
+        }
+        else if (token.type == TokenType::KEYWORD && token.value == "if") {
+            expect(TokenType::SEPARATOR, "(", "Error in beginning '(' for <If>");
+            Condition();
+            expect(TokenType::SEPARATOR, ")", "Error in beginning ')' for <If>");
+            Statement();
+            token = next();
+            if (token.type == TokenType::KEYWORD && token.value == "else") {
+                Statement();
+                token = next();
+            }
+            if (token.type != TokenType::KEYWORD || token.value != "endif") {
+                throw "Error in 'endif' for <if>";
+            }
+            back_patch(getInstructionAddr());
+            generate_instruction(Opcode::LABEL);
+        }
+        else if (token.type == TokenType::KEYWORD && token.value == "return") {
+            if (!openScope) {
+                throw "Return outside a function";
+            }
+            if (peekIs(TokenType::SEPARATOR, ";")) {
+                next();
+                PUSHI(0);
+                RET();
+            }
+            else {
+                Expression();
+                RET();
+                expect(TokenType::SEPARATOR, ";", "Error in ';' for <Return>");
+            }
+        }
+        else if (token.type == TokenType::KEYWORD && token.value == "print") {
+            expect(TokenType::SEPARATOR, "(", "Error in beginning '(' for <Print>");
+            Expression();
+            generate_instruction(print_opcode(pop()));
+            expect(TokenType::SEPARATOR, ")", "Error in beginning ')' for <Print>");
+            expect(TokenType::SEPARATOR, ";", "Error in ';' for <Print>");
+        }
+        else if (token.type == TokenType::KEYWORD && token.value == "scan") {
+            expect(TokenType::SEPARATOR, "(", "Error in beginning '(' for <Scan>");
+            IDS();
+            expect(TokenType::SEPARATOR, ")", "Error in beginning ')' for <Scan>");
+            expect(TokenType::SEPARATOR, ";", "Error in ';' for <Scan>");
+        }
+        else if (token.type == TokenType::KEYWORD && token.value == "while") {
+            int instruction_Addr = getInstructionAddr();
+            generate_instruction(Opcode::LABEL);
+            expect(TokenType::SEPARATOR, "(", "Error in beginning '(' for <While>");
+            Condition();
+            expect(TokenType::SEPARATOR, ")", "Error in beginning ')' for <While>");
+            Statement();
+            generate_instruction(Opcode::JMP, instruction_Addr);
+            back_patch(getInstructionAddr());
+            generate_instruction(Opcode::LABEL);
+            expect(TokenType::KEYWORD, "endwhile", "Error in 'endwhile' for <While>");
+        }
+        else if (token.type == TokenType::IDENTIFIER) {
+            expect(TokenType::OPERATOR, "=", "Error in '=' for <Assign>");
+            Expression();
+            POPM(token.value);
+            expect(TokenType::SEPARATOR, ";", "Error in ';' for <Assign>");
+        }
+        else {
+            throw "Error: Invalid Statement. Expected statement type of <Compound>, <Assign>, <If>, <Return>, <Print>, <Scan>, or <While>";
+        }
+    }
+
+    constexpr void Condition() {
+        Disjunction();
+        Conditions::end_condition(JumpStack, *this);
+    }
+
+    constexpr void Disjunction() {
+        Conjunction();
+        while (peekIs(TokenType::KEYWORD, "or")) {
+            next();
+            Conditions::begin_or(JumpStack, *this);
+            Conjunction();
+            Conditions::end_or(JumpStack);
+        }
+    }
+
+    constexpr void Conjunction() {
+        Negation();
+        while (peekIs(TokenType::KEYWORD, "and")) {
+            next();
+            Conditions::begin_and(JumpStack, *this);
+            Negation();
+            Conditions::end_and(JumpStack);
+        }
+    }
+
+    constexpr void Negation() {
+        if (peekIs(TokenType::KEYWORD, "not")) {
+            next();
+            Negation();
+            Conditions::negate(JumpStack, *this);
+        }
+        else if (peekIs(TokenType::SEPARATOR, "(") && condition_group()) {
+            next();
+            Disjunction();
+            expect(TokenType::SEPARATOR, ")", "Error in Negation. Expected token type of ) for ( <Disjunction> )");
+        }
+        else {
+            Comparison();
+        }
+    }
+
+    //SyntaxAnalyzer::condition_group
+    constexpr bool condition_group() const {
+        int depth = 0;
+        for (size_t i = currentIndex; i < tokens.size(); i++) {
+            const Token& token = tokens[i];
+            if (token.type == TokenType::SEPARATOR && (token.value == "(" || token.value == ")")) {
+                depth += token.value == "(" ? 1 : -1;
+                if (depth == 0) {
+                    return false;
+                }
+            }
+            else if (depth == 1 && ((token.type == TokenType::OPERATOR && is_relop(token.value)) ||
+                                    (token.type == TokenType::KEYWORD && is_condition_keyword(token.value)))) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    constexpr void Comparison() {
+        Expression();
+        Token token = next();
+        if (token.type != TokenType::OPERATOR || !is_relop(token.value)) {
+            throw "Error in Relop. Expected token type of OPERATOR with value ==, !=, >, <, <=, or =>";
+        }
+        Expression();
+        binary_operator(*operator_opcode(RELOPS, token.value));
+        Conditions::comparison(JumpStack, InstructTable.size());
+        pop();
+        generate_instruction(Opcode::JMP0);
+    }
+
+    constexpr void Expression() {
+        Term();
+        while (!atTokensEnd() && peek().type == TokenType::OPERATOR &&
+               operator_opcode(ADDING_OPERATORS, peek().value)) {
+            Opcode op = *operator_opcode(ADDING_OPERATORS, next().value);
+            Term();
+            binary_operator(op);
+        }
+    }
+
+    constexpr void Term() {
+        Factor();
+        while (!atTokensEnd() && peek().type == TokenType::OPERATOR &&
+               operator_opcode(MULTIPLYING_OPERATORS, peek().value)) {
+            Opcode op = *operator_opcode(MULTIPLYING_OPERATORS, next().value);
+            Factor();
+            binary_operator(op);
+        }
+    }
+
+    constexpr void Factor() {
+        bool negative = peekIs(TokenType::OPERATOR, "-");
+        if (negative) {
+            next();
+        }
+        Primary(negative);
+    }
+
+    constexpr void Primary(bool negative = false) {
+        Token token = next();
+        if (token.type == TokenType::IDENTIFIER) {
+            if (peekIs(TokenType::SEPARATOR, "(")) {
+                next();
+                vector<string> arguments = IDS_names();
+                for (const string& argument : arguments) {
+                    PUSHM(argument);
+                }
+                CALL(token.value, arguments.size());
+                expect(TokenType::SEPARATOR, ")", "Error in Primary. Expected token type of ) for <Identifier> ( <IDs> )");
+            }
+            else {
+                PUSHM(token.value);
+            }
+            if (negative) {
+                negate_value();
+            }
+        }
+        else if (token.type == TokenType::INTEGER) {
+            PUSHI(integer_literal(token.value, negative));
+        }
+        else if (token.type == TokenType::REAL) {
+            //see real_literal() for the literals a constant expression takes
+            PUSHF(real_literal(token.value, negative));
+        }
+        else if (token.type == TokenType::KEYWORD && (token.value == "true" || token.value == "false")) {
+            Stack.push_back(Type::BOOLEAN);
+            generate_instruction(Opcode::PUSHB, token.value == "true");
+        }
+        else if (token.type == TokenType::SEPARATOR && token.value == "(") {
+            Expression();
+            expect(TokenType::SEPARATOR, ")", "Error in Primary. Expected token type of ) for <Identifier> ( <IDs> )");
+            if (negative) {
+                negate_value();
+            }
+        }
+        else {
+            throw "Error in Primary. <Identifier> | <Integer> | <Identifier> ( <IDs> ) | ( <Expression> ) | <Real> | true | false";
+        }
+    }
+
+public:
+    struct Program {
+        vector<Instruction> code;
+        vector<int64_t> constants; //PUSHK and PUSHF operands index these
+    };
+
+    constexpr explicit Constexpr_Compiler(string_view text) : source{text, 0} {}
+
+    //instruction table and constant pool of the program, an ill-formed
+    //program is not a constant expression
+    constexpr Program compile() {
+        lex();
+        Rat25S();
+        return {InstructTable, ConstantPool};
+    }
+};
+
+//program text as a template argument
+template <size_t N>
+struct Rat25S_Source {
+    char text[N];
+
+    consteval Rat25S_Source(const char (&source)[N]) : text() {
+        for (size_t i = 0; i < N; i++) {
+            text[i] = source[i];
+        }
+    }
+
+    constexpr string_view view() const {
+        return string_view(text, N - 1);
+    }
+};
+
+//Constexpr_Compiler::Program with its sizes fixed
+template <size_t N, size_t K>
+struct Rat25S_Program {
+    array<Instruction, N> code;
+    array<int64_t, K> constants;
+};
+
+//compiles a Rat25S program while the C++ program is being compiled
+//    constexpr auto program = compile_rat25s<"$$ $$ integer x; $$ x = 1; $$">();
+template <Rat25S_Source Source>
+consteval auto compile_rat25s() {
+    constexpr size_t count = Constexpr_Compiler(Source.view()).compile().code.size();
+    constexpr size_t constants = Constexpr_Compiler(Source.view()).compile().constants.size();
+    Rat25S_Program<count, constants> program{};
+    Constexpr_Compiler::Program compiled = Constexpr_Compiler(Source.view()).compile();
+    for (size_t i = 0; i < count; i++) {
+        program.code[i] = compiled.code[i];
+    }
+    for (size_t i = 0; i < constants; i++) {
+        program.constants[i] = compiled.constants[i];
+    }
+    return program;
+}
+
+//keeps the header compiled and in step with Symbol_and_Assembly for a small program,
+//tests/constexpr_test.cpp compiles t1..t5
+static_assert(compile_rat25s<"$$ $$ integer x; $$ x = 1; print(x); $$">().code.size() == 4);
+static_assert(compile_rat25s<"$$ $$ real x; $$ x = 2.5; $$">().constants[0] == real_bits(2.5));
+
+#endif
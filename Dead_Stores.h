@@ -0,0 +1,99 @@
+#ifndef DEAD_STORES_H
+#define DEAD_STORES_H
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+#include "Instruction.h"
+#include "Code_Rewriter.h"
+#include "CFG.h"
+#include "Liveness.h"
+using namespace std;
+
+//-O1: removes POPM and POPL stores to variables that are dead after them (see
+//Liveness.h), e.g. an initialisation overwritten before it is read
+//when the stored value is computed by side-effect-free code in the same block
+//that code goes with the store, as does the DUP of a DUP; POPM, otherwise the
+//store becomes a POP
+//removing an expression can make the stores feeding its reads dead, so the
+//caller runs it again while anything is removed
+class Dead_Stores {
+    const pmr::vector<int>& scratch; //see Liveness
+
+public:
+    size_t stores = 0;       //dead stores found
+    size_t popped = 0;       //of those, replaced by a POP
+    size_t instructions = 0; //instructions removed
+
+    explicit Dead_Stores(const pmr::vector<int>& scratch) : scratch(scratch) {}
+
+    //entries are the addresses control starts from (see Control_Flow_Graph)
+    //returns the number of dead stores found
+    size_t run(Code_Rewriter& rewriter, const vector<int>& entries) {
+        const auto& code = rewriter.code();
+        Control_Flow_Graph cfg(code, entries);
+        Liveness liveness(code, cfg, scratch);
+
+        enum Action : char { KEEP, REMOVE, POP };
+        vector<char> action(code.size(), KEEP);
+        size_t before = stores;
+        for (size_t b = 0; b < cfg.size(); b++) {
+            const auto& block = cfg[b];
+            Variable_Set live = liveness.live_out(b);
+            for (size_t i = block.end; i-- > block.begin;) {
+                const Instruction& instr = code[i];
+                if (!liveness.is_store(instr) || live.test(liveness.variable(instr))) {
+                    liveness.step(instr, live);
+                    continue;
+                }
+                stores++;
+                long start = expression_start(code, block.begin, i);
+                if (start < 0 && i > block.begin && code[i - 1].Operator == Opcode::DUP) {
+                    start = i - 1;
+                }
+                if (start < 0) {
+                    action[i] = POP;
+                    popped++;
+                    continue;
+                }
+                //the reads of a removed expression are not uses
+                for (size_t k = start; k <= i; k++) {
+                    action[k] = REMOVE;
+                }
+                instructions += i - start + 1;
+                i = start;
+            }
+        }
+
+        for (size_t i = 0; i < code.size(); i++) {
+            rewriter.begin(i);
+            if (action[i] == KEEP) {
+                rewriter.emit(code[i]);
+            }
+            else if (action[i] == POP) {
+                rewriter.emit(Instruction(Opcode::POP));
+            }
+        }
+        return stores - before;
+    }
+
+private:
+    //index where the value stored by code[store] starts being computed, -1
+    //when that is not side-effect-free code starting at or after first
+    static long expression_start(const pmr::vector<Instruction>& code, size_t first, size_t store) {
+        int needed = 1;
+        for (size_t k = store; k-- > first;) {
+            const Opcode_Info& info = code[k].info();
+            if (!is_pure(code, k) || info.pushes > needed) {
+                return -1;
+            }
+            needed += info.pops - info.pushes;
+            if (needed == 0) {
+                return k;
+            }
+        }
+        return -1;
+    }
+};
+
+#endif
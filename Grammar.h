@@ -0,0 +1,125 @@
+#ifndef GRAMMAR_H
+#define GRAMMAR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <charconv>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include "Type.h"
+#include "Instruction.h"
+using namespace std;
+
+//tables of the Rat25S grammar, read by SyntaxAnalyzer and Constexpr_Compiler
+
+struct Operator_Lexeme {
+    string_view lexeme;
+    Opcode op;
+};
+
+//<Relop>, with the comparison each one generates
+inline constexpr Operator_Lexeme RELOPS[] = {
+    {"==", Opcode::EQU}, {"!=", Opcode::NEQ}, {">", Opcode::GRT},
+    {"<", Opcode::LES},  {"<=", Opcode::LEQ}, {"=>", Opcode::GEQ}
+};
+
+//+ and - of <Expression>
+inline constexpr Operator_Lexeme ADDING_OPERATORS[] = {
+    {"+", Opcode::A}, {"-", Opcode::S}
+};
+
+//* and / of <Term>
+inline constexpr Operator_Lexeme MULTIPLYING_OPERATORS[] = {
+    {"*", Opcode::M}, {"/", Opcode::D}
+};
+
+//the instruction of lexeme in table, none when it is not there
+template <size_t N>
+constexpr optional<Opcode> operator_opcode(const Operator_Lexeme (&table)[N], string_view lexeme) {
+    for (const Operator_Lexeme& entry : table) {
+        if (entry.lexeme == lexeme) {
+            return entry.op;
+        }
+    }
+    return nullopt;
+}
+
+constexpr bool is_relop(string_view lexeme) {
+    return operator_opcode(RELOPS, lexeme).has_value();
+}
+
+//and, or and not
+constexpr bool is_condition_keyword(string_view keyword) {
+    return keyword == "and" || keyword == "or" || keyword == "not";
+}
+
+//type of a <Qualifier> keyword, UNDEFINED for any other
+constexpr Type qualifier_type(string_view keyword) {
+    if (keyword == "integer") {
+        return Type::INTEGER;
+    }
+    if (keyword == "boolean") {
+        return Type::BOOLEAN;
+    }
+    if (keyword == "real") {
+        return Type::REAL;
+    }
+    return Type::UNDEFINED;
+}
+
+//value of an integer literal, negated for - <Integer>
+constexpr int64_t integer_literal(string_view digits, bool negative) {
+    uint64_t limit = negative ? uint64_t(INT64_MAX) + 1 : uint64_t(INT64_MAX);
+    uint64_t magnitude = 0;
+    for (char digit : digits) {
+        if (digit < '0' || digit > '9' || magnitude > (limit - (digit - '0')) / 10) {
+            throw runtime_error("Integer literal out of range: " + string(digits));
+        }
+        magnitude = magnitude * 10 + (digit - '0');
+    }
+    return negative ? int64_t(0 - magnitude) : int64_t(magnitude);
+}
+
+//value of a real literal (digits . digits), negated for - <Real>
+//in a constant expression from_chars is not available: the literal is exact
+//when its digits without the point fit a double's 53 bits and it has at most
+//22 digits after the point (trailing zeros dropped), since both are then
+//doubles and one division rounds correctly; any other literal throws
+constexpr double real_literal(string_view digits, bool negative) {
+    if (!is_constant_evaluated()) {
+        double value = 0;
+        auto result = from_chars(digits.data(), digits.data() + digits.size(), value);
+        if (result.ec != errc() || result.ptr != digits.data() + digits.size()) {
+            throw runtime_error("Real literal out of range: " + string(digits));
+        }
+        return negative ? -value : value;
+    }
+    size_t point = digits.find('.');
+    string_view fraction = point == string_view::npos ? string_view() : digits.substr(point + 1);
+    while (!fraction.empty() && fraction.back() == '0') {
+        fraction.remove_suffix(1);
+    }
+    uint64_t mantissa = 0;
+    for (string_view part : {digits.substr(0, point), fraction}) {
+        for (char digit : part) {
+            if (digit < '0' || digit > '9' || mantissa > ((uint64_t(1) << 53) - (digit - '0')) / 10) {
+                throw runtime_error("Real literal is not exact in a constant expression: " + string(digits));
+            }
+            mantissa = mantissa * 10 + (digit - '0');
+        }
+    }
+    if (fraction.size() > 22) {
+        throw runtime_error("Real literal is not exact in a constant expression: " + string(digits));
+    }
+    double scale = 1;
+    for (size_t i = 0; i < fraction.size(); i++) {
+        scale *= 10;
+    }
+    double value = double(mantissa) / scale;
+    return negative ? -value : value;
+}
+
+#endif
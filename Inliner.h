@@ -0,0 +1,237 @@
+#ifndef INLINER_H
+#define INLINER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <utility>
+#include <vector>
+#include "Instruction.h"
+#include "Code_Rewriter.h"
+using namespace std;
+
+//-O2: replaces a CALL with a copy of the called function's body when the
+//function cannot reach itself and the copy is small enough
+//cost model: a copy may grow the code by INLINE_BUDGET instructions, doubled
+//for each loop around the call (up to INLINE_MAX_DEPTH), and all copies
+//together by at most the size of the code
+//the copy keeps the calling convention on the stack: the prologue pops the
+//arguments into memory instead of frame slots and a return jumps to the end
+//of the copy with its value on top
+class Inliner {
+public:
+    static constexpr int INLINE_BUDGET = 8;
+    static constexpr int INLINE_MAX_DEPTH = 3;
+
+    struct Function {
+        int entry;  //address of its ENTER
+        int end;    //address after its last instruction, 0 when not known
+        int params;
+        int frameSize;
+    };
+
+private:
+    vector<Function> functions;
+    //memory address for a function's frame slot
+    //a function that cannot reach itself is never running twice, so every copy
+    //of it shares the same memory
+    function<int(int function, int slot)> temporary;
+    map<pair<int, int>, int> memory;
+
+public:
+    size_t calls = 0;   //CALLs seen
+    size_t inlined = 0; //CALLs replaced
+
+    Inliner(vector<Function> functions, function<int(int function, int slot)> temporary)
+        : functions(std::move(functions)), temporary(std::move(temporary)) {}
+
+    //returns the number of CALLs replaced
+    size_t run(Code_Rewriter& rewriter) {
+        const auto& code = rewriter.code();
+        vector<int> callee = callees(code);
+        vector<bool> recursive = recursion(code, callee);
+        vector<int> depth = loop_depth(code);
+
+        size_t before = inlined;
+        long growth = 0;
+        for (size_t i = 0; i < code.size(); i++) {
+            rewriter.begin(i);
+            int f = callee[i];
+            if (code[i].Operator == Opcode::CALL) {
+                calls++;
+            }
+            if (f >= 0 && !recursive[f]) {
+                long cost = copy_size(code, f) - 1;
+                if (cost <= long(INLINE_BUDGET) << min(depth[i], INLINE_MAX_DEPTH) &&
+                    growth + cost <= long(code.size())) {
+                    copy(rewriter, f);
+                    growth += cost;
+                    inlined++;
+                    continue;
+                }
+            }
+            rewriter.emit(code[i]);
+        }
+        return inlined - before;
+    }
+
+private:
+    //index of the function a CALL goes to, -1 for every other instruction
+    //and for functions whose extent is not known
+    vector<int> callees(const pmr::vector<Instruction>& code) const {
+        vector<int> callee(code.size(), -1);
+        for (size_t i = 0; i < code.size(); i++) {
+            if (code[i].Operator != Opcode::CALL || !code[i].hasOperand) {
+                continue;
+            }
+            for (size_t f = 0; f < functions.size(); f++) {
+                if (functions[f].entry == code[i].Operand && functions[f].end) {
+                    callee[i] = f;
+                }
+            }
+        }
+        return callee;
+    }
+
+    //functions that can call themselves, directly or through others
+    vector<bool> recursion(const pmr::vector<Instruction>& code, const vector<int>& callee) const {
+        size_t count = functions.size();
+        vector<vector<int>> calls(count);
+        for (size_t f = 0; f < count; f++) {
+            for (int i = functions[f].entry - 1; functions[f].end && i < functions[f].end - 1; i++) {
+                if (code[i].Operator == Opcode::CALL) {
+                    //a call to an unknown function might lead anywhere
+                    calls[f].push_back(callee[i] >= 0 ? callee[i] : int(f));
+                }
+            }
+        }
+
+        vector<bool> recursive(count, false);
+        for (size_t f = 0; f < count; f++) {
+            vector<bool> seen(count, false);
+            vector<int> work(calls[f].begin(), calls[f].end());
+            while (!work.empty() && !recursive[f]) {
+                int g = work.back();
+                work.pop_back();
+                if (g == int(f)) {
+                    recursive[f] = true;
+                }
+                else if (!seen[g]) {
+                    seen[g] = true;
+                    work.insert(work.end(), calls[g].begin(), calls[g].end());
+                }
+            }
+        }
+        return recursive;
+    }
+
+    //number of loops around each instruction, a loop being a backward JMP
+    static vector<int> loop_depth(const pmr::vector<Instruction>& code) {
+        vector<int> depth(code.size() + 1, 0);
+        for (size_t i = 0; i < code.size(); i++) {
+            const Instruction& instr = code[i];
+            if (instr.Operator == Opcode::JMP && instr.hasOperand && size_t(instr.Operand) <= i + 1) {
+                depth[instr.Operand - 1]++;
+                depth[i + 1]--;
+            }
+        }
+        for (size_t i = 1; i < depth.size(); i++) {
+            depth[i] += depth[i - 1];
+        }
+        return depth;
+    }
+
+    //instructions a copy of the body of f takes
+    long copy_size(const pmr::vector<Instruction>& code, int f) const {
+        const Function& function = functions[f];
+        long size = 0;
+        long returns = 0;
+        for (int i = function.entry - 1; i < function.end - 1; i++) {
+            if (code[i].Operator == Opcode::RET) {
+                returns++;
+            }
+            else if (code[i].Operator != Opcode::ENTER) {
+                size++;
+            }
+        }
+        //the locals are zeroed, every return but the last jumps to a LABEL
+        size += 2 * (function.frameSize - function.params);
+        return size + (returns > 1 ? returns : 0);
+    }
+
+    int slot_memory(int f, int slot) {
+        auto it = memory.find({f, slot});
+        if (it == memory.end()) {
+            it = memory.emplace(pair<int, int>(f, slot), temporary(f, slot)).first;
+        }
+        return it->second;
+    }
+
+    //emits the body of f in place of a CALL to it
+    void copy(Code_Rewriter& rewriter, int f) {
+        const Function& function = functions[f];
+        const auto& code = rewriter.code();
+        int first = function.entry - 1;
+        int last = function.end - 2; //the final RET
+
+        //new index of each instruction of the body, for the jumps inside it
+        vector<int> position(last - first + 1);
+        int next = rewriter.emitted().size();
+        int returns = 0;
+        for (int i = first; i <= last; i++) {
+            position[i - first] = next;
+            if (code[i].Operator == Opcode::ENTER) {
+                next += 2 * (function.frameSize - function.params);
+            }
+            else if (code[i].Operator == Opcode::RET) {
+                returns++;
+                next += i == last ? 0 : 1;
+            }
+            else {
+                next++;
+            }
+        }
+        int end = next + 1; //address of the LABEL after the copy
+
+        for (int i = first; i <= last; i++) {
+            const Instruction& instr = code[i];
+            switch (instr.Operator) {
+                case Opcode::ENTER:
+                    for (int slot = function.params; slot < function.frameSize; slot++) {
+                        rewriter.emit(Instruction(Opcode::PUSHI, 0));
+                        rewriter.emit(Instruction(Opcode::POPM, slot_memory(f, slot)));
+                    }
+                    break;
+                case Opcode::PUSHL:
+                    rewriter.emit(Instruction(Opcode::PUSHM, slot_memory(f, instr.Operand)));
+                    break;
+                case Opcode::POPL:
+                    rewriter.emit(Instruction(Opcode::POPM, slot_memory(f, instr.Operand)));
+                    break;
+                case Opcode::RET:
+                    if (i != last) {
+                        rewriter.emit_placed(Instruction(Opcode::JMP, end));
+                    }
+                    break;
+                case Opcode::JMP:
+                case Opcode::JMP0:
+                case Opcode::JMP1:
+                    if (instr.hasOperand && instr.Operand - 1 >= first && instr.Operand - 1 <= last) {
+                        rewriter.emit_placed(Instruction(instr.Operator, position[instr.Operand - 1 - first] + 1));
+                        break;
+                    }
+                    rewriter.emit(instr);
+                    break;
+                default:
+                    rewriter.emit(instr);
+                    break;
+            }
+        }
+        if (returns > 1) {
+            rewriter.emit(Instruction(Opcode::LABEL));
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,424 @@
+#ifndef INSTRUCTION_H
+#define INSTRUCTION_H
+
+#include <cstddef>
+#include <bit>
+#include <cstdint>
+#include <string_view>
+#include <stdexcept>
+#include <string>
+#include <memory_resource>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+#include "Type.h"
+using namespace std;
+
+enum class Opcode : uint8_t {
+    PUSHI, PUSHB, PUSHU, PUSHK, PUSHF, PUSHM, POPM, PUSHL, POPL, DUP, POP,
+    SOUT, SIN, SOUTF, SINF,
+    A, S, M, D, SHL, SHR, AND,
+    GRT, LES, EQU, NEQ, GEQ, LEQ,
+    GRTB, LESB, EQUB, NEQB, GEQB, LEQB,
+    AF, SF, MF, DF,
+    GRTF, LESF, EQUF, NEQF, GEQF, LEQF,
+    ITOF, ITOF2,
+    JMP0, JMP1, JMP, LABEL,
+    CALL, ENTER, RET
+};
+
+//how the result type of an operator follows from its operand types
+enum class Type_Rule : uint8_t {
+    NONE,
+    ARITHMETIC, //INTEGER, INTEGER -> INTEGER, REAL with anything -> REAL, anything else UNDEFINED
+    COMPARISON  //always BOOLEAN
+};
+
+//what an operand refers to, used for relocation and address renumbering
+enum class Operand_Kind : uint8_t {
+    NONE,
+    VALUE,       //literal
+    MEMORY,      //data memory address
+    INSTRUCTION, //instruction address
+    CONSTANT,    //constant pool index
+    SLOT         //slot in the current function's frame
+};
+
+struct Opcode_Info {
+    const char* name;
+    uint8_t pops;    //operand stack entries consumed
+    uint8_t pushes;  //operand stack entries produced
+    Type_Rule rule;
+    Operand_Kind operand;
+    uint8_t cost;    //relative execution cost, A being 1 (M and D follow integer multiply and divide latencies, the F forms double precision ones)
+};
+
+//indexed by Opcode
+inline constexpr Opcode_Info OPCODE_TABLE[] = {
+    {"PUSHI", 0, 1, Type_Rule::NONE,       Operand_Kind::VALUE,       1},
+    {"PUSHB", 0, 1, Type_Rule::NONE,       Operand_Kind::VALUE,       1},
+    {"PUSHU", 0, 1, Type_Rule::NONE,       Operand_Kind::NONE,        1},
+    {"PUSHK", 0, 1, Type_Rule::NONE,       Operand_Kind::CONSTANT,    1},
+    {"PUSHF", 0, 1, Type_Rule::NONE,       Operand_Kind::CONSTANT,    1}, //the pool entry holds the bits of a double
+    {"PUSHM", 0, 1, Type_Rule::NONE,       Operand_Kind::MEMORY,      1},
+    {"POPM",  1, 0, Type_Rule::NONE,       Operand_Kind::MEMORY,      1},
+    {"PUSHL", 0, 1, Type_Rule::NONE,       Operand_Kind::SLOT,        1},
+    {"POPL",  1, 0, Type_Rule::NONE,       Operand_Kind::SLOT,        1},
+    {"DUP",   1, 2, Type_Rule::NONE,       Operand_Kind::NONE,        1},
+    {"POP",   1, 0, Type_Rule::NONE,       Operand_Kind::NONE,        1},
+    {"SOUT",  1, 0, Type_Rule::NONE,       Operand_Kind::NONE,        1},
+    {"SIN",   1, 1, Type_Rule::NONE,       Operand_Kind::NONE,        1}, //replaces the placeholder on TOS with the value read
+    {"SOUTF", 1, 0, Type_Rule::NONE,       Operand_Kind::NONE,        1},
+    {"SINF",  1, 1, Type_Rule::NONE,       Operand_Kind::NONE,        1},
+    {"A",     2, 1, Type_Rule::ARITHMETIC, Operand_Kind::NONE,        1},
+    {"S",     2, 1, Type_Rule::ARITHMETIC, Operand_Kind::NONE,        1},
+    {"M",     2, 1, Type_Rule::ARITHMETIC, Operand_Kind::NONE,        4},
+    {"D",     2, 1, Type_Rule::ARITHMETIC, Operand_Kind::NONE,        24},
+    {"SHL",   2, 1, Type_Rule::ARITHMETIC, Operand_Kind::NONE,        1}, //second << first, the count taken mod 64
+    {"SHR",   2, 1, Type_Rule::ARITHMETIC, Operand_Kind::NONE,        1}, //second >> first keeping the sign, the count taken mod 64
+    {"AND",   2, 1, Type_Rule::ARITHMETIC, Operand_Kind::NONE,        1}, //bitwise
+    {"GRT",   2, 1, Type_Rule::COMPARISON, Operand_Kind::NONE,        1},
+    {"LES",   2, 1, Type_Rule::COMPARISON, Operand_Kind::NONE,        1},
+    {"EQU",   2, 1, Type_Rule::COMPARISON, Operand_Kind::NONE,        1},
+    {"NEQ",   2, 1, Type_Rule::COMPARISON, Operand_Kind::NONE,        1},
+    {"GEQ",   2, 1, Type_Rule::COMPARISON, Operand_Kind::NONE,        1},
+    {"LEQ",   2, 1, Type_Rule::COMPARISON, Operand_Kind::NONE,        1},
+    {"GRTB",  2, 1, Type_Rule::COMPARISON, Operand_Kind::NONE,        1}, //the B forms compare BOOLEAN operands
+    {"LESB",  2, 1, Type_Rule::COMPARISON, Operand_Kind::NONE,        1},
+    {"EQUB",  2, 1, Type_Rule::COMPARISON, Operand_Kind::NONE,        1},
+    {"NEQB",  2, 1, Type_Rule::COMPARISON, Operand_Kind::NONE,        1},
+    {"GEQB",  2, 1, Type_Rule::COMPARISON, Operand_Kind::NONE,        1},
+    {"LEQB",  2, 1, Type_Rule::COMPARISON, Operand_Kind::NONE,        1},
+    {"AF",    2, 1, Type_Rule::ARITHMETIC, Operand_Kind::NONE,        4}, //the F forms work on REAL operands
+    {"SF",    2, 1, Type_Rule::ARITHMETIC, Operand_Kind::NONE,        4},
+    {"MF",    2, 1, Type_Rule::ARITHMETIC, Operand_Kind::NONE,        4},
+    {"DF",    2, 1, Type_Rule::ARITHMETIC, Operand_Kind::NONE,        14},
+    {"GRTF",  2, 1, Type_Rule::COMPARISON, Operand_Kind::NONE,        1},
+    {"LESF",  2, 1, Type_Rule::COMPARISON, Operand_Kind::NONE,        1},
+    {"EQUF",  2, 1, Type_Rule::COMPARISON, Operand_Kind::NONE,        1},
+    {"NEQF",  2, 1, Type_Rule::COMPARISON, Operand_Kind::NONE,        1},
+    {"GEQF",  2, 1, Type_Rule::COMPARISON, Operand_Kind::NONE,        1},
+    {"LEQF",  2, 1, Type_Rule::COMPARISON, Operand_Kind::NONE,        1},
+    {"ITOF",  1, 1, Type_Rule::NONE,       Operand_Kind::NONE,        4}, //converts the INTEGER on TOS to REAL
+    {"ITOF2", 2, 2, Type_Rule::NONE,       Operand_Kind::NONE,        4}, //converts the INTEGER below TOS
+    {"JMP0",  1, 0, Type_Rule::NONE,       Operand_Kind::INSTRUCTION, 1},
+    {"JMP1",  1, 0, Type_Rule::NONE,       Operand_Kind::INSTRUCTION, 1}, //jumps when the popped value is not 0
+    {"JMP",   0, 0, Type_Rule::NONE,       Operand_Kind::INSTRUCTION, 1},
+    {"LABEL", 0, 0, Type_Rule::NONE,       Operand_Kind::NONE,        0},
+    {"CALL",  0, 1, Type_Rule::NONE,       Operand_Kind::INSTRUCTION, 2}, //also pops the callee's arguments
+    {"ENTER", 0, 0, Type_Rule::NONE,       Operand_Kind::VALUE,       1}, //new frame of Operand slots, all 0
+    {"RET",   1, 0, Type_Rule::NONE,       Operand_Kind::NONE,        2}, //leaves the popped value for the caller
+};
+
+inline constexpr size_t OPCODE_COUNT = sizeof(OPCODE_TABLE) / sizeof(OPCODE_TABLE[0]);
+
+constexpr const Opcode_Info& opcode_info(Opcode op) {
+    return OPCODE_TABLE[size_t(op)];
+}
+
+constexpr const char* opcode_name(Opcode op) {
+    return opcode_info(op).name;
+}
+
+constexpr int opcode_cost(Opcode op) {
+    return opcode_info(op).cost;
+}
+
+inline Opcode opcode_from_name(string_view name) {
+    for (size_t i = 0; i < OPCODE_COUNT; i++) {
+        if (name == OPCODE_TABLE[i].name) {
+            return Opcode(i);
+        }
+    }
+    throw runtime_error("Unknown operator " + string(name));
+}
+
+//type pushed by a binary operator, first is the top of the stack
+constexpr Type result_type(Type_Rule rule, Type first, Type second) {
+    if (rule == Type_Rule::COMPARISON) {
+        return Type::BOOLEAN;
+    }
+    if (first == Type::INTEGER && second == Type::INTEGER) {
+        return Type::INTEGER;
+    }
+    if (first == Type::REAL || second == Type::REAL) {
+        return Type::REAL;
+    }
+    return Type::UNDEFINED;
+}
+
+//the form of binary operator op (A, S, M, D, GRT, LES, EQU, NEQ, GEQ, LEQ)
+//for operands of types first (the top of the stack) and second, so nothing
+//at run time depends on a type
+//the operators as named in the listings work on INTEGER, comparisons of
+//BOOLEAN operands have B forms and A, S, M, D and the comparisons of REAL
+//operands F forms
+//an INTEGER operand of a REAL one is converted first (see conversion())
+//throws for operands an operator does not take and for an UNDEFINED one (e.g.
+//the result of a function whose return type is not known), no form fits it
+constexpr Opcode typed_opcode(Opcode op, Type first, Type second) {
+    const Opcode_Info& info = opcode_info(op);
+    if (first == Type::UNDEFINED || second == Type::UNDEFINED) {
+        throw runtime_error(string("Type of an operand of ") + info.name + " is not known");
+    }
+    if (first != second) {
+        throw runtime_error(string("Type mismatch: ") + info.name + " of " + type_name(second) + " and " +
+                            type_name(first));
+    }
+    Type operands = first;
+    if (operands == Type::REAL) {
+        return info.rule == Type_Rule::COMPARISON ? Opcode(size_t(op) - size_t(Opcode::GRT) + size_t(Opcode::GRTF))
+                                                  : Opcode(size_t(op) - size_t(Opcode::A) + size_t(Opcode::AF));
+    }
+    if (operands != Type::BOOLEAN) {
+        return op;
+    }
+    if (info.rule != Type_Rule::COMPARISON) {
+        throw runtime_error(string("Type mismatch: ") + info.name + " of Boolean values");
+    }
+    return Opcode(size_t(op) - size_t(Opcode::GRT) + size_t(Opcode::GRTB));
+}
+
+//type of the value op pushes when op alone tells it, UNDEFINED for PUSHM,
+//PUSHL, DUP and CALL, which push a value of the type of what they read
+constexpr Type pushed_type(Opcode op) {
+    const Opcode_Info& info = opcode_info(op);
+    if (info.rule == Type_Rule::COMPARISON || op == Opcode::PUSHB) {
+        return Type::BOOLEAN;
+    }
+    if ((op >= Opcode::AF && op <= Opcode::DF) || op == Opcode::PUSHF || op == Opcode::SINF || op == Opcode::ITOF) {
+        return Type::REAL;
+    }
+    if (op == Opcode::PUSHM || op == Opcode::PUSHL || op == Opcode::DUP || op == Opcode::CALL) {
+        return Type::UNDEFINED;
+    }
+    return Type::INTEGER;
+}
+
+//ITOF or ITOF2 when one operand of a binary operator is INTEGER and the other
+//REAL, none when the types need no conversion
+constexpr optional<Opcode> conversion(Type first, Type second) {
+    if (first == Type::INTEGER && second == Type::REAL) {
+        return Opcode::ITOF;
+    }
+    if (first == Type::REAL && second == Type::INTEGER) {
+        return Opcode::ITOF2;
+    }
+    return nullopt;
+}
+
+//the code of binary operator op for operands of types first (the top of the
+//stack) and second: the conversion (none when there is none), the form of op
+//and the type it pushes
+struct Typed_Operator {
+    optional<Opcode> convert;
+    Opcode op;
+    Type result;
+};
+
+constexpr Typed_Operator typed_operator(Opcode op, Type first, Type second) {
+    optional<Opcode> convert = conversion(first, second);
+    if (convert) {
+        first = second = Type::REAL;
+    }
+    return {convert, typed_opcode(op, first, second), result_type(opcode_info(op).rule, first, second)};
+}
+
+//ITOF when a value of type value stored into a variable of type variable is
+//widened first, none otherwise
+constexpr optional<Opcode> widening(Type variable, Type value) {
+    if (variable == Type::REAL && value == Type::INTEGER) {
+        return Opcode::ITOF;
+    }
+    return nullopt;
+}
+
+//SOUT or SOUTF, throws for an UNDEFINED value
+constexpr Opcode print_opcode(Type value) {
+    if (value == Type::UNDEFINED) {
+        throw runtime_error("Type of a printed value is not known");
+    }
+    return value == Type::REAL ? Opcode::SOUTF : Opcode::SOUT;
+}
+
+//SIN or SINF
+constexpr Opcode scan_opcode(Type variable) {
+    return variable == Type::REAL ? Opcode::SINF : Opcode::SIN;
+}
+
+//type of a variable after a value is stored in it: a variable whose type is
+//not known yet takes the value's
+//throws when the value's type is not known or differs from the variable's (an
+//INTEGER value for a REAL variable is converted with ITOF before the store)
+constexpr Type stored_type(Type variable, Type value, string_view name) {
+    if (value == Type::UNDEFINED) {
+        throw runtime_error("Type of the value assigned to " + string(name) + " is not known");
+    }
+    if (variable != Type::UNDEFINED && variable != value) {
+        throw runtime_error(string("Type mismatch: ") + type_name(value) + " value assigned to " +
+                            type_name(variable) + " variable " + string(name));
+    }
+    return value;
+}
+
+//throws unless function name, of type function, can return a value of type
+//value (an INTEGER value of a REAL function is converted with ITOF first)
+constexpr void check_return(Type function, Type value, string_view name) {
+    if (function == Type::UNDEFINED) {
+        throw runtime_error("Return type of function " + string(name) + " is not known");
+    }
+    if (value == Type::UNDEFINED) {
+        throw runtime_error("Type of the value returned from function " + string(name) + " is not known");
+    }
+    if (value != function) {
+        throw runtime_error(string("Type mismatch: ") + type_name(value) + " value returned from " +
+                            type_name(function) + " function " + string(name));
+    }
+}
+
+//one instruction of the instruction table, packed into 8 bytes
+//the address is the position in the table (+1) and is not stored
+struct Instruction {
+    Opcode Operator;
+    bool hasOperand = false;
+    int32_t Operand = 0;
+
+    constexpr Instruction(Opcode op = Opcode::LABEL) : Operator(op) {}
+    constexpr Instruction(Opcode op, int32_t operand) : Operator(op), hasOperand(true), Operand(operand) {}
+
+    constexpr const Opcode_Info& info() const {
+        return opcode_info(Operator);
+    }
+
+    constexpr bool operator==(const Instruction&) const = default;
+};
+
+static_assert(sizeof(Instruction) == 8, "Instruction should pack into 8 bytes");
+
+//a CALL to a function of another object file (see Object_File) has no
+//operand until Linker gives it the entry, Operand holds the index of the
+//callee in the object's externals meanwhile
+constexpr Instruction external_call(int external) {
+    Instruction call(Opcode::CALL);
+    call.Operand = external;
+    return call;
+}
+
+constexpr bool is_external_call(const Instruction& instr) {
+    return instr.Operator == Opcode::CALL && !instr.hasOperand;
+}
+
+//JMP0 or JMP1, pops the condition and may fall through
+constexpr bool is_branch(Opcode op) {
+    return op == Opcode::JMP0 || op == Opcode::JMP1;
+}
+
+//only reads memory and the stack, so it can be removed or computed again
+//D and DF are not, a division by zero faults (see the overload below)
+constexpr bool is_pure(Opcode op) {
+    return op == Opcode::PUSHI || op == Opcode::PUSHB || op == Opcode::PUSHU || op == Opcode::PUSHK ||
+           op == Opcode::PUSHF || op == Opcode::PUSHM || op == Opcode::PUSHL || op == Opcode::DUP ||
+           op == Opcode::ITOF ||
+           (opcode_info(op).rule != Type_Rule::NONE && op != Opcode::D && op != Opcode::DF);
+}
+
+//is_pure for code[k], which is also true for a D or DF whose divisor is a
+//PUSHI other than 0 right before it (converted by ITOF for DF)
+template <typename Code>
+constexpr bool is_pure(const Code& code, size_t k) {
+    Opcode op = code[k].Operator;
+    if (op != Opcode::D && op != Opcode::DF) {
+        return is_pure(op);
+    }
+    size_t divisor = k;
+    if (op == Opcode::DF && divisor > 0 && code[divisor - 1].Operator == Opcode::ITOF) {
+        divisor--;
+    }
+    return divisor > 0 && code[divisor - 1].Operator == Opcode::PUSHI && code[divisor - 1].Operand != 0;
+}
+
+//what a scan pushes for the SIN or SINF that replaces it with the value read
+constexpr Instruction scan_placeholder(Type variable) {
+    if (variable == Type::BOOLEAN) {
+        return Instruction(Opcode::PUSHB, 0);
+    }
+    if (variable == Type::INTEGER) {
+        return Instruction(Opcode::PUSHI, 0);
+    }
+    return Instruction(Opcode::PUSHU);
+}
+
+//literals in this range are PUSHI operands, the rest go to the constant pool
+constexpr bool fits_operand(int64_t value) {
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+//the pool entry of a REAL literal, its bits (PUSHF pushes them)
+constexpr int64_t real_bits(double value) {
+    return bit_cast<int64_t>(value);
+}
+
+constexpr double real_value(int64_t bits) {
+    return bit_cast<double>(bits);
+}
+
+//literals too large for an operand and REAL literals, PUSHK and PUSHF refer
+//to them by index
+class Constant_Pool {
+    pmr::vector<int64_t> values;
+    pmr::unordered_map<int64_t, int> indexOf;
+    pmr::vector<char> realFlags; //per entry, a PUSHF refers to it (only for listings)
+
+public:
+    explicit Constant_Pool(pmr::memory_resource* memory = pmr::get_default_resource())
+        : values(memory), indexOf(memory), realFlags(memory) {}
+
+    //pool index of value, equal values share one entry
+    //real marks an entry holding real_bits()
+    int index(int64_t value, bool real = false) {
+        auto inserted = indexOf.emplace(value, values.size());
+        if (inserted.second) {
+            values.push_back(value);
+            realFlags.push_back(0);
+        }
+        realFlags[inserted.first->second] |= real;
+        return inserted.first->second;
+    }
+
+    span<const char> reals() const {
+        return realFlags;
+    }
+
+    pmr::polymorphic_allocator<int64_t> get_allocator() const {
+        return values.get_allocator();
+    }
+
+    int64_t operator[](size_t i) const {
+        return values[i];
+    }
+
+    size_t size() const {
+        return values.size();
+    }
+
+    bool empty() const {
+        return values.empty();
+    }
+
+    void clear() {
+        values.clear();
+        indexOf.clear();
+        realFlags.clear();
+    }
+
+    auto begin() const {
+        return values.begin();
+    }
+
+    auto end() const {
+        return values.end();
+    }
+};
+
+#endif
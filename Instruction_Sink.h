@@ -0,0 +1,32 @@
+#ifndef INSTRUCTION_SINK_H
+#define INSTRUCTION_SINK_H
+
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include "Instruction.h"
+using namespace std;
+
+//where Symbol_and_Assembly hands finished instructions when it streams the
+//instruction table instead of keeping it (see Symbol_and_Assembly::stream)
+class Instruction_Sink {
+public:
+    virtual ~Instruction_Sink() = default;
+
+    //the instructions starting at index, every index is written once and in order
+    virtual void write(size_t index, span<const Instruction> code) = 0;
+
+    //true when an instruction that was already written can still be replaced,
+    //otherwise the generator holds back everything a pending patch can reach
+    virtual bool can_patch() const {
+        return false;
+    }
+
+    virtual void patch(size_t index, const Instruction& instr) {
+        (void)index;
+        (void)instr;
+        throw runtime_error("Instruction was already written");
+    }
+};
+
+#endif
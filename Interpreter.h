@@ -0,0 +1,314 @@
+#ifndef INTERPRETER_H
+#define INTERPRETER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <memory_resource>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Instruction.h"
+#include "Linker.h"
+#include "Stack_Verifier.h"
+using namespace std;
+
+//runs an instruction table, reading scan() values from in and writing print()
+//values to out, one per line
+//memory starts at Object_File::MEMORY_BASE and holds 0 until written
+//a CALL remembers where to return and where the caller's slots end, the
+//callee's ENTER adds its frame after them and RET drops it again
+//booleans are 1 and 0, SIN reads true, false or an integer, arithmetic wraps
+//a real is the bits of a double in the same 64 bit cell (see real_bits()),
+//only the F forms, ITOF, SOUTF and SINF treat a cell as one
+//the operand stack is allocated once from what Stack_Verifier proved the code
+//needs, so pushes and pops are not checked; with recursion each CALL makes
+//room for the frame_depth() of its callee
+class Interpreter {
+public:
+    static constexpr size_t MAX_CALL_DEPTH = 100000;
+
+private:
+    const pmr::vector<Instruction>& code;
+    const Constant_Pool& pool;
+    const Stack_Verifier& verifier;
+    istream& in;
+    ostream& out;
+
+    struct Frame {
+        size_t returnIndex; //instruction after the CALL
+        size_t slotBase;    //first slot of the callee
+    };
+
+    vector<int64_t> memory;
+    vector<int64_t> slots;
+    vector<int64_t> stack;
+    size_t sp = 0; //entries in use
+    vector<Frame> frames;
+
+public:
+    struct Execution {
+        size_t instructions = 0; //executed
+        size_t jumps = 0;        //of those, JMP, JMP0 and JMP1
+        size_t cost = 0;         //their opcode_cost() summed
+    };
+
+    //verifier must have checked code
+    Interpreter(const pmr::vector<Instruction>& code, const Constant_Pool& pool, const Stack_Verifier& verifier,
+                istream& in, ostream& out)
+        : code(code), pool(pool), verifier(verifier), in(in), out(out) {}
+
+    //runs until control leaves the table
+    Execution run() {
+        Execution executed;
+        bool bounded = verifier.max_depth() != Stack_Verifier::UNBOUNDED;
+        stack.assign(bounded ? verifier.max_depth() : verifier.frame_depth(1), 0);
+        sp = 0;
+        size_t pc = 0;
+        while (pc < code.size()) {
+            const Instruction& instr = code[pc++];
+            executed.instructions++;
+            executed.cost += opcode_cost(instr.Operator);
+            executed.jumps += instr.Operator == Opcode::JMP || is_branch(instr.Operator);
+            switch (instr.Operator) {
+                case Opcode::PUSHI:
+                case Opcode::PUSHB:
+                    push(instr.Operand);
+                    break;
+                case Opcode::PUSHU:
+                    push(0);
+                    break;
+                case Opcode::PUSHK:
+                case Opcode::PUSHF:
+                    push(pool[instr.Operand]);
+                    break;
+                case Opcode::PUSHM:
+                    push(cell(instr.Operand));
+                    break;
+                case Opcode::POPM:
+                    cell(instr.Operand) = pop();
+                    break;
+                case Opcode::PUSHL:
+                    push(slot(instr.Operand));
+                    break;
+                case Opcode::POPL:
+                    slot(instr.Operand) = pop();
+                    break;
+                case Opcode::DUP:
+                    push(top());
+                    break;
+                case Opcode::POP:
+                    pop();
+                    break;
+                case Opcode::SOUT:
+                    out << pop() << "\n";
+                    break;
+                case Opcode::SIN:
+                    pop();
+                    push(read());
+                    break;
+                case Opcode::SOUTF:
+                    out << real_value(pop()) << "\n";
+                    break;
+                case Opcode::SINF:
+                    pop();
+                    push(real_bits(read_real()));
+                    break;
+                case Opcode::ITOF:
+                    push(real_bits(double(pop())));
+                    break;
+                case Opcode::ITOF2: {
+                    int64_t first = pop();
+                    push(real_bits(double(pop())));
+                    push(first);
+                    break;
+                }
+                case Opcode::JMP0:
+                    if (pop() == 0) {
+                        pc = instr.Operand - 1;
+                    }
+                    break;
+                case Opcode::JMP1:
+                    if (pop() != 0) {
+                        pc = instr.Operand - 1;
+                    }
+                    break;
+                case Opcode::JMP:
+                    pc = instr.Operand - 1;
+                    break;
+                case Opcode::LABEL:
+                    break;
+                case Opcode::CALL:
+                    if (frames.size() == MAX_CALL_DEPTH) {
+                        throw runtime_error("Call stack overflow");
+                    }
+                    if (!bounded) {
+                        size_t needed = sp - verifier.arity(instr.Operand) + verifier.frame_depth(instr.Operand);
+                        if (needed > stack.size()) {
+                            stack.resize(max(needed, 2 * stack.size()), 0);
+                        }
+                    }
+                    frames.push_back({pc, slots.size()});
+                    pc = instr.Operand - 1;
+                    break;
+                case Opcode::ENTER:
+                    if (frames.empty()) {
+                        throw runtime_error("ENTER outside a call at address " + to_string(pc));
+                    }
+                    slots.resize(frames.back().slotBase + instr.Operand, 0);
+                    break;
+                case Opcode::RET: {
+                    if (frames.empty()) {
+                        throw runtime_error("RET outside a call at address " + to_string(pc));
+                    }
+                    int64_t value = pop();
+                    slots.resize(frames.back().slotBase);
+                    pc = frames.back().returnIndex;
+                    frames.pop_back();
+                    push(value);
+                    break;
+                }
+                default: {
+                    int64_t first = pop();
+                    int64_t second = pop();
+                    push(binary(instr.Operator, second, first));
+                    break;
+                }
+            }
+        }
+        return executed;
+    }
+
+private:
+    void push(int64_t value) {
+        stack[sp++] = value;
+    }
+
+    int64_t top() const {
+        return stack[sp - 1];
+    }
+
+    int64_t pop() {
+        return stack[--sp];
+    }
+
+    int64_t& cell(int address) {
+        if (address < Object_File::MEMORY_BASE) {
+            throw runtime_error("Invalid memory address " + to_string(address));
+        }
+        size_t offset = address - Object_File::MEMORY_BASE;
+        if (offset >= memory.size()) {
+            memory.resize(offset + 1, 0);
+        }
+        return memory[offset];
+    }
+
+    int64_t& slot(int index) {
+        size_t base = frames.empty() ? 0 : frames.back().slotBase;
+        if (index < 0 || base + index >= slots.size()) {
+            throw runtime_error("Invalid frame slot " + to_string(index));
+        }
+        return slots[base + index];
+    }
+
+    int64_t read() {
+        string word;
+        if (!(in >> word)) {
+            throw runtime_error("No input left for scan");
+        }
+        if (word == "true") {
+            return 1;
+        }
+        if (word == "false") {
+            return 0;
+        }
+        try {
+            size_t used = 0;
+            int64_t value = stoll(word, &used);
+            if (used == word.size()) {
+                return value;
+            }
+        }
+        catch (const exception&) {
+        }
+        throw runtime_error("Invalid input " + word);
+    }
+
+    double read_real() {
+        string word;
+        if (!(in >> word)) {
+            throw runtime_error("No input left for scan");
+        }
+        try {
+            size_t used = 0;
+            double value = stod(word, &used);
+            if (used == word.size()) {
+                return value;
+            }
+        }
+        catch (const exception&) {
+        }
+        throw runtime_error("Invalid input " + word);
+    }
+
+    //second op first for the F forms, on the doubles the cells hold
+    static int64_t real_binary(Opcode op, double second, double first) {
+        switch (op) {
+            case Opcode::AF: return real_bits(second + first);
+            case Opcode::SF: return real_bits(second - first);
+            case Opcode::MF: return real_bits(second * first);
+            case Opcode::DF: return real_bits(second / first);
+            case Opcode::GRTF: return second > first;
+            case Opcode::LESF: return second < first;
+            case Opcode::EQUF: return second == first;
+            case Opcode::NEQF: return second != first;
+            case Opcode::GEQF: return second >= first;
+            case Opcode::LEQF: return second <= first;
+            default: throw runtime_error(string("Cannot execute ") + opcode_name(op));
+        }
+    }
+
+    static int64_t binary(Opcode op, int64_t second, int64_t first) {
+        switch (op) {
+            case Opcode::A: return int64_t(uint64_t(second) + uint64_t(first));
+            case Opcode::S: return int64_t(uint64_t(second) - uint64_t(first));
+            case Opcode::M: return int64_t(uint64_t(second) * uint64_t(first));
+            case Opcode::D:
+                if (first == 0) {
+                    throw runtime_error("Division by zero");
+                }
+                return first == -1 ? int64_t(0 - uint64_t(second)) : second / first;
+            case Opcode::SHL: return int64_t(uint64_t(second) << (first & 63));
+            case Opcode::SHR: return second >> (first & 63);
+            case Opcode::AND: return second & first;
+            case Opcode::GRT:
+            case Opcode::GRTB: return second > first;
+            case Opcode::LES:
+            case Opcode::LESB: return second < first;
+            case Opcode::EQU:
+            case Opcode::EQUB: return second == first;
+            case Opcode::NEQ:
+            case Opcode::NEQB: return second != first;
+            case Opcode::GEQ:
+            case Opcode::GEQB: return second >= first;
+            case Opcode::LEQ:
+            case Opcode::LEQB: return second <= first;
+            case Opcode::AF:
+            case Opcode::SF:
+            case Opcode::MF:
+            case Opcode::DF:
+            case Opcode::GRTF:
+            case Opcode::LESF:
+            case Opcode::EQUF:
+            case Opcode::NEQF:
+            case Opcode::GEQF:
+            case Opcode::LEQF:
+                return real_binary(op, real_value(second), real_value(first));
+            default: throw runtime_error(string("Cannot execute ") + opcode_name(op));
+        }
+    }
+};
+
+#endif
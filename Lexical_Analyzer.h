@@ -12,10 +12,10 @@
 #define LEXICAL_ANALYZER_H
 
 #include <string>
+#include <string_view>
 #include <iostream>
-#include <unordered_map>
 #include <vector>
-#include <cctype> //for tolower
+#include <cstdio> //for EOF
 #include <iomanip>
 #include <fstream> //for output files
 #include "TokenType.h"
@@ -27,13 +27,21 @@ enum State {
     COMMENT
 };
 
+//the lexer reads its characters from a Source with int get(), EOF at the
+//end, and unget(int); the rules are constexpr so Constexpr_Compiler lexes a
+//string_view with them
 class LexicalAnalyzer {
-    unordered_map<string, TokenType> keywords; //to store keywords
-    char myChar; //to get current character
+    int myChar = 0; //to get current character
     State state = State::START;
 
+    //all keywords
+    static constexpr string_view keywords[] = {
+        "integer", "real", "if", "else", "endif", "while", "endwhile", "scan", "print",
+        "function", "boolean", "true", "false", "return", "break", "and", "or", "not"
+    };
+
     //fsm for identifiers, int, and real
-    int identifier[6][3] = {
+    static constexpr int identifier[6][3] = {
         {2, 6, 6},
         {3, 4, 5},
         {3, 4, 5},
@@ -42,7 +50,7 @@ class LexicalAnalyzer {
         {6, 6, 6}
     };
 
-    int int_union_real[5][2] = {
+    static constexpr int int_union_real[5][2] = {
         {2, 5},
         {2, 3},
         {4, 5},
@@ -50,29 +58,29 @@ class LexicalAnalyzer {
         {5, 5}
     };
 
+    //characters of a file
+    struct File_Source {
+        FILE* filePointer;
+
+        int get() {
+            return getc(filePointer);
+        }
+
+        void unget(int c) {
+            ungetc(c, filePointer);
+        }
+    };
+
 public:
-    //initalizes all keyword
-    LexicalAnalyzer() {
-        keywords["integer"] = TokenType::KEYWORD;
-        keywords["real"] = TokenType::KEYWORD;
-        keywords["if"] = TokenType::KEYWORD;
-        keywords["else"] = TokenType::KEYWORD;
-        keywords["endif"] = TokenType::KEYWORD;
-        keywords["while"] = TokenType::KEYWORD;
-        keywords["endwhile"] = TokenType::KEYWORD;
-        keywords["scan"] = TokenType::KEYWORD;
-        keywords["print"] = TokenType::KEYWORD;
-        keywords["function"] = TokenType::KEYWORD;
-        keywords["boolean"] = TokenType::KEYWORD;
-        keywords["true"] = TokenType::KEYWORD;
-        keywords["false"] = TokenType::KEYWORD;
-        keywords["return"] = TokenType::KEYWORD;
-        keywords["break"] = TokenType::KEYWORD;
+    Token lexer(FILE* filePointer) {
+        File_Source source{filePointer};
+        return lexer(source);
     }
 
     //reads all lexemes, sends to the FSM functions to be categorized (return Token types)
     //or categorizes (returns token types) themselves
-    Token lexer(FILE* filePointer) {
+    template <typename Source>
+    constexpr Token lexer(Source& source) {
 
         //gets first chatacter
         // 1. if there is a number or punctuation, sends it so it can be categorized into int/real
@@ -85,36 +93,36 @@ public:
         // 8. if it is none of the above, categorizes as unknown
 
         //inside comment state, checks if we are at ] so it can go back to start state
-        while ((myChar = getc(filePointer)) != EOF) {
+        while ((myChar = source.get()) != EOF) {
             switch (state) {
             case State::START:
-                if (isdigit(myChar) || myChar == '.') {
-                    return FSM_int_real(filePointer);
+                if (isDigit(myChar) || myChar == '.') {
+                    return FSM_int_real(source);
                 }
-                else if (isalpha(myChar)) {
-                    return FSM_identifier(filePointer);
+                else if (isAlpha(myChar)) {
+                    return FSM_identifier(source);
                 }
                 else if (isOperator(myChar)) {
-                    char nextChar = getc(filePointer);
-                    string op(1, myChar);
+                    int nextChar = source.get();
+                    string op(1, char(myChar));
                     if (nextChar == '=' || (myChar == '=' && nextChar == '>')) {
-                        op += nextChar; // for operators like <=, >=, ==, !=
+                        op += char(nextChar); // for operators like <=, >=, ==, !=
                     }
                     else {
-                        ungetc(nextChar, filePointer);
+                        source.unget(nextChar);
                     }
                     return Token(TokenType::OPERATOR, op);
                 }
                 else if (isSeparator(myChar)) {
-                    return Token(TokenType::SEPARATOR, string(1, myChar));
+                    return Token(TokenType::SEPARATOR, string(1, char(myChar)));
                 }
                 else if (myChar == '$') {
-                    char nextChar = getc(filePointer);
+                    int nextChar = source.get();
                     if (myChar == '$' && nextChar == '$') {
                         return Token(TokenType::SEPARATOR, "$$");
                     }
                     else {
-                        ungetc(nextChar, filePointer);
+                        source.unget(nextChar);
                         return Token(TokenType::UNKNOWN, "$");
                     }
                 }
@@ -125,7 +133,7 @@ public:
                     continue;
                 }
                 else {
-                    return Token(TokenType::UNKNOWN, string(1, myChar));
+                    return Token(TokenType::UNKNOWN, string(1, char(myChar)));
                 }
                 break;
 
@@ -140,29 +148,53 @@ public:
         return Token(TokenType::UNKNOWN, "");
     }
 
+    //checks keyword
+    static constexpr bool isKeyword(string_view lexeme) {
+        for (string_view keyword : keywords) {
+            if (keyword == lexeme) {
+                return true;
+            }
+        }
+        return false;
+    }
+
 private:
 
     //checks operator
-    bool isOperator(char c) {
+    static constexpr bool isOperator(int c) {
         return c == '+' || c == '-' || c == '*' || c == '/' || c == '%' || c == '=' || c == '<' || c == '>' || c == '!';
     }
 
     //checks seperator
-    bool isSeparator(char c) {
+    static constexpr bool isSeparator(int c) {
         return c == ';' || c == ',' || c == '(' || c == ')' || c == '{' || c == '}';
     }
 
     //checks whitespace
-    bool isWhiteSpace(char c) {
+    static constexpr bool isWhiteSpace(int c) {
         return c == ' ' || c == '\n' || c == '\t';
     }
 
+    //isdigit, isalpha and tolower of the C locale
+    static constexpr bool isDigit(int c) {
+        return c >= '0' && c <= '9';
+    }
+
+    static constexpr bool isAlpha(int c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    }
+
+    static constexpr char toLower(int c) {
+        return char(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+    }
+
     //categorizes fsm identifier
-    Token FSM_identifier(FILE* filePointer) {
+    template <typename Source>
+    constexpr Token FSM_identifier(Source& source) {
         string lexeme;
 
         //gets first string and starts as state 2 (since we went from 1 -> letter -> 2)
-        lexeme += tolower(myChar);
+        lexeme += toLower(myChar);
         int state = 2;
 
         //gets next character
@@ -172,23 +204,22 @@ private:
         //4. if whitespace/operator/seperator, puts char back to buffer, checks if it is a keyword
         //4. , identifier, or invalid combination and categorizes
         //5. if it is an invalid symbol, adds into lexeme, changes state to 6 to symbolize it is invalid
-        while ((myChar = getc(filePointer)) != EOF) {
-            if (isalpha(myChar)) {
-                myChar = tolower(myChar);
-                lexeme += myChar;
+        while ((myChar = source.get()) != EOF) {
+            if (isAlpha(myChar)) {
+                lexeme += toLower(myChar);
                 state = identifier[state - 1][0];
             }
-            else if (isdigit(myChar)) {
-                lexeme += myChar;
+            else if (isDigit(myChar)) {
+                lexeme += char(myChar);
                 state = identifier[state - 1][1];
             }
             else if (myChar == '_') {
-                lexeme += myChar;
+                lexeme += char(myChar);
                 state = identifier[state - 1][2];
             }
             else if (isWhiteSpace(myChar) || isOperator(myChar) || isSeparator(myChar)) {
-                ungetc(myChar, filePointer);
-                if (keywords.find(lexeme) != keywords.end()) {
+                source.unget(myChar);
+                if (isKeyword(lexeme)) {
                     return Token(TokenType::KEYWORD, lexeme);
                 }
                 else if (state > 1 && state < 6) {
@@ -199,7 +230,7 @@ private:
                 }
             }
             else {
-                lexeme += myChar;
+                lexeme += char(myChar);
                 state = 6;
 
             }
@@ -211,12 +242,13 @@ private:
 
 
     //categorizes fsm integer or real
-    Token FSM_int_real(FILE* filePointer) {
+    template <typename Source>
+    constexpr Token FSM_int_real(Source& source) {
         string lexeme;
         int state = 1;
 
         //adds first character into lexeme
-        lexeme += myChar;
+        lexeme += char(myChar);
 
         //1. if first character is ., changes state (this is an invalid state)
         //2. if first character is digit, changes state
@@ -232,17 +264,17 @@ private:
         //2. if character is a ., adds into lexeme, changes state
         //3. if character isn't any of the above, puts char back to buffer, checks if it state 2 and categorizes
         //3. into integer, state 4 for real, and if it is not any of these states, then it is unknown (invalid)
-        while ((myChar = getc(filePointer)) != EOF) {
-            if (isdigit(myChar)) {
-                lexeme += myChar;
+        while ((myChar = source.get()) != EOF) {
+            if (isDigit(myChar)) {
+                lexeme += char(myChar);
                 state = int_union_real[state - 1][0];
             }
             else if (myChar == '.') {
-                lexeme += myChar;
+                lexeme += char(myChar);
                 state = int_union_real[state - 1][1];
             }
             else {
-                ungetc(myChar, filePointer);
+                source.unget(myChar);
                 if (state == 2) {
                     return Token(TokenType::INTEGER, lexeme);
                 }
@@ -267,6 +299,36 @@ private:
     }
 };
 
+//writes the column headers of Lexical_Analysis_Output.txt
+inline void write_lexical_header(ostream& outFile) {
+    outFile << "\nOutput:\n";
+    outFile << "                    token                             lexeme\n";
+    outFile << "------------------------------------------------------------\n";
+}
+
+//writes one token as a row of Lexical_Analysis_Output.txt
+inline void write_lexical_row(ostream& outFile, const Token& token) {
+    string type;
+    switch (token.type) {
+    case TokenType::KEYWORD: type = "keyword";
+        break;
+    case TokenType::IDENTIFIER: type = "identifier";
+        break;
+    case TokenType::INTEGER: type = "integer";
+        break;
+    case TokenType::REAL: type = "real";
+        break;
+    case TokenType::OPERATOR: type = "operator";
+        break;
+    case TokenType::SEPARATOR: type = "separator";
+        break;
+    default: type = "unknown";
+        break;
+    }
+
+    outFile << "                   " << left << setw(35) << type << token.value << endl;
+}
+
 #endif
 // int main() {
 
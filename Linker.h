@@ -0,0 +1,358 @@
+#ifndef LINKER_H
+#define LINKER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include "Type.h"
+#include "Instruction.h"
+using namespace std;
+
+//relocatable output of one compiled source file
+//memory operands are relative to MEMORY_BASE, instruction operands to the
+//start of this file's code and PUSHK operands to this file's constant pool
+//until Linker places them
+//a CALL to a function the file does not define has no operand (see
+//external_call), Linker gives it the entry of the function with that name
+struct Object_File {
+    static constexpr int MEMORY_BASE = 10000;
+    static constexpr int VERSION = 3;
+
+    enum Relocation_Kind { MEMORY, INSTRUCTION, CONSTANT, EXTERNAL };
+
+    struct Global {
+        string name;
+        Type type;
+        int offset; //memory address - MEMORY_BASE
+    };
+
+    struct Function {
+        string name;
+        int entry; //instruction address of the first instruction
+        int params;
+        Type returnType;
+    };
+
+    //a function called here and defined in another object file
+    struct External {
+        string name;
+        int arguments;
+        Type returnType; //the type the calls were compiled for
+    };
+
+    struct Relocation {
+        int index;            //code entry whose operand is rewritten
+        Relocation_Kind kind;
+        int global;           //globals entry (MEMORY) or externals entry (EXTERNAL) the operand refers to
+    };
+
+    vector<Global> globals;
+    vector<Function> functions;
+    vector<External> externals;
+    vector<Instruction> code;
+    vector<int64_t> constants;
+    vector<Relocation> relocations;
+
+    static string typeToString(Type type) {
+        switch (type) {
+            case Type::INTEGER: return "Integer";
+            case Type::BOOLEAN: return "Boolean";
+            case Type::REAL: return "Real";
+            default: return "Undefined";
+        }
+    }
+
+    static Type stringToType(const string& type) {
+        if (type == "Integer") return Type::INTEGER;
+        if (type == "Boolean") return Type::BOOLEAN;
+        if (type == "Real") return Type::REAL;
+        return Type::UNDEFINED;
+    }
+
+    void write(ostream& out) const {
+        out << "RAT25S-OBJECT " << VERSION << "\n";
+        out << "GLOBALS " << globals.size() << "\n";
+        for (const auto& global : globals) {
+            out << global.name << "\t" << typeToString(global.type) << "\t" << global.offset << "\n";
+        }
+        out << "FUNCTIONS " << functions.size() << "\n";
+        for (const auto& function : functions) {
+            out << function.name << "\t" << function.entry << "\t" << function.params << "\t"
+                << typeToString(function.returnType) << "\n";
+        }
+        out << "EXTERNALS " << externals.size() << "\n";
+        for (const auto& external : externals) {
+            out << external.name << "\t" << external.arguments << "\t" << typeToString(external.returnType) << "\n";
+        }
+        out << "CODE " << code.size() << "\n";
+        for (const auto& instr : code) {
+            out << opcode_name(instr.Operator) << "\t";
+            if (instr.hasOperand) {
+                out << instr.Operand;
+            } else {
+                out << "-";
+            }
+            out << "\n";
+        }
+        out << "CONSTANTS " << constants.size() << "\n";
+        for (int64_t value : constants) {
+            out << value << "\n";
+        }
+        out << "RELOCATIONS " << relocations.size() << "\n";
+        for (const auto& reloc : relocations) {
+            out << reloc.index << "\t" << "MIKX"[reloc.kind] << "\t" << reloc.global << "\n";
+        }
+        out << "END\n";
+    }
+
+    static Object_File read(istream& in) {
+        Object_File object;
+        string word;
+        size_t count;
+
+        in >> word >> count;
+        if (word != "RAT25S-OBJECT") {
+            throw runtime_error("Not a Rat25S object file");
+        }
+        if (count != VERSION) {
+            throw runtime_error("Rat25S object file of version " + to_string(count) + ", compile it again");
+        }
+
+        expect(in, "GLOBALS", count);
+        object.globals.resize(count);
+        for (auto& global : object.globals) {
+            in >> global.name >> word >> global.offset;
+            global.type = stringToType(word);
+        }
+
+        expect(in, "FUNCTIONS", count);
+        object.functions.resize(count);
+        for (auto& function : object.functions) {
+            in >> function.name >> function.entry >> function.params >> word;
+            function.returnType = stringToType(word);
+        }
+
+        expect(in, "EXTERNALS", count);
+        object.externals.resize(count);
+        for (auto& external : object.externals) {
+            in >> external.name >> external.arguments >> word;
+            external.returnType = stringToType(word);
+        }
+
+        expect(in, "CODE", count);
+        object.code.resize(count);
+        for (auto& instr : object.code) {
+            in >> word;
+            instr = Instruction(opcode_from_name(word));
+            in >> word;
+            if (word != "-") {
+                instr = Instruction(instr.Operator, stoi(word));
+            }
+        }
+
+        expect(in, "CONSTANTS", count);
+        object.constants.resize(count);
+        for (auto& value : object.constants) {
+            in >> value;
+        }
+
+        expect(in, "RELOCATIONS", count);
+        object.relocations.resize(count);
+        for (auto& reloc : object.relocations) {
+            in >> reloc.index >> word >> reloc.global;
+            if (word != "M" && word != "I" && word != "K" && word != "X") {
+                corrupt("relocation kind " + word);
+            }
+            reloc.kind = word == "M" ? MEMORY : word == "K" ? CONSTANT : word == "X" ? EXTERNAL : INSTRUCTION;
+        }
+
+        in >> word;
+        if (!in || word != "END") {
+            throw runtime_error("Truncated Rat25S object file");
+        }
+        object.validate();
+        for (const auto& reloc : object.relocations) {
+            if (reloc.kind == EXTERNAL) {
+                object.code[reloc.index] = external_call(reloc.global);
+            }
+        }
+        return object;
+    }
+
+private:
+    [[noreturn]] static void corrupt(const string& what) {
+        throw runtime_error("Corrupt Rat25S object file: " + what);
+    }
+
+    //every index and offset read is in range, so the linker can use them as they are
+    void validate() const {
+        for (const auto& global : globals) {
+            if (global.offset < 0 || global.offset > INT32_MAX - MEMORY_BASE) {
+                corrupt("global " + global.name + " at offset " + to_string(global.offset));
+            }
+        }
+        for (const auto& function : functions) {
+            if (function.entry < 1 || size_t(function.entry) > code.size()) {
+                corrupt("function " + function.name + " at address " + to_string(function.entry));
+            }
+            if (function.params < 0) {
+                corrupt("function " + function.name + " with " + to_string(function.params) + " parameters");
+            }
+        }
+        for (const auto& external : externals) {
+            if (external.arguments < 0) {
+                corrupt("call of " + external.name + " with " + to_string(external.arguments) + " arguments");
+            }
+        }
+        for (const auto& reloc : relocations) {
+            if (reloc.index < 0 || size_t(reloc.index) >= code.size()) {
+                corrupt("relocation of instruction " + to_string(reloc.index));
+            }
+            const Instruction& instr = code[reloc.index];
+            if (reloc.kind == EXTERNAL) {
+                if (!is_external_call(instr) || reloc.global < 0 || size_t(reloc.global) >= externals.size()) {
+                    corrupt("call of instruction " + to_string(reloc.index));
+                }
+                continue;
+            }
+            Operand_Kind expected = reloc.kind == MEMORY ? Operand_Kind::MEMORY
+                                  : reloc.kind == CONSTANT ? Operand_Kind::CONSTANT : Operand_Kind::INSTRUCTION;
+            if (!instr.hasOperand || instr.info().operand != expected) {
+                corrupt("relocation of instruction " + to_string(reloc.index) + " (" + opcode_name(instr.Operator) + ")");
+            }
+            bool inRange = reloc.kind == MEMORY ? reloc.global >= 0 && size_t(reloc.global) < globals.size()
+                         : reloc.kind == CONSTANT ? instr.Operand >= 0 && size_t(instr.Operand) < constants.size()
+                         : instr.Operand >= 1 && size_t(instr.Operand) <= code.size() + 1;
+            if (!inRange) {
+                corrupt("operand of instruction " + to_string(reloc.index));
+            }
+        }
+    }
+
+    static void expect(istream& in, const string& section, size_t& count) {
+        string word;
+        in >> word >> count;
+        if (!in || word != section) {
+            throw runtime_error("Expected " + section + " section in object file");
+        }
+    }
+};
+
+//merges object files into one program
+//globals with the same name are the same variable, functions must be unique
+//and equal constants share one pool entry
+//the compiler's temporaries (names with a '.', which no identifier has) stay
+//private to their object, two files' loop.1 are different memory
+//a call to another file is bound by finish(), once every file is added
+//each add() is linear in the size of the object being added
+class Linker {
+    Object_File program;
+    unordered_map<string, int> globalIndex;
+    unordered_map<string, int> functionIndex;
+    unordered_map<int64_t, int> constantIndex;
+
+    //a CALL in program still waiting for a function of another file
+    struct Call {
+        int index;
+        Object_File::External callee;
+    };
+    vector<Call> calls;
+
+public:
+    void add(const Object_File& object) {
+        //resolve this file's globals to program globals
+        vector<int> resolved(object.globals.size());
+        for (size_t i = 0; i < object.globals.size(); i++) {
+            const auto& global = object.globals[i];
+            auto it = globalIndex.find(global.name);
+            if (it == globalIndex.end() || global.name.find('.') != string::npos) {
+                int index = program.globals.size();
+                program.globals.push_back({global.name, global.type, index});
+                globalIndex.emplace(global.name, index);
+                resolved[i] = index;
+            }
+            else {
+                Type& linkedType = program.globals[it->second].type;
+                if (linkedType == Type::UNDEFINED) {
+                    linkedType = global.type;
+                }
+                else if (global.type != Type::UNDEFINED && global.type != linkedType) {
+                    throw runtime_error("Conflicting types for global " + global.name);
+                }
+                resolved[i] = it->second;
+            }
+        }
+
+        //resolve this file's constants to program pool entries
+        vector<int> constant(object.constants.size());
+        for (size_t i = 0; i < object.constants.size(); i++) {
+            auto inserted = constantIndex.emplace(object.constants[i], program.constants.size());
+            if (inserted.second) {
+                program.constants.push_back(object.constants[i]);
+            }
+            constant[i] = inserted.first->second;
+        }
+
+        int base = program.code.size();
+
+        for (const auto& function : object.functions) {
+            if (!functionIndex.emplace(function.name, program.functions.size()).second) {
+                throw runtime_error("Duplicate definition of function " + function.name);
+            }
+            program.functions.push_back({function.name, function.entry + base, function.params, function.returnType});
+        }
+
+        program.code.insert(program.code.end(), object.code.begin(), object.code.end());
+
+        //rewrite operands, keeping the relocations so the result can be linked again
+        for (const auto& reloc : object.relocations) {
+            Instruction& instr = program.code[base + reloc.index];
+            if (reloc.kind == Object_File::MEMORY) {
+                instr.Operand = Object_File::MEMORY_BASE + program.globals[resolved[reloc.global]].offset;
+                program.relocations.push_back({base + reloc.index, Object_File::MEMORY, resolved[reloc.global]});
+            }
+            else if (reloc.kind == Object_File::EXTERNAL) {
+                calls.push_back({base + reloc.index, object.externals[reloc.global]});
+            }
+            else if (reloc.kind == Object_File::CONSTANT) {
+                instr.Operand = constant[instr.Operand];
+                program.relocations.push_back({base + reloc.index, Object_File::CONSTANT, 0});
+            }
+            else {
+                instr.Operand += base;
+                program.relocations.push_back({base + reloc.index, Object_File::INSTRUCTION, 0});
+            }
+        }
+    }
+
+    //binds every call to another file, throws for a function no file
+    //defines or one that does not match how it was called
+    const Object_File& finish() {
+        for (const auto& call : calls) {
+            auto it = functionIndex.find(call.callee.name);
+            if (it == functionIndex.end()) {
+                throw runtime_error("Undefined function: " + call.callee.name);
+            }
+            const Object_File::Function& function = program.functions[it->second];
+            if (function.params != call.callee.arguments) {
+                throw runtime_error("Function " + function.name + " expects " + to_string(function.params) +
+                                    " arguments, called with " + to_string(call.callee.arguments));
+            }
+            if (function.returnType != call.callee.returnType) {
+                throw runtime_error("Type mismatch: function " + function.name + " returns " +
+                                    Object_File::typeToString(function.returnType) + ", called as " +
+                                    Object_File::typeToString(call.callee.returnType));
+            }
+            program.code[call.index] = Instruction(Opcode::CALL, function.entry);
+            program.relocations.push_back({call.index, Object_File::INSTRUCTION, 0});
+        }
+        calls.clear();
+        return program;
+    }
+};
+
+#endif
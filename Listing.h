@@ -0,0 +1,114 @@
+#ifndef LISTING_H
+#define LISTING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include "Type.h"
+#include "Instruction.h"
+#include "Instruction_Sink.h"
+using namespace std;
+
+//the text tables written by Symbol_and_Assembly and by the disassembler
+
+inline void write_instruction_listing_header(ostream& out) {
+    out << "\n=== INSTRUCTION TABLE ===\n";
+    out << "ADDR\tOPERATOR\tOPERAND\n";
+    out << "------------------------\n";
+}
+
+inline void write_instruction_row(ostream& out, size_t address, const Instruction& instr) {
+    out << address << "\t" << opcode_name(instr.Operator) << "\t\t";
+    if (instr.hasOperand) {
+        out << instr.Operand;
+    } else {
+        out << "-";
+    }
+    out << "\n";
+}
+
+inline void write_instruction_listing(ostream& out, span<const Instruction> code) {
+    write_instruction_listing_header(out);
+    for (size_t i = 0; i < code.size(); i++) {
+        write_instruction_row(out, i + 1, code[i]);
+    }
+}
+
+//written only when there are constants, entries flagged in reals (PUSHF
+//operands) as the double they hold
+inline void write_constant_listing(ostream& out, span<const int64_t> constants, span<const char> reals) {
+    if (constants.empty()) {
+        return;
+    }
+    out << "\n=== CONSTANT POOL ===\n";
+    out << "INDEX\tVALUE\n";
+    out << "------------------------\n";
+    for (size_t i = 0; i < constants.size(); i++) {
+        out << i << "\t";
+        if (i < reals.size() && reals[i]) {
+            out << real_value(constants[i]) << "\n";
+        }
+        else {
+            out << constants[i] << "\n";
+        }
+    }
+}
+
+//depth of a program Stack_Verifier has not checked (e.g. a streamed one)
+inline constexpr long STACK_NOT_VERIFIED = -2;
+
+//written only for a verified program, depth -1 when recursion leaves it unbounded
+inline void write_stack_listing(ostream& out, long depth) {
+    if (depth == STACK_NOT_VERIFIED) {
+        return;
+    }
+    out << "\n=== OPERAND STACK ===\n";
+    out << "MAX DEPTH\t" << (depth < 0 ? "unbounded (recursive calls)" : to_string(depth)) << "\n";
+}
+
+inline void write_symbol_listing_header(ostream& out) {
+    out << "\n=== SYMBOL TABLE ===\n";
+    out << "NAME\t\tADDRESS\t\tType\n";
+    out << "--------------------------------\n";
+}
+
+//a local's address is its frame slot, shown as L<slot>
+inline void write_symbol_row(ostream& out, string_view name, bool local, int address, Type type) {
+    out << name << "\t\t" << (local ? "L" : "") << address;
+    switch (type) {
+        case Type::INTEGER:
+            out << "\t\t" << "Integer" << endl;
+            break;
+        case Type::BOOLEAN:
+            out << "\t\t" << "Boolean" << endl;
+            break;
+        case Type::REAL:
+            out << "\t\t" << "Real" << endl;
+            break;
+        default:
+            out << "\t\t" << "Undefined" << endl;
+            break;
+    }
+}
+
+//the instruction table of a listing, written as the program is generated
+//rows have no fixed width, so nothing written can be patched
+class Listing_Sink : public Instruction_Sink {
+    ostream& out;
+
+public:
+    explicit Listing_Sink(ostream& out) : out(out) {
+        write_instruction_listing_header(out);
+    }
+
+    void write(size_t index, span<const Instruction> code) override {
+        for (size_t i = 0; i < code.size(); i++) {
+            write_instruction_row(out, index + i + 1, code[i]);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,163 @@
+#ifndef LIVENESS_H
+#define LIVENESS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+#include "Instruction.h"
+#include "CFG.h"
+using namespace std;
+
+//a set of Liveness variables, one bit each
+class Variable_Set {
+    vector<uint64_t> words;
+
+public:
+    explicit Variable_Set(size_t count = 0) : words((count + 63) / 64, 0) {}
+
+    bool test(int variable) const {
+        return words[variable / 64] >> (variable % 64) & 1;
+    }
+
+    void set(int variable) {
+        words[variable / 64] |= uint64_t(1) << (variable % 64);
+    }
+
+    void reset(int variable) {
+        words[variable / 64] &= ~(uint64_t(1) << (variable % 64));
+    }
+
+    Variable_Set& operator|=(const Variable_Set& other) {
+        for (size_t i = 0; i < words.size(); i++) {
+            words[i] |= other.words[i];
+        }
+        return *this;
+    }
+
+    bool operator==(const Variable_Set&) const = default;
+};
+
+//backward liveness of memory addresses and frame slots over a control flow graph
+//a variable is live at a point when some path from there reads it before
+//writing it
+//globals (memory addresses) are live wherever control leaves the code seen
+//here: at a RET (the caller may read them), at the end of the table (the next
+//linked file may) and at a CALL (the callee may)
+//frame slots are never live across a RET, and a CALL does not touch the
+//caller's frame, so the slots of all functions can share variables
+//scratch addresses (e.g. the memory of inlined frames) are read only by the
+//code that wrote them and are dead where control leaves
+class Liveness {
+    unordered_map<int, int> variableOfAddress;
+    size_t globalCount = 0;
+    size_t slotCount = 0;
+    Variable_Set globals; //live where control leaves
+    vector<Variable_Set> liveIn;
+    vector<Variable_Set> liveOut;
+
+public:
+    Liveness(const pmr::vector<Instruction>& code, const Control_Flow_Graph& cfg, const pmr::vector<int>& scratch = {}) {
+        for (const auto& instr : code) {
+            if (instr.info().operand == Operand_Kind::MEMORY) {
+                variableOfAddress.emplace(instr.Operand, variableOfAddress.size());
+            }
+            else if (instr.info().operand == Operand_Kind::SLOT) {
+                slotCount = max(slotCount, size_t(instr.Operand) + 1);
+            }
+        }
+        globalCount = variableOfAddress.size();
+        globals = Variable_Set(variables());
+        for (size_t v = 0; v < globalCount; v++) {
+            globals.set(v);
+        }
+        for (int address : scratch) {
+            auto it = variableOfAddress.find(address);
+            if (it != variableOfAddress.end()) {
+                globals.reset(it->second);
+            }
+        }
+        solve(code, cfg);
+    }
+
+    size_t variables() const {
+        return globalCount + slotCount;
+    }
+
+    //variable a PUSHM, POPM, PUSHL or POPL refers to, -1 for other instructions
+    int variable(const Instruction& instr) const {
+        switch (instr.info().operand) {
+            case Operand_Kind::MEMORY: return variableOfAddress.at(instr.Operand);
+            case Operand_Kind::SLOT: return globalCount + instr.Operand;
+            default: return -1;
+        }
+    }
+
+    bool is_store(const Instruction& instr) const {
+        return instr.Operator == Opcode::POPM || instr.Operator == Opcode::POPL;
+    }
+
+    const Variable_Set& live_in(int block) const {
+        return liveIn[block];
+    }
+
+    const Variable_Set& live_out(int block) const {
+        return liveOut[block];
+    }
+
+    //turns the variables live after instr into those live before it
+    void step(const Instruction& instr, Variable_Set& live) const {
+        int v = variable(instr);
+        if (v >= 0) {
+            if (is_store(instr)) {
+                live.reset(v);
+            }
+            else {
+                live.set(v);
+            }
+        }
+        else if (instr.Operator == Opcode::CALL) {
+            live |= globals;
+        }
+    }
+
+private:
+    //control can leave the table from the end of block: it has no successor
+    //or ends in a jump past the last instruction
+    static bool leaves(const pmr::vector<Instruction>& code, const Control_Flow_Graph::Block& block) {
+        const Instruction& last = code[block.end - 1];
+        bool jump = last.Operator == Opcode::JMP || is_branch(last.Operator);
+        return block.successors.empty() || (jump && size_t(last.Operand) > code.size());
+    }
+
+    void solve(const pmr::vector<Instruction>& code, const Control_Flow_Graph& cfg) {
+        liveIn.assign(cfg.size(), Variable_Set(variables()));
+        liveOut.assign(cfg.size(), Variable_Set(variables()));
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (size_t b = cfg.size(); b-- > 0;) {
+                const auto& block = cfg[b];
+                Variable_Set out(variables());
+                if (leaves(code, block)) {
+                    out = globals;
+                }
+                for (int successor : block.successors) {
+                    out |= liveIn[successor];
+                }
+                Variable_Set in = out;
+                for (size_t i = block.end; i-- > block.begin;) {
+                    step(code[i], in);
+                }
+                if (!(in == liveIn[b]) || !(out == liveOut[b])) {
+                    liveIn[b] = std::move(in);
+                    liveOut[b] = std::move(out);
+                    changed = true;
+                }
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,230 @@
+#ifndef LOOP_INVARIANTS_H
+#define LOOP_INVARIANTS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "Instruction.h"
+#include "Code_Rewriter.h"
+#include "CFG.h"
+using namespace std;
+
+//-O1: computes expressions whose operands do not change in a loop once, in a
+//preheader before the loop, and stores them in a temporary the loop reads
+//loops are those of Control_Flow_Graph::loops(), e.g. the LABEL JMP0 ... JMP
+//of a while
+//an expression is invariant when it only reads literals and variables the
+//loop does not store to, and is moved when it has an operator (moving a
+//single push saves nothing)
+//the preheader runs even when the loop body does not, so a division is moved
+//only out of the header, which runs every time the loop is entered
+//loops with a CALL are left alone: the callee may store to any variable and
+//may run the loop again, overwriting its temporaries
+//moving out of an inner loop puts the code in the outer one, so the caller
+//runs it again while anything moves, inner loops first
+class Loop_Invariants {
+    //one temporary per moved expression, given the index of the instruction
+    //that pushes its value, which has the temporary's type
+    function<int(size_t)> temporary;
+
+    using Loop = Control_Flow_Graph::Loop;
+
+    //instructions begin..end (inclusive) computing one value
+    struct Hoist {
+        size_t begin;
+        size_t end;
+        int temporary;
+    };
+
+    //a stack entry while scanning a block
+    struct Value {
+        long begin;     //first instruction computing it, -1 when pushed before the block
+        size_t end;     //the instruction that pushed it
+        bool invariant;
+        bool computed;  //has an operator
+        bool divides;   //has a D
+    };
+
+public:
+    size_t loops = 0;        //loops given a preheader
+    size_t hoisted = 0;      //expressions moved
+    size_t instructions = 0; //instructions moved
+
+    explicit Loop_Invariants(function<int(size_t)> temporary) : temporary(std::move(temporary)) {}
+
+    //entries are the addresses control starts from (see Control_Flow_Graph)
+    //returns the number of expressions moved
+    size_t run(Code_Rewriter& rewriter, const vector<int>& entries) {
+        const auto& code = rewriter.code();
+        Control_Flow_Graph cfg(code, entries);
+        vector<Loop> found = candidate_loops(code, cfg);
+
+        //inner loops first, an outer loop waits for the next run when one of
+        //its inner loops moved something
+        sort(found.begin(), found.end(), [](const Loop& a, const Loop& b) {
+            return a.last - a.header < b.last - b.header;
+        });
+        vector<char> moved(cfg.size(), 0); //blocks of loops that moved something
+        vector<vector<Hoist>> preheader(code.size());
+        vector<long> replaced(code.size(), -1); //hoist begin -> temporary
+        vector<size_t> replacedEnd(code.size(), 0);
+        size_t before = hoisted;
+        for (const Loop& loop : found) {
+            if (any_of(moved.begin() + loop.header, moved.begin() + loop.last + 1, [](char m) { return m; })) {
+                continue;
+            }
+            vector<Hoist> hoists = invariants(code, cfg, loop);
+            if (hoists.empty()) {
+                continue;
+            }
+            for (Hoist& hoist : hoists) {
+                hoist.temporary = temporary(hoist.end);
+                replaced[hoist.begin] = hoist.temporary;
+                replacedEnd[hoist.begin] = hoist.end;
+                instructions += hoist.end - hoist.begin + 1;
+            }
+            hoisted += hoists.size();
+            loops++;
+            fill(moved.begin() + loop.header, moved.begin() + loop.last + 1, 1);
+            preheader[cfg[loop.header].begin] = std::move(hoists);
+        }
+
+        for (size_t i = 0; i < code.size(); i++) {
+            rewriter.begin(i);
+            if (!preheader[i].empty()) {
+                for (const Hoist& hoist : preheader[i]) {
+                    for (size_t k = hoist.begin; k <= hoist.end; k++) {
+                        rewriter.emit(code[k]);
+                    }
+                    rewriter.emit(Instruction(Opcode::POPM, hoist.temporary));
+                }
+                //the back edge still goes to the header
+                rewriter.merge(i, rewriter.emitted().size());
+            }
+            if (replaced[i] < 0) {
+                rewriter.emit(code[i]);
+                continue;
+            }
+            rewriter.emit(Instruction(Opcode::PUSHM, replaced[i]));
+            for (size_t end = replacedEnd[i]; i < end;) {
+                rewriter.begin(++i);
+            }
+        }
+        return hoisted - before;
+    }
+
+private:
+    //loops that can be given a preheader and have no CALL
+    static vector<Loop> candidate_loops(const pmr::vector<Instruction>& code, const Control_Flow_Graph& cfg) {
+        vector<Loop> loops;
+        for (const Loop& loop : cfg.loops(code)) {
+            bool calls = false;
+            for (size_t i = cfg[loop.header].begin; i < cfg[loop.last].end; i++) {
+                calls = calls || code[i].Operator == Opcode::CALL;
+            }
+            if (!calls) {
+                loops.push_back(loop);
+            }
+        }
+        return loops;
+    }
+
+    //maximal invariant expressions of loop, in order
+    static vector<Hoist> invariants(const pmr::vector<Instruction>& code, const Control_Flow_Graph& cfg, const Loop& loop) {
+        size_t first = cfg[loop.header].begin;
+        size_t end = cfg[loop.last].end;
+        unordered_set<int> memory;
+        unordered_set<int> slots;
+        for (size_t i = first; i < end; i++) {
+            if (code[i].Operator == Opcode::POPM) {
+                memory.insert(code[i].Operand);
+            }
+            else if (code[i].Operator == Opcode::POPL) {
+                slots.insert(code[i].Operand);
+            }
+        }
+
+        vector<Hoist> hoists;
+        vector<Value> stack;
+        for (int b = loop.header; b <= loop.last; b++) {
+            bool header = b == loop.header;
+            //a value pushed before the block is not invariant
+            auto pop = [&]() {
+                Value value = {-1, 0, false, false, false};
+                if (!stack.empty()) {
+                    value = stack.back();
+                    stack.pop_back();
+                }
+                return value;
+            };
+            //the value is used as it is, so it is moved when it can be
+            auto use = [&](const Value& value) {
+                if (value.invariant && value.computed && (header || !value.divides)) {
+                    hoists.push_back({size_t(value.begin), value.end, 0});
+                }
+            };
+
+            for (size_t i = cfg[b].begin; i < cfg[b].end; i++) {
+                const Instruction& instr = code[i];
+                const Opcode_Info& info = instr.info();
+                if (!is_pure(code, i) || instr.Operator == Opcode::DUP) {
+                    //what is below stays on the stack across the instruction,
+                    //later code using it would not be contiguous with it
+                    while (!stack.empty()) {
+                        use(pop());
+                    }
+                    for (int k = 0; k < info.pushes; k++) {
+                        stack.push_back({long(i), i, false, false, false});
+                    }
+                    continue;
+                }
+
+                vector<Value> operands;
+                for (int k = 0; k < info.pops; k++) {
+                    operands.push_back(pop());
+                }
+                Value result = {long(i), i, leaf_invariant(instr, memory, slots), info.rule != Type_Rule::NONE,
+                                instr.Operator == Opcode::D};
+                for (const Value& operand : operands) {
+                    result.begin = min(result.begin, operand.begin < 0 ? long(i) : operand.begin);
+                    result.invariant = result.invariant && operand.begin >= 0 && operand.invariant;
+                    result.computed = result.computed || operand.computed;
+                    result.divides = result.divides || operand.divides;
+                }
+                if (!result.invariant) {
+                    for (const Value& operand : operands) {
+                        use(operand);
+                    }
+                    result.begin = i;
+                }
+                stack.push_back(result);
+            }
+            while (!stack.empty()) {
+                use(pop());
+            }
+        }
+        return hoists;
+    }
+
+    static bool leaf_invariant(const Instruction& instr, const unordered_set<int>& memory, const unordered_set<int>& slots) {
+        switch (instr.Operator) {
+            case Opcode::PUSHI:
+            case Opcode::PUSHB:
+            case Opcode::PUSHK:
+            case Opcode::PUSHF:
+            case Opcode::ITOF:
+                return true;
+            case Opcode::PUSHM:
+                return !memory.count(instr.Operand);
+            case Opcode::PUSHL:
+                return !slots.count(instr.Operand);
+            default:
+                return instr.info().rule != Type_Rule::NONE;
+        }
+    }
+};
+
+#endif
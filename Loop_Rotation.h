@@ -0,0 +1,72 @@
+#ifndef LOOP_ROTATION_H
+#define LOOP_ROTATION_H
+
+#include <cstddef>
+#include <vector>
+#include "Instruction.h"
+#include "Code_Rewriter.h"
+#include "CFG.h"
+using namespace std;
+
+//-O1: turns a while loop into a guarded do-while, so an iteration runs one
+//conditional jump instead of a JMP back to the test and the test's JMP0
+//    LABEL cond JMP0 exit body JMP top      (top: the LABEL)
+//becomes
+//    LABEL cond JMP0 exit LABEL body cond JMP1 (the second LABEL)
+//the test at the top now only guards the first iteration, the copy at the
+//bottom decides the others (a JMP1 test at the top gets a JMP0 copy)
+//a loop is rotated when it is one of Control_Flow_Graph::loops() whose first
+//block is the test, jumping to right after the loop, and whose only back edge
+//is the JMP ending its last block
+class Loop_Rotation {
+public:
+    size_t loops = 0;        //loops rotated
+    size_t instructions = 0; //test instructions copied
+
+    //entries are the addresses control starts from (see Control_Flow_Graph)
+    //returns the number of loops rotated
+    size_t run(Code_Rewriter& rewriter, const vector<int>& entries) {
+        const auto& code = rewriter.code();
+        Control_Flow_Graph cfg(code, entries);
+        vector<long> testOf(code.size(), -1); //back edge JMP -> first index of the test it replaces
+        vector<char> bodyStart(code.size(), 0); //gets a LABEL, passes expect one at every jump target
+        size_t before = loops;
+        for (const auto& loop : cfg.loops(code)) {
+            const auto& header = cfg[loop.header];
+            const auto& last = cfg[loop.last];
+            const Instruction& test = code[header.end - 1];
+            const Instruction& back = code[last.end - 1];
+            if (loop.header == loop.last || header.predecessors.size() != 2 || !is_branch(test.Operator) ||
+                !test.hasOperand || size_t(test.Operand) != last.end + 1 ||
+                back.Operator != Opcode::JMP || size_t(back.Operand) != header.begin + 1) {
+                continue;
+            }
+            testOf[last.end - 1] = header.begin;
+            bodyStart[header.end] = 1;
+            loops++;
+        }
+
+        for (size_t i = 0; i < code.size(); i++) {
+            rewriter.begin(i);
+            if (bodyStart[i]) {
+                rewriter.emit(Instruction(Opcode::LABEL));
+            }
+            if (testOf[i] < 0) {
+                rewriter.emit(code[i]);
+                continue;
+            }
+            size_t end = cfg[cfg.block_of(testOf[i])].end - 1; //the JMP0 or JMP1
+            for (size_t k = testOf[i]; k < end; k++) {
+                if (code[k].Operator != Opcode::LABEL) {
+                    rewriter.emit(code[k]);
+                    instructions++;
+                }
+            }
+            Opcode inverse = code[end].Operator == Opcode::JMP0 ? Opcode::JMP1 : Opcode::JMP0;
+            rewriter.emit(Instruction(inverse, int(end) + 2));
+        }
+        return loops - before;
+    }
+};
+
+#endif
@@ -0,0 +1,344 @@
+#ifndef LOOP_UNROLLING_H
+#define LOOP_UNROLLING_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "Instruction.h"
+#include "Code_Rewriter.h"
+#include "CFG.h"
+using namespace std;
+
+//-O2: unrolls counted while loops, before Loop_Rotation sees them
+//a counted loop is one of Control_Flow_Graph::loops() shaped
+//    LABEL i N cmp JMP0 exit body i c A i JMP top      (top: the LABEL)
+//with cmp one of LES, LEQ, GRT, GEQ, N a literal, c a literal stepping i
+//toward N (i c S i too), no other store to i, no CALL or RET in the body and
+//no jump into the loop or out of the body
+//when a literal is stored to i right before the loop and the trip count T is
+//small, the loop becomes T copies of body + increment, with no test or jump
+//otherwise it is unrolled by factor with a remainder loop:
+//    top: LABEL i N' cmp JMP0 rest (body i c A i) * factor JMP top
+//    rest: LABEL i N cmp JMP0 exit body i c A i JMP rest
+//where N' = N - (factor - 1) * c, so the first loop only runs while factor
+//iterations are left (i + (factor - 1) * c cmp N without overflowing), the
+//factor is lowered until N' does not overflow either
+//cost model: a loop may grow the code by UNROLL_BUDGET instructions, and all
+//loops together by at most the size of the code
+class Loop_Unrolling {
+public:
+    static constexpr int UNROLL_FACTOR = 4;
+    static constexpr int UNROLL_BUDGET = 64;
+    //iterations counted at most to report the jumps saved
+    static constexpr int64_t UNROLL_COUNT_LIMIT = 1 << 20;
+
+private:
+    Constant_Pool& pool;
+    int factor;
+
+    using Loop = Control_Flow_Graph::Loop;
+
+    //a loop match() accepts
+    struct Counted {
+        size_t top;       //index of its LABEL
+        size_t body;      //first index after the JMP0
+        size_t back;      //index of the JMP back to top
+        Opcode compare;
+        int64_t bound;    //N
+        int64_t step;     //c, what the increment adds
+        bool known = false; //a literal is stored to i right before the loop
+        int64_t initial = 0;
+    };
+
+    //how a loop is rewritten, trips 0 with unroll 0 removes it
+    struct Plan {
+        Counted loop;
+        int unroll = 0;   //copies in the first loop, 0 when fully unrolled
+        int64_t trips = 0; //copies when fully unrolled
+        int64_t limit = 0; //N' when unrolled
+        size_t saved = 0;  //jumps no longer executed, 0 when the trip count is not known
+    };
+
+public:
+    size_t loops = 0;        //loops unrolled
+    size_t full = 0;         //of those, fully unrolled
+    size_t instructions = 0; //the code grew by
+    size_t jumps = 0;        //jumps no longer executed, in the loops whose trip count is known
+
+    //factor below 2 leaves the loops whose trip count is not small as they are
+    explicit Loop_Unrolling(Constant_Pool& pool, int factor = UNROLL_FACTOR) : pool(pool), factor(factor) {}
+
+    //entries are the addresses control starts from (see Control_Flow_Graph)
+    //returns the number of loops unrolled
+    size_t run(Code_Rewriter& rewriter, const vector<int>& entries) {
+        const auto& code = rewriter.code();
+        Control_Flow_Graph cfg(code, entries);
+        vector<Loop> loops = cfg.loops(code);
+        //inner loops first, an outer loop around one already unrolled is left
+        sort(loops.begin(), loops.end(), [](const Loop& a, const Loop& b) {
+            return a.last - a.header < b.last - b.header;
+        });
+
+        //every jump, to see that none enters a loop from outside
+        vector<pair<size_t, size_t>> jumpList; //{index, target index}
+        for (size_t i = 0; i < code.size(); i++) {
+            if ((code[i].Operator == Opcode::JMP || is_branch(code[i].Operator)) && code[i].hasOperand) {
+                jumpList.push_back({i, size_t(code[i].Operand - 1)});
+            }
+        }
+
+        vector<char> changed(cfg.size(), 0);
+        vector<Plan> plans;
+        long room = long(code.size());
+        size_t before = this->loops;
+        for (const Loop& loop : loops) {
+            if (any_of(changed.begin() + loop.header, changed.begin() + loop.last + 1, [](char c) { return c; })) {
+                continue;
+            }
+            Counted counted;
+            if (!match(code, cfg, loop, jumpList, counted)) {
+                continue;
+            }
+            Plan plan;
+            plan.loop = counted;
+            long growth = 0;
+            if (!choose(counted, plan, growth) || growth > room) {
+                continue;
+            }
+            room -= max(growth, 0L);
+            instructions += max(growth, 0L);
+            jumps += plan.saved;
+            fill(changed.begin() + loop.header, changed.begin() + loop.last + 1, 1);
+            plans.push_back(plan);
+            this->loops++;
+            full += plan.unroll == 0;
+        }
+        sort(plans.begin(), plans.end(), [](const Plan& a, const Plan& b) {
+            return a.loop.top < b.loop.top;
+        });
+
+        size_t next = 0;
+        for (size_t i = 0; i < code.size(); i++) {
+            rewriter.begin(i);
+            if (next == plans.size() || plans[next].loop.top != i) {
+                rewriter.emit(code[i]);
+                continue;
+            }
+            const Plan& plan = plans[next++];
+            emit(rewriter, code, plan);
+            while (i < plan.loop.back) {
+                rewriter.begin(++i);
+            }
+        }
+        return this->loops - before;
+    }
+
+private:
+    //literal value of a PUSHI or PUSHK
+    bool literal(const Instruction& instr, int64_t& value) const {
+        if (instr.Operator == Opcode::PUSHI) {
+            value = instr.Operand;
+            return true;
+        }
+        if (instr.Operator == Opcode::PUSHK) {
+            value = pool[instr.Operand];
+            return true;
+        }
+        return false;
+    }
+
+    Instruction integer(int64_t value) {
+        return fits_operand(value) ? Instruction(Opcode::PUSHI, int(value))
+                                   : Instruction(Opcode::PUSHK, pool.index(value));
+    }
+
+    static bool is_load(const Instruction& instr) {
+        return instr.Operator == Opcode::PUSHM || instr.Operator == Opcode::PUSHL;
+    }
+
+    static bool is_store(const Instruction& instr) {
+        return instr.Operator == Opcode::POPM || instr.Operator == Opcode::POPL;
+    }
+
+    //memory addresses as they are, slot n as -(n + 1)
+    static int key(const Instruction& instr) {
+        return instr.info().operand == Operand_Kind::SLOT ? -(instr.Operand + 1) : instr.Operand;
+    }
+
+    //value cmp bound
+    static bool holds(Opcode compare, int64_t value, int64_t bound) {
+        switch (compare) {
+            case Opcode::LES: return value < bound;
+            case Opcode::LEQ: return value <= bound;
+            case Opcode::GRT: return value > bound;
+            default:          return value >= bound;
+        }
+    }
+
+    //fills counted when loop is a counted loop (see the class comment)
+    bool match(const pmr::vector<Instruction>& code, const Control_Flow_Graph& cfg, const Loop& loop,
+               const vector<pair<size_t, size_t>>& jumpList, Counted& counted) const {
+        const auto& header = cfg[loop.header];
+        const auto& last = cfg[loop.last];
+        size_t top = header.begin;
+        size_t back = last.end - 1;
+        if (loop.header == loop.last || header.predecessors.size() != 2 || header.end - top != 5 ||
+            code[top].Operator != Opcode::LABEL || back < top + 9) {
+            return false;
+        }
+        const Instruction& load = code[top + 1];
+        const Instruction& test = code[top + 4];
+        Opcode compare = code[top + 3].Operator;
+        if (!is_load(load) || !literal(code[top + 2], counted.bound) ||
+            (compare != Opcode::LES && compare != Opcode::LEQ && compare != Opcode::GRT && compare != Opcode::GEQ) ||
+            test.Operator != Opcode::JMP0 || !test.hasOperand || size_t(test.Operand) != back + 2 ||
+            code[back].Operator != Opcode::JMP || size_t(code[back].Operand) != top + 1) {
+            return false;
+        }
+
+        //i c A i, c i A i or i c S i right before the JMP
+        int variable = key(load);
+        Opcode store = load.Operator == Opcode::PUSHM ? Opcode::POPM : Opcode::POPL;
+        const Instruction& a = code[back - 4];
+        const Instruction& b = code[back - 3];
+        const Instruction& op = code[back - 2];
+        const Instruction& to = code[back - 1];
+        int64_t value = 0;
+        if (to.Operator != store || key(to) != variable) {
+            return false;
+        }
+        if (a.Operator == load.Operator && key(a) == variable && literal(b, value) &&
+            (op.Operator == Opcode::A || op.Operator == Opcode::S)) {
+            counted.step = op.Operator == Opcode::A ? value : int64_t(0 - uint64_t(value));
+        }
+        else if (op.Operator == Opcode::A && b.Operator == load.Operator && key(b) == variable && literal(a, value)) {
+            counted.step = value;
+        }
+        else {
+            return false;
+        }
+        bool up = compare == Opcode::LES || compare == Opcode::LEQ;
+        if (counted.step == 0 || (counted.step > 0) != up) {
+            return false;
+        }
+
+        //the body only jumps inside itself and nothing else jumps into the loop
+        size_t body = top + 5;
+        size_t increment = back - 4;
+        for (size_t i = body; i < increment; i++) {
+            Opcode op = code[i].Operator;
+            if (op == Opcode::CALL || op == Opcode::RET || (is_store(code[i]) && key(code[i]) == variable)) {
+                return false;
+            }
+        }
+        for (auto [from, to] : jumpList) {
+            bool inside = from >= body && from < increment;
+            if (inside ? to < body || to >= increment : from != back && to > top && to <= back) {
+                return false;
+            }
+        }
+
+        counted.top = top;
+        counted.body = body;
+        counted.back = back;
+        counted.compare = compare;
+        if (top >= 2 && code[top - 1].Operator == store && key(code[top - 1]) == variable &&
+            literal(code[top - 2], counted.initial)) {
+            counted.known = true;
+        }
+        return true;
+    }
+
+    //iterations from initial, -1 when more than most
+    static int64_t trip_count(const Counted& loop, int64_t most) {
+        int64_t trips = 0;
+        for (int64_t i = loop.initial; holds(loop.compare, i, loop.bound);
+             i = int64_t(uint64_t(i) + uint64_t(loop.step))) {
+            if (++trips > most) {
+                return -1;
+            }
+        }
+        return trips;
+    }
+
+    //picks full unrolling or the largest factor within the budget, growth is
+    //what the code grows by
+    bool choose(const Counted& loop, Plan& plan, long& growth) {
+        long copy = long(loop.back - loop.body); //body and increment
+        long size = copy + 6;                    //the loop as it is
+        if (loop.known) {
+            int64_t trips = trip_count(loop, (UNROLL_BUDGET + size) / copy);
+            if (trips >= 0) {
+                plan.trips = trips;
+                growth = long(trips) * copy - size;
+                //2 jumps an iteration and the JMP0 that leaves
+                plan.saved = 2 * size_t(trips) + 1;
+                return true;
+            }
+        }
+        for (int k = factor; k >= 2; k--) {
+            int64_t scaled = 0;
+            if (__builtin_mul_overflow(int64_t(k - 1), loop.step, &scaled) ||
+                __builtin_sub_overflow(loop.bound, scaled, &plan.limit)) {
+                continue;
+            }
+            //the first loop with k copies, then the remainder loop
+            growth = (6 + k * copy) + (6 + copy) - size;
+            if (growth > UNROLL_BUDGET) {
+                continue;
+            }
+            plan.unroll = k;
+            int64_t trips = loop.known ? trip_count(loop, UNROLL_COUNT_LIMIT) : -1;
+            if (trips >= 0) {
+                int64_t rounds = trips / k, rest = trips % k;
+                plan.saved = size_t((2 * trips + 1) - (2 * rounds + 1) - (2 * rest + 1));
+            }
+            return true;
+        }
+        return false;
+    }
+
+    //a copy of code[begin..end - 1], its jumps to code in the copy go to the copy
+    static void copy(Code_Rewriter& rewriter, const pmr::vector<Instruction>& code, size_t begin, size_t end) {
+        size_t base = rewriter.emitted().size();
+        for (size_t i = begin; i < end; i++) {
+            const Instruction& instr = code[i];
+            if ((instr.Operator == Opcode::JMP || is_branch(instr.Operator)) && instr.hasOperand) {
+                rewriter.emit_placed(Instruction(instr.Operator, int(base + (instr.Operand - 1 - begin)) + 1));
+            }
+            else {
+                rewriter.emit(instr);
+            }
+        }
+    }
+
+    void emit(Code_Rewriter& rewriter, const pmr::vector<Instruction>& code, const Plan& plan) {
+        const Counted& loop = plan.loop;
+        if (plan.unroll == 0) {
+            for (int64_t t = 0; t < plan.trips; t++) {
+                copy(rewriter, code, loop.body, loop.back);
+            }
+            return;
+        }
+        size_t copySize = loop.back - loop.body;
+        size_t rest = rewriter.emitted().size() + 6 + plan.unroll * copySize; //index of the remainder's LABEL
+        rewriter.emit(code[loop.top]);
+        rewriter.emit(code[loop.top + 1]);
+        rewriter.emit(integer(plan.limit));
+        rewriter.emit(code[loop.top + 3]);
+        rewriter.emit_placed(Instruction(Opcode::JMP0, int(rest) + 1));
+        for (int k = 0; k < plan.unroll; k++) {
+            copy(rewriter, code, loop.body, loop.back);
+        }
+        rewriter.emit(code[loop.back]);
+        for (size_t i = loop.top; i < loop.body; i++) {
+            rewriter.emit(code[i]);
+        }
+        copy(rewriter, code, loop.body, loop.back);
+        rewriter.emit_placed(Instruction(Opcode::JMP, int(rest) + 1));
+    }
+};
+
+#endif
@@ -0,0 +1,260 @@
+#ifndef MEMORY_COLORING_H
+#define MEMORY_COLORING_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "Instruction.h"
+#include "CFG.h"
+#include "Liveness.h"
+using namespace std;
+
+//-O1: gives the memory addresses new, dense slots from the start of the data
+//segment, the most used first so the hot variables sit next to each other
+//a use counts 8 times more for each loop around it (see
+//Control_Flow_Graph::loops())
+//scratch addresses (see Liveness) share a slot when they interfere nowhere:
+//one is never stored while the other is live, and neither is stored by a
+//function while the other is live across a CALL (the callee's code has its
+//own liveness, which does not see the caller's scratch)
+//the declared globals of a whole program are colored the same way: the
+//functions come before the declarations, so only the main code reads them,
+//and nothing after it does; those of an object file (-c) keep a slot of
+//their own, linked files find them by name
+class Memory_Coloring {
+    const pmr::vector<int>& scratch;
+    bool linked; //the code is an object file, its globals are exported
+
+    //addresses sharing one slot
+    struct Slot {
+        vector<int> addresses;
+        uint64_t weight = 0;
+        int first;           //lowest old address, orders slots of equal weight
+    };
+
+public:
+    size_t before = 0; //data segment cells
+    size_t after = 0;
+    size_t shared = 0; //addresses put in the slot of another address
+
+    Memory_Coloring(const pmr::vector<int>& scratch, bool linked) : scratch(scratch), linked(linked) {}
+
+    //addresses are the declared globals (some may not be used), base the
+    //first address of the data segment
+    //rewrites the memory operands of code and returns every address's new one
+    unordered_map<int, int> run(pmr::vector<Instruction>& code, const vector<int>& entries,
+                                const vector<int>& addresses, int base) {
+        unordered_set<int> all(addresses.begin(), addresses.end());
+        for (const Instruction& instr : code) {
+            if (instr.info().operand == Operand_Kind::MEMORY) {
+                all.insert(instr.Operand);
+            }
+        }
+        before = 0;
+        for (int address : all) {
+            before = max(before, size_t(address - base + 1));
+        }
+
+        pmr::vector<int> colorable(scratch.begin(), scratch.end());
+        if (!linked) {
+            colorable.insert(colorable.end(), addresses.begin(), addresses.end());
+        }
+        Control_Flow_Graph cfg(code, entries);
+        Liveness liveness(code, cfg, colorable);
+        unordered_map<int, uint64_t> weights = use_weights(code, cfg);
+        unordered_set<int> colored(colorable.begin(), colorable.end());
+
+        //colored addresses the code uses, as Liveness variables
+        vector<int> temporaries;
+        unordered_map<int, int> addressOf; //variable -> address
+        for (const Instruction& instr : code) {
+            if (instr.info().operand == Operand_Kind::MEMORY && colored.count(instr.Operand)) {
+                int v = liveness.variable(instr);
+                if (addressOf.emplace(v, instr.Operand).second) {
+                    temporaries.push_back(v);
+                }
+            }
+        }
+        vector<Variable_Set> interferes = interference(code, cfg, liveness, temporaries, entries);
+
+        //temporaries, the most used first, take the first slot they fit
+        sort(temporaries.begin(), temporaries.end(), [&](int a, int b) {
+            uint64_t wa = weights[addressOf[a]], wb = weights[addressOf[b]];
+            return wa != wb ? wa > wb : addressOf[a] < addressOf[b];
+        });
+        vector<Slot> slots;
+        vector<vector<int>> members; //variables of each shared slot
+        for (int v : temporaries) {
+            size_t s = 0;
+            while (s < members.size() &&
+                   any_of(members[s].begin(), members[s].end(), [&](int u) { return interferes[v].test(u); })) {
+                s++;
+            }
+            if (s == members.size()) {
+                members.emplace_back();
+                slots.push_back({{}, 0, addressOf[v]});
+            }
+            else {
+                shared++;
+            }
+            members[s].push_back(v);
+            slots[s].addresses.push_back(addressOf[v]);
+            slots[s].weight += weights[addressOf[v]];
+            slots[s].first = min(slots[s].first, addressOf[v]);
+            all.erase(addressOf[v]);
+        }
+        //colored addresses the code no longer uses (e.g. all its stores were
+        //dead) need no cell, they go in the first slot
+        vector<int> unused;
+        for (int address : all) {
+            if (colored.count(address)) {
+                unused.push_back(address);
+            }
+            else {
+                slots.push_back({{address}, weights[address], address});
+            }
+        }
+        sort(slots.begin(), slots.end(), [](const Slot& a, const Slot& b) {
+            return a.weight != b.weight ? a.weight > b.weight : a.first < b.first;
+        });
+        if (!unused.empty()) {
+            if (slots.empty()) {
+                slots.push_back({{}, 0, unused[0]});
+            }
+            else {
+                shared += unused.size();
+            }
+            slots[0].addresses.insert(slots[0].addresses.end(), unused.begin(), unused.end());
+        }
+
+        unordered_map<int, int> moved;
+        for (size_t s = 0; s < slots.size(); s++) {
+            for (int address : slots[s].addresses) {
+                moved[address] = base + s;
+            }
+        }
+        for (Instruction& instr : code) {
+            if (instr.info().operand == Operand_Kind::MEMORY) {
+                instr.Operand = moved.at(instr.Operand);
+            }
+        }
+        after = slots.size();
+        return moved;
+    }
+
+private:
+    //static uses of each address, weighted by loop nesting
+    static unordered_map<int, uint64_t> use_weights(const pmr::vector<Instruction>& code, const Control_Flow_Graph& cfg) {
+        vector<int> depth(cfg.size(), 0);
+        for (const auto& loop : cfg.loops(code)) {
+            for (int b = loop.header; b <= loop.last; b++) {
+                depth[b]++;
+            }
+        }
+        unordered_map<int, uint64_t> weights;
+        for (size_t i = 0; i < code.size(); i++) {
+            if (code[i].info().operand == Operand_Kind::MEMORY) {
+                weights[code[i].Operand] += uint64_t(1) << (3 * min(depth[cfg.block_of(i)], 20));
+            }
+        }
+        return weights;
+    }
+
+    //per variable, the temporaries it cannot share a slot with (only the rows
+    //of temporaries are filled)
+    static vector<Variable_Set> interference(const pmr::vector<Instruction>& code, const Control_Flow_Graph& cfg,
+                                             const Liveness& liveness, const vector<int>& temporaries,
+                                             const vector<int>& entries) {
+        size_t count = liveness.variables();
+        Variable_Set isTemporary(count);
+        for (int v : temporaries) {
+            isTemporary.set(v);
+        }
+        vector<Variable_Set> interferes(count, Variable_Set(0));
+        for (int v : temporaries) {
+            interferes[v] = Variable_Set(count);
+        }
+        auto conflict = [&](int a, int b) {
+            if (a != b && isTemporary.test(a) && isTemporary.test(b)) {
+                interferes[a].set(b);
+                interferes[b].set(a);
+            }
+        };
+
+        //temporaries stored in the code of functions, which runs during a CALL
+        vector<char> inFunction = function_blocks(cfg, entries);
+        Variable_Set stored(count);
+        for (size_t i = 0; i < code.size(); i++) {
+            int v = liveness.variable(code[i]);
+            if (v >= 0 && inFunction[cfg.block_of(i)] && liveness.is_store(code[i])) {
+                stored.set(v);
+            }
+        }
+        vector<int> calleeStores;
+        for (int v : temporaries) {
+            if (stored.test(v)) {
+                calleeStores.push_back(v);
+            }
+        }
+
+        for (size_t b = 0; b < cfg.size(); b++) {
+            if (!cfg.reachable(b)) {
+                continue;
+            }
+            Variable_Set live = liveness.live_out(b);
+            for (size_t i = cfg[b].end; i-- > cfg[b].begin;) {
+                const Instruction& instr = code[i];
+                int v = liveness.variable(instr);
+                if (v >= 0 && liveness.is_store(instr)) {
+                    for (int u : temporaries) {
+                        if (live.test(u)) {
+                            conflict(v, u);
+                        }
+                    }
+                }
+                else if (instr.Operator == Opcode::CALL) {
+                    for (int u : temporaries) {
+                        if (live.test(u)) {
+                            for (int stored : calleeStores) {
+                                conflict(u, stored);
+                            }
+                        }
+                    }
+                }
+                liveness.step(instr, live);
+            }
+        }
+        return interferes;
+    }
+
+    //blocks reached from a function's entry (every entry after the first)
+    static vector<char> function_blocks(const Control_Flow_Graph& cfg, const vector<int>& entries) {
+        vector<char> inFunction(cfg.size(), 0);
+        vector<int> work;
+        size_t end = cfg.size() > 0 ? cfg[cfg.size() - 1].end : 0;
+        for (size_t e = 1; e < entries.size(); e++) {
+            size_t index = entries[e] - 1;
+            if (index < end && !inFunction[cfg.block_of(index)]) {
+                inFunction[cfg.block_of(index)] = 1;
+                work.push_back(cfg.block_of(index));
+            }
+        }
+        while (!work.empty()) {
+            int b = work.back();
+            work.pop_back();
+            for (int successor : cfg[b].successors) {
+                if (!inFunction[successor]) {
+                    inFunction[successor] = 1;
+                    work.push_back(successor);
+                }
+            }
+        }
+        return inFunction;
+    }
+};
+
+#endif
@@ -0,0 +1,176 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include <cstddef>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include "Instruction.h"
+#include "Code_Rewriter.h"
+using namespace std;
+
+//peephole rules, combined as a bit set
+enum Peephole_Rule : unsigned {
+    PEEPHOLE_LABELS = 1, //LABEL LABEL -> LABEL
+    PEEPHOLE_JUMPS = 2,  //a jump to a JMP goes straight to that JMP's target
+    PEEPHOLE_DUP = 4,    //POPM x; PUSHM x -> DUP; POPM x (and the same for POPL/PUSHL)
+    PEEPHOLE_EMPTY = 8,  //a jump to the next instruction is removed, a JMP0 or JMP1 with its condition
+    PEEPHOLE_ALL = 15
+};
+
+inline constexpr const char* PEEPHOLE_RULE_NAMES[] = { "labels", "jumps", "dup", "empty" };
+inline constexpr size_t PEEPHOLE_RULE_COUNT = 4;
+
+//rules named in a comma separated list, "all" for every rule
+inline unsigned peephole_rules(const string& list) {
+    unsigned rules = 0;
+    stringstream names(list);
+    string name;
+    while (getline(names, name, ',')) {
+        if (name == "all") {
+            rules |= PEEPHOLE_ALL;
+            continue;
+        }
+        size_t rule = 0;
+        while (rule < PEEPHOLE_RULE_COUNT && name != PEEPHOLE_RULE_NAMES[rule]) {
+            rule++;
+        }
+        if (rule == PEEPHOLE_RULE_COUNT) {
+            throw runtime_error("Unknown peephole rule " + name);
+        }
+        rules |= 1u << rule;
+    }
+    return rules;
+}
+
+//slides over the table once per run(), looking at the instruction being copied
+//and the output just before it
+//one rule firing can expose another (a removed jump leaves LABEL LABEL), so the
+//caller runs it again while anything fires
+class Peephole {
+    unsigned rules;
+
+public:
+    size_t fired[PEEPHOLE_RULE_COUNT] = {};
+
+    explicit Peephole(unsigned rules) : rules(rules) {}
+
+    //returns the number of rules fired
+    size_t run(Code_Rewriter& rewriter) {
+        const auto& code = rewriter.code();
+        auto& out = rewriter.emitted();
+        size_t count = 0;
+
+        for (size_t i = 0; i < code.size(); i++) {
+            Instruction instr = code[i];
+
+            if ((rules & PEEPHOLE_LABELS) && instr.Operator == Opcode::LABEL &&
+                !out.empty() && out.back().Operator == Opcode::LABEL) {
+                rewriter.merge(i, out.size() - 1);
+                fire(0, count);
+                continue;
+            }
+            rewriter.begin(i);
+
+            bool jump = instr.hasOperand && (instr.Operator == Opcode::JMP || is_branch(instr.Operator));
+            if (jump && (rules & PEEPHOLE_JUMPS)) {
+                int target = thread(code, instr.Operand);
+                if (target != instr.Operand) {
+                    instr.Operand = target;
+                    fire(1, count);
+                }
+            }
+
+            if (jump && (rules & PEEPHOLE_EMPTY) && falls_through(code, i, instr.Operand)) {
+                if (instr.Operator == Opcode::JMP) {
+                    fire(3, count);
+                    continue;
+                }
+                int condition = condition_start(out);
+                if (condition >= 0) {
+                    rewriter.truncate(condition);
+                    fire(3, count);
+                    continue;
+                }
+            }
+
+            bool load = instr.Operator == Opcode::PUSHM || instr.Operator == Opcode::PUSHL;
+            Opcode store = instr.Operator == Opcode::PUSHM ? Opcode::POPM : Opcode::POPL;
+            if ((rules & PEEPHOLE_DUP) && load && i > 0 &&
+                code[i - 1] == Instruction(store, instr.Operand) &&
+                !out.empty() && out.back() == code[i - 1]) {
+                out.back() = Instruction(Opcode::DUP);
+                rewriter.emit(code[i - 1]);
+                fire(2, count);
+                continue;
+            }
+
+            rewriter.emit(instr);
+        }
+        return count;
+    }
+
+    void write_stats(ostream& out) const {
+        out << "peephole:";
+        for (size_t rule = 0; rule < PEEPHOLE_RULE_COUNT; rule++) {
+            out << "\t" << PEEPHOLE_RULE_NAMES[rule] << ": " << fired[rule];
+        }
+        out << "\n";
+    }
+
+private:
+    void fire(size_t rule, size_t& count) {
+        fired[rule]++;
+        count++;
+    }
+
+    //final target of a jump to address, following LABELs and JMPs
+    //a cycle of jumps stops after code.size() steps
+    static int thread(const pmr::vector<Instruction>& code, int address) {
+        for (size_t hops = 0; hops < code.size(); hops++) {
+            size_t k = address - 1;
+            while (k < code.size() && code[k].Operator == Opcode::LABEL) {
+                k++;
+            }
+            if (k == code.size() || code[k].Operator != Opcode::JMP || !code[k].hasOperand ||
+                code[k].Operand == address) {
+                break;
+            }
+            address = code[k].Operand;
+        }
+        return address;
+    }
+
+    //only LABELs between the jump at index and its target
+    static bool falls_through(const pmr::vector<Instruction>& code, size_t index, int target) {
+        if (size_t(target) <= index + 1) {
+            return false;
+        }
+        for (size_t k = index + 1; k + 1 < size_t(target); k++) {
+            if (code[k].Operator != Opcode::LABEL) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //emitted index where the value on top of the stack starts being computed,
+    //-1 when that is not straight-line code without side effects
+    static int condition_start(const vector<Instruction>& out) {
+        int needed = 1;
+        for (size_t k = out.size(); k-- > 0;) {
+            const Opcode_Info& info = out[k].info();
+            if (!is_pure(out, k) || info.pushes > needed) {
+                return -1;
+            }
+            needed += info.pops - info.pushes;
+            if (needed == 0) {
+                return k;
+            }
+        }
+        return -1;
+    }
+};
+
+#endif
@@ -4,47 +4,121 @@
 #include <string>
 #include <vector>
 #include <fstream>
-#include <sstream>
 #include <iostream>
 #include <stack>
+#include <deque>
 #include <unordered_map>
 #include <optional>
+#include <memory_resource>
+#include <algorithm>
+#include <charconv>
 #include "TokenType.h"
+#include "Type.h"
+#include "Instruction.h"
+#include "Symbol_Table.h"
+#include "Linker.h"
+#include "Listing.h"
+#include "Instruction_Sink.h"
+#include "Bytecode.h"
+#include "Code_Rewriter.h"
+#include "Constant_Folder.h"
+#include "Peephole.h"
+#include "Inliner.h"
+#include "CFG.h"
+#include "Unreachable_Code.h"
+#include "Dead_Stores.h"
+#include "Loop_Unrolling.h"
+#include "Loop_Rotation.h"
+#include "Loop_Invariants.h"
+#include "Strength_Reduction.h"
+#include "Value_Numbering.h"
+#include "Memory_Coloring.h"
+#include "Return_Types.h"
+#include "Stack_Verifier.h"
+#include "Interpreter.h"
+#include "Token_Pipeline.h"
+#include "Syntax_Trace.h"
+#include "Grammar.h"
+#include "Condition_Lists.h"
 using namespace std;
 
-enum Type { INTEGER, BOOLEAN, UNDEFINED };
-
-
 class Symbol_and_Assembly{
 private:
     int memoryAddr = 10000;
     int instructionAddr= 1;
     ostream& symbol_assembly_file;
 
-
-    struct Instruction {
-        int ADDR;
-        string Operator;
-        optional<int> Operand;
-        Instruction(int a, const string& op, optional<int> o) : 
-        ADDR(a), Operator(op), Operand(o) {}
+    //when streaming, InstructTable only holds the instructions from index flushed on
+    pmr::vector<Instruction> InstructTable;
+    pmr::vector<uint32_t> DebugTable; //token each instruction was generated from, empty for linked programs
+    Instruction_Sink* sink = nullptr;
+    size_t flushed = 0;
+    size_t flushAt = STREAM_BLOCK; //table size at which the next flush is tried
+    uint32_t currentToken = 0;
+
+    Constant_Pool ConstantPool;
+
+    Symbol_Table SymbolTable;
+
+    //a function's scope in SymbolTable is its index here + 1
+    struct FunctionInfo {
+        int name; //id in SymbolTable.names()
+        int entryADDR;
+        int endADDR = 0;   //address after its last instruction, 0 when not known (linked programs)
+        int params = 0;
+        int frameSize = 0; //parameter and local slots
+        Type returnType = Type::UNDEFINED;
     };
 
-    vector<Instruction> InstructTable;
-
-    struct SymbolInfo {
-        int memoryADDR;
-        Type type;
+    //CALL whose operand is filled in by resolve_calls() once every function is known
+    struct PendingCall {
+        int index;
+        int name;
+        int arguments;
     };
 
+    //a function another object file defines (see Object_File::External)
+    struct ExternalInfo {
+        int name;
+        int arguments;
+    };
 
-    unordered_map<string, SymbolInfo> SymbolTable;
+    pmr::vector<FunctionInfo> FunctionTable;
+    pmr::vector<PendingCall> PendingCalls;
+    pmr::vector<ExternalInfo> Externals;
+    bool objectCode = false; //-c: calls to undefined functions are left to the linker
+    pmr::vector<Return_Type> ReturnTypes; //of every function, known before their code (see Return_Types)
+    pmr::vector<int> ScratchMemory; //addresses of inlined frames, loop and value temporaries, only read by the code that wrote them
+    int loopTemporaries = 0;
+    int valueTemporaries = 0;
+    long stackDepth = STACK_NOT_VERIFIED; //set by verify()
+    optional<Stream_Stack_Verifier> streamVerifier; //checks the blocks handed to sink
+    int currentFunction = -1; //FunctionTable index while compiling a function body
+    int skipFunctions = -1;   //index of the JMP from the start over the function bodies
     
-    stack<Type> Stack;
-    stack<int> JumpStack;
+    stack<Type, pmr::deque<Type>> Stack;
+    //lists of JMP0 and JMP1 indices waiting for back_patch, innermost at the back
+    //a condition being generated keeps two lists on top: the branches taken
+    //when it is false, and above them those taken when it is true
+    pmr::deque<pmr::vector<int>> JumpStack;
     
 public:
-    Symbol_and_Assembly(ostream& out) : symbol_assembly_file(out) {
+    static constexpr size_t STREAM_BLOCK = 4096;
+
+    //every table and stack draws from memory (see Compilation_Arena)
+    Symbol_and_Assembly(ostream& out, pmr::memory_resource* memory = pmr::get_default_resource())
+    : symbol_assembly_file(out),
+    InstructTable(memory),
+    DebugTable(memory),
+    ConstantPool(memory),
+    SymbolTable(memory),
+    FunctionTable(memory),
+    PendingCalls(memory),
+    Externals(memory),
+    ReturnTypes(memory),
+    ScratchMemory(memory),
+    Stack(pmr::deque<Type>(memory)),
+    JumpStack(memory) {
         //reserve 1000 spaces in vector for Instruction table
         InstructTable.reserve(1000);
         if (!out.good()) {
@@ -53,375 +127,984 @@ public:
     }
 
      void display_instructions() {
-        symbol_assembly_file << "\n=== INSTRUCTION TABLE ===\n";
-        symbol_assembly_file << "ADDR\tOPERATOR\tOPERAND\n";
-        symbol_assembly_file << "------------------------\n";
-        for (const auto& instr : InstructTable) {
-            symbol_assembly_file << instr.ADDR << "\t" << instr.Operator << "\t\t";
-            if (instr.Operand.has_value()) {
-                symbol_assembly_file << instr.Operand.value();
-            } else {
-                symbol_assembly_file << "-";
-            }
-            symbol_assembly_file << "\n";
+        if (sink) {
+            flush(flushed + InstructTable.size());
+        }
+        else {
+            write_instruction_listing(symbol_assembly_file, InstructTable);
         }
+        write_stack_listing(symbol_assembly_file, stackDepth);
+    }
+
+    void display_constant_pool() {
+        write_constant_listing(symbol_assembly_file, span<const int64_t>(ConstantPool.begin(), ConstantPool.end()),
+                               ConstantPool.reals());
     }
 
     void display_symbol_table() {
-        symbol_assembly_file << "\n=== SYMBOL TABLE ===\n";
-        symbol_assembly_file << "NAME\t\tADDRESS\t\tType\n";
-        symbol_assembly_file << "--------------------------------\n";
-        for (const auto& entry : SymbolTable) {
-            symbol_assembly_file << entry.first << "\t\t" << entry.second.memoryADDR;
-    
-            switch (entry.second.type) {
-                case Type::INTEGER:
-                    symbol_assembly_file << "\t\t" << "Integer" << endl;
-                    break;
-    
-                case Type::BOOLEAN:
-                    symbol_assembly_file << "\t\t" << "Boolean" << endl;
-                    break;
-    
-                default:
-                    symbol_assembly_file << "\t\t" << "Undefined" << endl;
-                    break;
-            }
+        write_symbol_listing_header(symbol_assembly_file);
+        for (size_t i = 0; i < SymbolTable.size(); i++) {
+            const Symbol_Table::Symbol& entry = SymbolTable[i];
+            write_symbol_row(symbol_assembly_file, listed_name(i), SymbolTable.is_local(i), entry.memoryADDR, entry.type);
+        }
+    }
+
+    //locals are listed as function.name
+    string listed_name(int symbol) const {
+        const Symbol_Table::Symbol& entry = SymbolTable[symbol];
+        if (!SymbolTable.is_local(symbol)) {
+            return string(SymbolTable.name(symbol));
+        }
+        return string(SymbolTable.names()[FunctionTable[entry.scope - 1].name]) + "." + string(SymbolTable.name(symbol));
+    }
+
+    //the tables as a bytecode file (see Bytecode.h), disassembling it gives the listing
+    //when streaming, out is the stream of the Bytecode_Sink that got the code
+    void write_bytecode(ostream& out) {
+        Bytecode_Writer writer;
+        if (!sink) {
+            writer.set_code(InstructTable);
+        }
+        writer.set_constants(span<const int64_t>(ConstantPool.begin(), ConstantPool.end()));
+        writer.set_debug(DebugTable);
+        writer.set_stack_depth(stackDepth);
+        for (size_t i = 0; i < SymbolTable.size(); i++) {
+            const Symbol_Table::Symbol& entry = SymbolTable[i];
+            writer.add_symbol(listed_name(i), entry.memoryADDR, entry.type, SymbolTable.is_local(i));
+        }
+        for (const auto& function : FunctionTable) {
+            writer.add_function(SymbolTable.names()[function.name], function.entryADDR);
+        }
+        if (sink) {
+            flush(flushed + InstructTable.size());
+            writer.finish(out, flushed);
+        }
+        else {
+            writer.write(out);
         }
     }
+
+    //from now on instructions go to sink as soon as no pending patch can reach
+    //them, so only the innermost unfinished statements stay in memory
+    //a streamed program cannot be optimized or written as an object file
+    void stream(Instruction_Sink& target) {
+        sink = &target;
+        streamVerifier.emplace();
+    }
+
+    //instructions generated from now on come from token
+    void at_token(size_t token) {
+        currentToken = token;
+    }
     
     //Add into Instruction Table
-    void generate_instruction(string op, optional<int> oprnd = nullopt){
-        InstructTable.emplace_back(instructionAddr++, op, oprnd);
+    void generate_instruction(Opcode op){
+        generate_instruction(Instruction(op));
     }
 
-    //Add a variable into the Symbol table
-    void generate_symbol(string var, Type type){
-        SymbolTable[var].memoryADDR = memoryAddr;
-        SymbolTable[var].type =  type; 
-        memoryAddr++;
+    void generate_instruction(Opcode op, int oprnd){
+        generate_instruction(Instruction(op, oprnd));
     }
 
-    // Returns Variable Memory
-    int getAddress(string var){
-        return SymbolTable[var].memoryADDR;
+    void generate_instruction(const Instruction& instr){
+        InstructTable.push_back(instr);
+        instructionAddr++;
+        if (!sink) {
+            DebugTable.push_back(currentToken);
+        }
+        else if (InstructTable.size() >= flushAt) {
+            flush(watermark());
+            flushAt = max(STREAM_BLOCK, 2 * InstructTable.size());
+        }
     }
 
-    int getInstructionAddr(){
-        return instructionAddr;
+    //instruction at index, which must not have been streamed yet
+    Instruction& instruction(size_t index){
+        return InstructTable[index - flushed];
     }
 
-    void back_patch(int JMP_address){
-        if(JumpStack.size() >= 1){
-            int addr = JumpStack.top();
-            JumpStack.pop();
-            if(InstructTable[addr].Operator == "JMP0"){
-                InstructTable[addr].Operand = JMP_address;
+    //replaces the instruction at index, streamed or not
+    void patch(size_t index, const Instruction& instr){
+        if (index >= flushed) {
+            instruction(index) = instr;
+        }
+        else {
+            sink->patch(index, instr);
+            streamVerifier->patch(index, instr);
+        }
+    }
+
+    //first index a pending patch can still reach, the last instruction is kept
+    //as well (end_body looks at it)
+    size_t watermark(){
+        size_t mark = flushed + InstructTable.size() - 1;
+        for (const auto& branches : JumpStack) {
+            for (int index : branches) {
+                mark = min(mark, size_t(index));
             }
         }
+        if (!sink->can_patch()) {
+            if (skipFunctions >= 0) {
+                mark = min(mark, size_t(skipFunctions));
+            }
+            if (!PendingCalls.empty()) {
+                mark = min(mark, size_t(PendingCalls.front().index));
+            }
+        }
+        return mark;
     }
 
-    //PUSHI
-    void PUSHI(Type type){
-        //Pushes the {Integer Value} onto the Top of the Stack (TOS)
-        Stack.push(Type(type));
-        generate_instruction("PUSHI");
+    //hands the instructions before index to the sink
+    void flush(size_t index){
+        if (index <= flushed) {
+            return;
+        }
+        size_t count = index - flushed;
+        streamVerifier->write(flushed, span<const Instruction>(InstructTable.data(), count));
+        sink->write(flushed, span<const Instruction>(InstructTable.data(), count));
+        InstructTable.erase(InstructTable.begin(), InstructTable.begin() + count);
+        flushed = index;
     }
 
-    void PUSHB(Type type) {
-        //Push Boolean values onto TOS
-        Stack.push(Type(type));
-        generate_instruction("PUSHB");
+    //Add a variable into the Symbol table, inside a function it is a local in the next frame slot
+    void generate_symbol(const string& var, Type type){
+        if (currentFunction >= 0) {
+            SymbolTable.declare_local(var, FunctionTable[currentFunction].frameSize++, type);
+            return;
+        }
+        SymbolTable.declare(var, memoryAddr, type);
+        memoryAddr++;
+    }
 
+    //global for a pass that needs memory of its own (e.g. an inlined function's locals)
+    int generate_temporary(const string& var, Type type){
+        SymbolTable.declare(var, memoryAddr, type);
+        return memoryAddr++;
     }
 
-    //PUSHM
-    void PUSHM(string var, int memoryLoc){
-        //Pushes the value stored at {ML} onto TOS
-        auto it = SymbolTable.find(var);
-        if (it != SymbolTable.end()) {
-            Stack.push(it->second.type);
-            generate_instruction("PUSHM", memoryLoc);
-        } else {
-            throw runtime_error("Undefined variable: " + var);
+    //FunctionTable index of a function name, -1 if there is none
+    int find_function(int name){
+        for (size_t i = 0; i < FunctionTable.size(); i++) {
+            if (FunctionTable[i].name == name) {
+                return i;
+            }
         }
+        return -1;
     }
 
-    void POPM(int memoryLoc, string var){
-        //Pops the value from the top of the stack and stores it at {ML}
-        if(Stack.empty()){
-            throw runtime_error("Stack underflow");
+    //the types Return_Types found for the functions about to be compiled
+    void return_types(const vector<Return_Type>& types){
+        ReturnTypes.assign(types.begin(), types.end());
+    }
+
+    //the code becomes an object file: a function no definition has is
+    //called in another one, it is taken to return EXTERNAL_TYPE and Linker
+    //checks that it does
+    void object_code(){
+        objectCode = true;
+    }
+
+    static constexpr Type EXTERNAL_TYPE = Type::INTEGER;
+
+    //the return type Return_Types assumes for a name no definition has
+    Type external_type() const {
+        return objectCode ? EXTERNAL_TYPE : Type::UNDEFINED;
+    }
+
+    //UNDEFINED for a function Return_Types could not type, throws for a name
+    //no function definition has unless it is external
+    Type return_type(string_view name){
+        for (const Return_Type& function : ReturnTypes) {
+            if (function.name == name) {
+                return function.type;
+            }
         }
+        if (objectCode) {
+            return EXTERNAL_TYPE;
+        }
+        throw runtime_error("Undefined function: " + string(name));
+    }
 
-        Type stackType = Stack.top();
-        Stack.pop();
+    //the code of the functions comes first, main starts after a JMP over it
+    void begin_functions(){
+        skipFunctions = instructionAddr - 1;
+        generate_instruction(Opcode::JMP);
+    }
 
-        SymbolTable[var].type = stackType;
+    void end_functions(){
+        patch(skipFunctions, Instruction(Opcode::JMP, instructionAddr));
+        skipFunctions = -1;
+        LABEL();
+    }
 
-        generate_instruction("POPM", memoryLoc);
+    //Record a function definition, its parameters and declarations go into a new scope
+    void generate_function(const string& name){
+        int id = SymbolTable.names().intern(name);
+        if (find_function(id) >= 0) {
+            throw runtime_error("Duplicate definition of function " + name);
+        }
+        currentFunction = FunctionTable.size();
+        FunctionTable.push_back({id, instructionAddr});
+        FunctionTable.back().returnType = return_type(name);
+        SymbolTable.begin_scope(currentFunction + 1);
     }
 
-    void SOUT(){
-        // Pops the value from the top of the stack and prints it and adds instruction
+    //parameters take the first frame slots in order
+    void generate_parameter(const string& var, Type type){
+        FunctionInfo& function = FunctionTable[currentFunction];
+        SymbolTable.declare_local(var, function.frameSize++, type);
+        function.params++;
+    }
+
+    //frame layout: slots 0 .. params-1 hold the arguments, the rest the locals,
+    //all of them start at 0
+    //the caller pushes the arguments in order, the prologue pops them into their slots
+    void begin_body(){
+        FunctionInfo& function = FunctionTable[currentFunction];
+        function.entryADDR = instructionAddr;
+        if (sink) {
+            streamVerifier->function(function.entryADDR, function.params);
+        }
+        generate_instruction(Opcode::ENTER, function.frameSize);
+        for (int slot = function.params - 1; slot >= 0; slot--) {
+            generate_instruction(Opcode::POPL, slot);
+        }
+    }
+
+    //falling off the end of a body returns 0
+    void end_body(){
+        if (InstructTable.back().Operator != Opcode::RET) {
+            generate_instruction(Opcode::PUSHI, 0);
+            generate_instruction(Opcode::RET);
+        }
+        FunctionTable[currentFunction].endADDR = instructionAddr;
+        SymbolTable.end_scope();
+        currentFunction = -1;
+    }
+
+    bool in_function(){
+        return currentFunction >= 0;
+    }
+
+    //returns the value on top of the stack, which has the function's type
+    void RET(){
         if (Stack.empty()) {
             throw runtime_error("Stack underflow");
         }
-        // Type type = Stack.top();
+        const FunctionInfo& function = FunctionTable[currentFunction];
+        widen(function.returnType);
+        check_return(function.returnType, Stack.top(), SymbolTable.names()[function.name]);
         Stack.pop();
+        generate_instruction(Opcode::RET);
+    }
+
+    //calls a function with the arguments on top of the stack, leaves its result
+    void CALL(const string& name, int arguments){
+        if (Stack.size() < size_t(arguments)) {
+            throw runtime_error("Stack underflow");
+        }
+        for (int i = 0; i < arguments; i++) {
+            Stack.pop();
+        }
+        int id = SymbolTable.names().intern(name);
+        int function = find_function(id);
+        Stack.push(function >= 0 ? FunctionTable[function].returnType : return_type(name));
+        if (function >= 0) {
+            check_arguments(function, arguments);
+            generate_instruction(Opcode::CALL, FunctionTable[function].entryADDR);
+            return;
+        }
+        //a function defined later
+        PendingCalls.push_back({instructionAddr - 1, id, arguments});
+        if (sink) {
+            streamVerifier->call(instructionAddr - 1, arguments);
+        }
+        generate_instruction(Opcode::CALL);
+    }
+
+    void check_arguments(int function, int arguments){
+        if (FunctionTable[function].params != arguments) {
+            throw runtime_error("Function " + string(SymbolTable.names()[FunctionTable[function].name]) + " expects " +
+                                to_string(FunctionTable[function].params) + " arguments, called with " +
+                                to_string(arguments));
+        }
+    }
+
+    //fills in the entry of every function called before it was defined, a
+    //function of another object file gets an external_call
+    void resolve_calls(){
+        for (const auto& call : PendingCalls) {
+            int function = find_function(call.name);
+            if (function < 0 && objectCode) {
+                patch(call.index, external_call(external(call.name, call.arguments)));
+                continue;
+            }
+            if (function < 0) {
+                throw runtime_error("Undefined function: " + string(SymbolTable.names()[call.name]));
+            }
+            check_arguments(function, call.arguments);
+            patch(call.index, Instruction(Opcode::CALL, FunctionTable[function].entryADDR));
+        }
+        PendingCalls.clear();
+    }
+
+    //Externals index of a function of another object file, every call to it
+    //passes the same number of arguments
+    int external(int name, int arguments){
+        for (size_t i = 0; i < Externals.size(); i++) {
+            if (Externals[i].name != name) {
+                continue;
+            }
+            if (Externals[i].arguments != arguments) {
+                throw runtime_error("Function " + string(SymbolTable.names()[name]) + " called with " +
+                                    to_string(Externals[i].arguments) + " and with " + to_string(arguments) +
+                                    " arguments");
+            }
+            return i;
+        }
+        Externals.push_back({name, arguments});
+        return Externals.size() - 1;
+    }
 
-        generate_instruction("SOUT");
+    //arguments of each function of another object file (see Stack_Verifier)
+    vector<int> external_arguments() const {
+        vector<int> arguments;
+        for (const auto& external : Externals) {
+            arguments.push_back(external.arguments);
+        }
+        return arguments;
     }
 
-    void SIN(string var){
-        auto it = SymbolTable.find(var);
+    //symbol id of a declared variable, Symbol_Table::NONE if there is none
+    int lookup(const string& var){
+        return SymbolTable.find(var);
+    }
 
-        if (it == SymbolTable.end()) {
+    //symbol id of a variable that has to be declared
+    int resolve(const string& var){
+        int symbol = SymbolTable.find(var);
+        if (symbol == Symbol_Table::NONE) {
             throw runtime_error("Undefined variable: " + var);
         }
+        return symbol;
+    }
+
 
-        Type expectedType = it->second.type;
+    int getInstructionAddr(){
+        return instructionAddr;
+    }
+
+    //relocatable form of the tables for separate compilation (see Linker)
+    Object_File to_object() {
+        Object_File object;
 
-        if (expectedType == Type::BOOLEAN) {
-            PUSHB(Type(Type::BOOLEAN));
-        } else if (expectedType == Type::INTEGER) {
-            PUSHI(Type(Type::INTEGER));
+        //globals in address order (a redeclared name moves to its new address)
+        vector<pair<int, int>> byAddress;
+        //locals live in frames and are not part of the object
+        for (size_t i = 0; i < SymbolTable.size(); i++) {
+            if (SymbolTable.is_local(i)) {
+                continue;
+            }
+            byAddress.push_back({SymbolTable[i].memoryADDR, int(i)});
         }
-        else {
-            Stack.push(Type(Type::UNDEFINED));
-            generate_instruction("PUSHU");
+        sort(byAddress.begin(), byAddress.end());
+
+        unordered_map<int, int> globalOfAddress;
+        for (const auto& global : byAddress) {
+            globalOfAddress[global.first] = object.globals.size();
+            object.globals.push_back({string(SymbolTable.name(global.second)), SymbolTable[global.second].type,
+                                      global.first - Object_File::MEMORY_BASE});
+        }
+
+        for (const auto& function : FunctionTable) {
+            object.functions.push_back({string(SymbolTable.names()[function.name]), function.entryADDR, function.params,
+                                        function.returnType});
+        }
+        for (const auto& external : Externals) {
+            object.externals.push_back({string(SymbolTable.names()[external.name]), external.arguments, EXTERNAL_TYPE});
+        }
+
+        for (const auto& instr : InstructTable) {
+            int index = object.code.size();
+            object.code.push_back(instr);
+            if (is_external_call(instr)) {
+                object.relocations.push_back({index, Object_File::EXTERNAL, instr.Operand});
+                continue;
+            }
+            if (!instr.hasOperand) {
+                continue;
+            }
+            if (instr.info().operand == Operand_Kind::MEMORY) {
+                auto it = globalOfAddress.find(instr.Operand);
+                if (it != globalOfAddress.end()) {
+                    object.relocations.push_back({index, Object_File::MEMORY, it->second});
+                }
+            }
+            else if (instr.info().operand == Operand_Kind::INSTRUCTION) {
+                object.relocations.push_back({index, Object_File::INSTRUCTION, 0});
+            }
+            else if (instr.info().operand == Operand_Kind::CONSTANT) {
+                object.relocations.push_back({index, Object_File::CONSTANT, 0});
+            }
+        }
+        object.constants.assign(ConstantPool.begin(), ConstantPool.end());
+        return object;
+    }
+
+    //replaces the tables with an already linked program
+    void load(const Object_File& program) {
+        InstructTable.clear();
+        DebugTable.clear();
+        ConstantPool.clear();
+        SymbolTable.clear();
+        FunctionTable.clear();
+        Externals.clear();
+        ScratchMemory.clear();
+        loopTemporaries = 0;
+        valueTemporaries = 0;
+        stackDepth = STACK_NOT_VERIFIED;
+        instructionAddr = 1;
+        memoryAddr = Object_File::MEMORY_BASE;
+
+        InstructTable.assign(program.code.begin(), program.code.end());
+        instructionAddr = InstructTable.size() + 1;
+        for (int64_t value : program.constants) {
+            ConstantPool.index(value);
+        }
+        for (const auto& instr : InstructTable) {
+            if (instr.Operator == Opcode::PUSHF) {
+                ConstantPool.index(ConstantPool[instr.Operand], true);
+            }
+        }
+        for (const auto& global : program.globals) {
+            int address = Object_File::MEMORY_BASE + global.offset;
+            SymbolTable.declare(global.name, address, global.type);
+            memoryAddr = max(memoryAddr, address + 1);
+        }
+        for (const auto& function : program.functions) {
+            FunctionTable.push_back({SymbolTable.names().intern(function.name), function.entry});
+            FunctionTable.back().params = function.params;
+            FunctionTable.back().returnType = function.returnType;
         }
-        
-        generate_instruction("SIN");
-        POPM(SymbolTable[var].memoryADDR, var);
     }
 
-    void A() {
-        if (Stack.size() < 2) {
-            throw runtime_error("Stack underflow");
+    //drops pool entries no PUSHK or PUSHF refers to any more
+    void compact_constants(){
+        Constant_Pool used(ConstantPool.get_allocator().resource());
+        for (auto& instr : InstructTable) {
+            if (instr.info().operand == Operand_Kind::CONSTANT) {
+                instr.Operand = used.index(ConstantPool[instr.Operand], instr.Operator == Opcode::PUSHF);
+            }
         }
-    
-        Type first = Stack.top(); 
-        Stack.pop();
-        Type second = Stack.top(); 
-        Stack.pop();
-   
-        if(first == Type::INTEGER && second == Type::INTEGER){
-            Stack.push(Type(Type::INTEGER));
+        ConstantPool = std::move(used);
+    }
+
+    //addresses control can start at: the first instruction and every function
+    vector<int> entries() const {
+        vector<int> addresses = { 1 };
+        for (const auto& function : FunctionTable) {
+            addresses.push_back(function.entryADDR);
         }
-        else {
-            Stack.push(Type(Type::UNDEFINED));
+        return addresses;
+    }
+
+    //the control flow graph of the instruction table in Graphviz format
+    void write_cfg(ostream& out) const {
+        Control_Flow_Graph(InstructTable, entries()).write_dot(out, InstructTable);
+    }
+
+    //opcode_cost() of the whole instruction table
+    size_t cost() const {
+        size_t total = 0;
+        for (const auto& instr : InstructTable) {
+            total += opcode_cost(instr.Operator);
         }
-        
-        generate_instruction("A");
+        return total;
+    }
 
+    //checks the operand stack of the finished instruction table (see
+    //Stack_Verifier.h), throws when it is inconsistent
+    //a streamed table is checked as it is flushed, this flushes the rest
+    void verify() {
+        if (sink) {
+            flush(flushed + InstructTable.size());
+            stackDepth = streamVerifier->max_depth();
+            return;
+        }
+        stackDepth = Stack_Verifier(InstructTable, entries(), external_arguments()).max_depth();
     }
 
-    void S(){
-        // Pop the first two items from stack and push the difference onto the TOS
-                if (Stack.size() < 2) {
-            throw runtime_error("Stack underflow");
+    //executes the instruction table (see Interpreter.h)
+    Interpreter::Execution run(istream& in, ostream& out) const {
+        if (!Externals.empty()) {
+            throw runtime_error("Cannot run code that calls " + string(SymbolTable.names()[Externals[0].name]) +
+                                " of another object file");
         }
-    
-        Type first = Stack.top(); 
-        Stack.pop();
-        Type second = Stack.top(); 
-        Stack.pop();
-   
-        if(first == Type::INTEGER && second == Type::INTEGER){
-            Stack.push(Type(Type::INTEGER));
+        Stack_Verifier verifier(InstructTable, entries());
+        return Interpreter(InstructTable, ConstantPool, verifier, in, out).run();
+    }
+
+    //runs pass(rewriter) over the instruction table and installs the result,
+    //jump operands and function entries follow the instructions they pointed to
+    template <typename Pass>
+    auto rewrite(Pass pass){
+        Code_Rewriter rewriter(InstructTable);
+        auto result = pass(rewriter);
+        rewriter.commit(InstructTable);
+        if (!DebugTable.empty()) {
+            pmr::vector<uint32_t> debug(InstructTable.size(), DebugTable.get_allocator());
+            for (size_t i = 0; i < debug.size(); i++) {
+                debug[i] = DebugTable[rewriter.origin(i)];
+            }
+            DebugTable.swap(debug);
         }
-        else {
-            Stack.push(Type(Type::UNDEFINED));
+        for (auto& function : FunctionTable) {
+            function.entryADDR = rewriter.address(function.entryADDR);
+            if (function.endADDR) {
+                function.endADDR = rewriter.address(function.endADDR);
+            }
         }
-        
-        generate_instruction("S");
+        instructionAddr = InstructTable.size() + 1;
+        return result;
     }
 
-    void M(){
-        // Pop the first two items from stack and push the product onto the TOS
-                if (Stack.size() < 2) {
-            throw runtime_error("Stack underflow");
+    //runs the optimization passes for level over the finished tables, then the
+    //peephole rules (a Peephole_Rule set, see Peephole.h) until none fires
+    //stats (when given) gets the instruction counts before and after
+    //unroll is the factor Loop_Unrolling uses at -O2
+    //linked: the tables become an object file (-c), its globals keep their slots
+    void optimize(int level, unsigned peephole = 0, ostream* stats = nullptr,
+                  int unroll = Loop_Unrolling::UNROLL_FACTOR, bool linked = false){
+        size_t before = InstructTable.size();
+        size_t costBefore = cost();
+
+        if (level >= 2) {
+            vector<Inliner::Function> functions;
+            for (const auto& function : FunctionTable) {
+                functions.push_back({function.entryADDR, function.endADDR, function.params, function.frameSize});
+            }
+            Inliner inliner(functions, [&](int function, int slot) { return inline_temporary(function, slot); });
+            rewrite([&](Code_Rewriter& rewriter) { return inliner.run(rewriter); });
+            if (stats) {
+                *stats << "inline:\tcalls: " << inliner.calls << "\tinlined: " << inliner.inlined << "\n";
+            }
         }
-    
-        Type first = Stack.top(); 
-        Stack.pop();
-        Type second = Stack.top(); 
-        Stack.pop();
-   
-        if(first == Type::INTEGER && second == Type::INTEGER){
-            Stack.push(Type(Type::INTEGER));
+
+        Dead_Stores deadStores(ScratchMemory);
+
+        if (level >= 1) {
+            Constant_Folder folder(ConstantPool);
+            rewrite([&](Code_Rewriter& rewriter) { return folder.run(rewriter); });
+            compact_constants();
+            if (stats) {
+                *stats << "-O" << level << ":\tfolded: " << folder.folded
+                       << "\tidentities: " << folder.identities
+                       << "\tbranches: " << folder.branches << "\n";
+            }
+
+            Unreachable_Code unreachable(entries());
+            rewrite([&](Code_Rewriter& rewriter) { return unreachable.run(rewriter); });
+            if (stats) {
+                *stats << "unreachable:\tblocks: " << unreachable.blocks
+                       << "\tinstructions: " << unreachable.instructions << "\n";
+            }
+
+            if (level >= 2 && unroll >= 1) {
+                Loop_Unrolling unrolling(ConstantPool, unroll);
+                rewrite([&](Code_Rewriter& rewriter) { return unrolling.run(rewriter, entries()); });
+                compact_constants();
+                if (stats) {
+                    *stats << "unrolling:\tloops: " << unrolling.loops
+                           << "\tfull: " << unrolling.full
+                           << "\tinstructions: " << unrolling.instructions
+                           << "\tjumps saved: " << unrolling.jumps << "\n";
+                }
+            }
+
+            Loop_Rotation rotation;
+            rewrite([&](Code_Rewriter& rewriter) { return rotation.run(rewriter, entries()); });
+            if (stats) {
+                *stats << "rotation:\tloops: " << rotation.loops
+                       << "\tinstructions: " << rotation.instructions << "\n";
+            }
+
+            Loop_Invariants invariants([&](size_t pushedBy) { return loop_temporary(pushedBy); });
+            while (rewrite([&](Code_Rewriter& rewriter) { return invariants.run(rewriter, entries()); }) > 0) {
+            }
+            if (stats) {
+                *stats << "invariants:\tloops: " << invariants.loops
+                       << "\thoisted: " << invariants.hoisted
+                       << "\tinstructions: " << invariants.instructions << "\n";
+            }
+
+            Strength_Reduction reduction(ConstantPool, [&](size_t pushedBy) { return loop_temporary(pushedBy); });
+            while (rewrite([&](Code_Rewriter& rewriter) { return reduction.induction(rewriter, entries()); }) > 0) {
+            }
+            rewrite([&](Code_Rewriter& rewriter) { return reduction.run(rewriter); });
+            compact_constants();
+            if (stats) {
+                *stats << "strength:\tshifts: " << reduction.shifts
+                       << "\tdivisions: " << reduction.divisions
+                       << "\tinductions: " << reduction.inductions << "\n";
+            }
+
+            Value_Numbering numbering([&](size_t pushedBy) { return value_temporary(pushedBy); });
+            rewrite([&](Code_Rewriter& rewriter) { return numbering.run(rewriter, entries()); });
+            if (stats) {
+                *stats << "value numbering:\tvalues: " << numbering.values
+                       << "\treused: " << numbering.reused
+                       << "\ttemporaries: " << numbering.temporaries << "\n";
+            }
+
+            eliminate_dead_stores(deadStores);
         }
-        else {
-            Stack.push(Type(Type::UNDEFINED));
+
+        if (peephole) {
+            Peephole window(peephole);
+            while (rewrite([&](Code_Rewriter& rewriter) { return window.run(rewriter); }) > 0) {
+            }
+            //a DUP the peephole put in front of a store can leave it dead
+            if (level >= 1) {
+                eliminate_dead_stores(deadStores);
+            }
+            if (stats) {
+                window.write_stats(*stats);
+            }
+        }
+
+        if (stats && level >= 1) {
+            *stats << "dead stores:\tstores: " << deadStores.stores
+                   << "\tpopped: " << deadStores.popped
+                   << "\tinstructions: " << deadStores.instructions << "\n";
+        }
+
+        if (level >= 1) {
+            Memory_Coloring coloring(ScratchMemory, linked);
+            color_memory(coloring);
+            if (stats) {
+                *stats << "data segment:\tcells: " << coloring.before << " -> " << coloring.after
+                       << "\tshared: " << coloring.shared << "\n";
+            }
+        }
+
+        if (stats && (level >= 1 || peephole)) {
+            *stats << "instructions: " << before << " -> " << InstructTable.size() << "\n";
+            *stats << "cost: " << costBefore << " -> " << cost() << "\n";
         }
-        
-        generate_instruction("M");
     }
 
-    void D(){
-        // Pop the first two items from stack and push the result onto the TOS
-                if (Stack.size() < 2) {
-            throw runtime_error("Stack underflow");
+    //moves the globals and scratch memory to the slots coloring gives them
+    void color_memory(Memory_Coloring& coloring){
+        vector<int> addresses;
+        for (size_t i = 0; i < SymbolTable.size(); i++) {
+            if (!SymbolTable.is_local(i)) {
+                addresses.push_back(SymbolTable[i].memoryADDR);
+            }
         }
-    
-        Type first = Stack.top(); 
-        Stack.pop();
-        Type second = Stack.top(); 
-        Stack.pop();
-   
-        if(first == Type::INTEGER && second == Type::INTEGER){
-            Stack.push(Type(Type::INTEGER));
+        unordered_map<int, int> moved = coloring.run(InstructTable, entries(), addresses, Object_File::MEMORY_BASE);
+        for (size_t i = 0; i < SymbolTable.size(); i++) {
+            if (!SymbolTable.is_local(i)) {
+                SymbolTable[i].memoryADDR = moved.at(SymbolTable[i].memoryADDR);
+            }
         }
-        else {
-            Stack.push(Type(Type::UNDEFINED));
+        for (int& address : ScratchMemory) {
+            address = moved.at(address);
         }
-        
-        generate_instruction("D");
+        memoryAddr = Object_File::MEMORY_BASE + coloring.after;
     }
 
-    void GRT(){
-        //Pops two items from the stack and pushes 1 onto TOS if second item is larger otherwise push 0
-        if (Stack.size() < 2) {
-            throw runtime_error("Stack underflow");
+    //runs the dead store pass until it finds nothing
+    void eliminate_dead_stores(Dead_Stores& deadStores){
+        while (rewrite([&](Code_Rewriter& rewriter) { return deadStores.run(rewriter, entries()); }) > 0) {
         }
-    
-        Type first = Stack.top(); 
-        Stack.pop();
-        Type second = Stack.top(); 
-        Stack.pop();
-   
-        if(first == Type::INTEGER && second == Type::INTEGER){
-            Stack.push(Type(Type::INTEGER));
+    }
+
+    //points every branch of the innermost list at JMP_address
+    void back_patch(int JMP_address){
+        if(JumpStack.size() >= 1){
+            patch_branches(JumpStack.back(), JMP_address);
+            JumpStack.pop_back();
+        }
+    }
+
+    void patch_branches(const pmr::vector<int>& branches, int JMP_address){
+        for (int addr : branches) {
+            if(is_branch(instruction(addr).Operator)){
+                instruction(addr).hasOperand = true;
+                instruction(addr).Operand = JMP_address;
+            }
+        }
+    }
+
+    //a LABEL for the branches to jump to, when there are any
+    void patch_here(pmr::vector<int>& branches){
+        if (!branches.empty()) {
+            patch_branches(branches, getInstructionAddr());
+            LABEL();
+            branches.clear();
         }
-        else if(first == Type::BOOLEAN && second == Type::BOOLEAN){
-            Stack.push(Type(Type::BOOLEAN));
+    }
+
+    //JMP0 <-> JMP1
+    void invert(int addr){
+        Opcode op = instruction(addr).Operator;
+        instruction(addr).Operator = op == Opcode::JMP0 ? Opcode::JMP1 : Opcode::JMP0;
+    }
+
+    //and, or and not, see Condition_Lists
+    using Conditions = Condition_Lists<Symbol_and_Assembly>;
+
+    //JMP0 after a comparison
+    void comparison_branch(){
+        Conditions::comparison(JumpStack, getInstructionAddr() - 1);
+        JMP0();
+    }
+
+    void missing_comparison(){
+        Conditions::missing_comparison(JumpStack);
+    }
+
+    void begin_and(){
+        Conditions::begin_and(JumpStack, *this);
+    }
+
+    void end_and(){
+        Conditions::end_and(JumpStack);
+    }
+
+    void begin_or(){
+        Conditions::begin_or(JumpStack, *this);
+    }
+
+    void end_or(){
+        Conditions::end_or(JumpStack);
+    }
+
+    void negate(){
+        Conditions::negate(JumpStack, *this);
+    }
+
+    void end_condition(){
+        Conditions::end_condition(JumpStack, *this);
+    }
+
+    //PUSHI
+    void PUSHI(Type type, int64_t value = 0){
+        //Pushes the {Integer Value} onto the Top of the Stack (TOS)
+        Stack.push(Type(type));
+        if (fits_operand(value)) {
+            generate_instruction(Opcode::PUSHI, int(value));
         }
         else {
-            Stack.push(Type(Type::UNDEFINED));
+            generate_instruction(Opcode::PUSHK, ConstantPool.index(value));
         }
-        
-        generate_instruction("GRT");
     }
 
-    void LES() {
-        //Pops two items from the stack and pushes 1 onto TOS if the second item is smaller than first item otherwise push 0
-        if (Stack.size() < 2) {
+    //PUSHF of a REAL literal, from the constant pool
+    void PUSHF(double value){
+        Stack.push(Type::REAL);
+        generate_instruction(Opcode::PUSHF, ConstantPool.index(real_bits(value), true));
+    }
+
+    //- <Primary> of a value that is not a literal: multiplies it by -1, which
+    //for a REAL also turns 0 into -0
+    void negate_value(){
+        if (Stack.empty()) {
             throw runtime_error("Stack underflow");
         }
-    
-        Type first = Stack.top(); 
-        Stack.pop();
-        Type second = Stack.top(); 
-        Stack.pop();
-   
-        if(first == Type::INTEGER && second == Type::INTEGER){
-            Stack.push(Type(Type::INTEGER));
+        if (Stack.top() == Type::BOOLEAN) {
+            throw runtime_error("Type mismatch: - of a Boolean value");
         }
-        else if(first == Type::BOOLEAN && second == Type::BOOLEAN){
-            Stack.push(Type(Type::BOOLEAN));
+        if (Stack.top() == Type::REAL) {
+            PUSHF(-1.0);
         }
         else {
-            Stack.push(Type(Type::UNDEFINED));
+            PUSHI(Type::INTEGER, -1);
         }
-        
-        generate_instruction("LES");
+        binary_operator(Opcode::M);
     }
 
-    void EQU() {
-        //Pops two items from the stack and pushes 1 onto TOS if they are equal otherwise push 0
-       if (Stack.size() < 2) {
-            throw runtime_error("Stack underflow");
+    void PUSHB(Type type, bool value = false) {
+        //Push Boolean values onto TOS, 1 for true and 0 for false
+        Stack.push(Type(type));
+        generate_instruction(Opcode::PUSHB, value);
+
+    }
+
+    //memory for a local of an inlined function, named function.local
+    int inline_temporary(int function, int slot){
+        for (size_t i = 0; i < SymbolTable.size(); i++) {
+            const Symbol_Table::Symbol& local = SymbolTable[i];
+            if (local.scope == function + 1 && local.memoryADDR == slot) {
+                int address = generate_temporary(string(SymbolTable.names()[FunctionTable[function].name]) + "." +
+                                                 string(SymbolTable.name(i)), local.type);
+                ScratchMemory.push_back(address);
+                return address;
+            }
         }
-    
-        Type first = Stack.top(); 
-        Stack.pop();
-        Type second = Stack.top(); 
-        Stack.pop();
-   
-        if(first == Type::INTEGER && second == Type::INTEGER){
-            Stack.push(Type(Type::INTEGER));
+        throw runtime_error("No local in slot " + to_string(slot));
+    }
+
+    //type of the value instruction index pushes
+    Type value_type(size_t index) const {
+        const Instruction& instr = InstructTable[index];
+        Type type = pushed_type(instr.Operator);
+        if (type != Type::UNDEFINED) {
+            return type;
         }
-        else if(first == Type::BOOLEAN && second == Type::BOOLEAN){
-            Stack.push(Type(Type::BOOLEAN));
+        if (instr.Operator == Opcode::DUP) {
+            //copies the value below it
+            return index > 0 ? value_type(index - 1) : Type::UNDEFINED;
         }
-        else {
-            Stack.push(Type(Type::UNDEFINED));
+        if (instr.Operator == Opcode::CALL) {
+            for (const auto& function : FunctionTable) {
+                if (instr.hasOperand && function.entryADDR == instr.Operand) {
+                    return function.returnType;
+                }
+            }
+            return EXTERNAL_TYPE;
+        }
+        //PUSHL reads a local of the function the instruction is in
+        int scope = 0;
+        for (size_t f = 0; f < FunctionTable.size(); f++) {
+            if (instr.Operator == Opcode::PUSHL && FunctionTable[f].entryADDR <= int(index) + 1 &&
+                int(index) + 1 < FunctionTable[f].endADDR) {
+                scope = f + 1;
+            }
         }
-        
-        generate_instruction("EQU");
+        for (size_t i = 0; i < SymbolTable.size(); i++) {
+            if (SymbolTable[i].memoryADDR == instr.Operand && SymbolTable[i].scope == scope) {
+                return SymbolTable[i].type;
+            }
+        }
+        return Type::UNDEFINED;
     }
 
-    void NEQ() {
-        //Pops two items from the stack and pushes 1 onto TOS if they are not equal otherwise push 0
-        if (Stack.size() < 2) {
-            throw runtime_error("Stack underflow");
+    //memory for a value computed before a loop (see Loop_Invariants.h), only
+    //that loop reads it, pushedBy is the instruction that computes it
+    int loop_temporary(size_t pushedBy){
+        int address = generate_temporary("loop." + to_string(++loopTemporaries), value_type(pushedBy));
+        ScratchMemory.push_back(address);
+        return address;
+    }
+
+    //memory for a value computed again in its block (see Value_Numbering.h),
+    //pushedBy is the instruction that computes it
+    int value_temporary(size_t pushedBy){
+        int address = generate_temporary("value." + to_string(++valueTemporaries), value_type(pushedBy));
+        ScratchMemory.push_back(address);
+        return address;
+    }
+
+    //PUSHM or PUSHL, depending on where the variable lives
+    void push_variable(int symbol){
+        if (SymbolTable.is_local(symbol)) {
+            PUSHL(symbol);
         }
-    
-        Type first = Stack.top(); 
-        Stack.pop();
-        Type second = Stack.top(); 
-        Stack.pop();
-   
-        if(first == Type::INTEGER && second == Type::INTEGER){
-            Stack.push(Type(Type::INTEGER));
+        else {
+            PUSHM(symbol);
         }
-        else if(first == Type::BOOLEAN && second == Type::BOOLEAN){
-            Stack.push(Type(Type::BOOLEAN));
+    }
+
+    //POPM or POPL, depending on where the variable lives
+    void pop_variable(int symbol){
+        if (SymbolTable.is_local(symbol)) {
+            POPL(symbol);
         }
         else {
-            Stack.push(Type(Type::UNDEFINED));
+            POPM(symbol);
         }
-        
-        generate_instruction("NEQ");
     }
 
-    void GEQ() {
-        //Pops two items from the stack and pushes 1 onto TOS if second item is larger or equal otherwise push 0
-       if (Stack.size() < 2) {
+    //PUSHL
+    void PUSHL(int symbol){
+        //Pushes the value in frame slot {SL} onto TOS
+        Stack.push(SymbolTable[symbol].type);
+        generate_instruction(Opcode::PUSHL, SymbolTable[symbol].memoryADDR);
+    }
+
+    void POPL(int symbol){
+        //Pops the value from the top of the stack and stores it in frame slot {SL}
+        if(Stack.empty()){
             throw runtime_error("Stack underflow");
         }
-    
-        Type first = Stack.top(); 
-        Stack.pop();
-        Type second = Stack.top(); 
+
+        widen(SymbolTable[symbol].type);
+        SymbolTable[symbol].type = stored_type(SymbolTable[symbol].type, Stack.top(), SymbolTable.name(symbol));
         Stack.pop();
-   
-        if(first == Type::INTEGER && second == Type::INTEGER){
-            Stack.push(Type(Type::INTEGER));
+
+        generate_instruction(Opcode::POPL, SymbolTable[symbol].memoryADDR);
+    }
+
+    //PUSHM
+    void PUSHM(int symbol){
+        //Pushes the value stored at {ML} onto TOS
+        Stack.push(SymbolTable[symbol].type);
+        generate_instruction(Opcode::PUSHM, SymbolTable[symbol].memoryADDR);
+    }
+
+    void POPM(int symbol){
+        //Pops the value from the top of the stack and stores it at {ML}
+        if(Stack.empty()){
+            throw runtime_error("Stack underflow");
         }
-        else if(first == Type::BOOLEAN && second == Type::BOOLEAN){
-            Stack.push(Type(Type::BOOLEAN));
+
+        widen(SymbolTable[symbol].type);
+        Type stackType = Stack.top();
+        Stack.pop();
+
+        SymbolTable[symbol].type = stored_type(SymbolTable[symbol].type, stackType, SymbolTable.name(symbol));
+
+        generate_instruction(Opcode::POPM, SymbolTable[symbol].memoryADDR);
+    }
+
+    //an INTEGER on TOS stored into a REAL variable is converted first
+    void widen(Type variable){
+        optional<Opcode> convert = widening(variable, Stack.top());
+        if (convert) {
+            Stack.top() = Type::REAL;
+            generate_instruction(*convert);
         }
-        else {
-            Stack.push(Type(Type::UNDEFINED));
+    }
+
+    void SOUT(){
+        // Pops the value from the top of the stack and prints it and adds instruction
+        if (Stack.empty()) {
+            throw runtime_error("Stack underflow");
         }
-        
-        generate_instruction("GEQ");
+        Type type = Stack.top();
+        Stack.pop();
 
+        generate_instruction(print_opcode(type));
     }
 
-    void LEQ() {
-        //Pops two items from the stack and pushes 1 onto TOS if second item is Less or equal otherwise push 0
-        if (Stack.size() < 2) {
+    void SIN(int symbol){
+        Type expectedType = SymbolTable[symbol].type;
+
+        Stack.push(expectedType);
+        generate_instruction(scan_placeholder(expectedType));
+        generate_instruction(scan_opcode(expectedType));
+        pop_variable(symbol);
+    }
+
+    //A, S, M, D, GRT, LES, EQU, NEQ, GEQ, LEQ
+    //pops two types and generates the code typed_operator() gives for them
+    void binary_operator(Opcode op){
+        if (Stack.size() < opcode_info(op).pops) {
             throw runtime_error("Stack underflow");
         }
-    
-        Type first = Stack.top(); 
+
+        Type first = Stack.top();
         Stack.pop();
-        Type second = Stack.top(); 
+        Type second = Stack.top();
         Stack.pop();
-   
-        if(first == Type::INTEGER && second == Type::INTEGER){
-            Stack.push(Type(Type::INTEGER));
-        }
-        else if(first == Type::BOOLEAN && second == Type::BOOLEAN){
-            Stack.push(Type(Type::BOOLEAN));
-        }
-        else {
-            Stack.push(Type(Type::UNDEFINED));
+
+        Typed_Operator code = typed_operator(op, first, second);
+        if (code.convert) {
+            generate_instruction(*code.convert);
         }
-        
-        generate_instruction("LEQ");
+        Stack.push(code.result);
+        generate_instruction(code.op);
     }
 
     void JMP0(){
@@ -431,20 +1114,16 @@ public:
         }
         // Type value = Stack.top();
         Stack.pop();
-        generate_instruction("JMP0");
+        generate_instruction(Opcode::JMP0);
     }
 
     void JMP(int instructionLoc) {
         //Unconditionally jmp to {IL}
-        generate_instruction("JMP", instructionLoc);
-    }
-
-    void push_JMPstack(int instructionLoc){
-        JumpStack.push(instructionLoc);
+        generate_instruction(Opcode::JMP, instructionLoc);
     }
 
     void LABEL() {
-        generate_instruction("LABEL");
+        generate_instruction(Opcode::LABEL);
     }
 };
 
@@ -452,55 +1131,45 @@ class SyntaxAnalyzer {
 private:
 
     Symbol_and_Assembly symbolAndAssembly;
-    vector<Token> tokens;
+    pmr::vector<Token> tokens;
     size_t currentIndex = 0;
-    ostream& outSyntaxAnalyzer;
-
-    // Converts string to TokenType
-    TokenType stringToTokenType(const string& tokenType) {
-        if (tokenType == "keyword") return TokenType::KEYWORD;
-        if (tokenType == "identifier") return TokenType::IDENTIFIER;
-        if (tokenType == "integer") return TokenType::INTEGER;
-        if (tokenType == "real") return TokenType::REAL;
-        if (tokenType == "operator") return TokenType::OPERATOR;
-        if (tokenType == "separator") return TokenType::SEPARATOR;
-        return TokenType::UNKNOWN;
-    }
-    
-    // Converts TokenType to string for printing
-    string tokenTypeToString(TokenType type) {
-        switch (type) {
-            case TokenType::KEYWORD: return "KEYWORD";
-            case TokenType::IDENTIFIER: return "IDENTIFIER";
-            case TokenType::INTEGER: return "INTEGER";
-            case TokenType::REAL: return "REAL";
-            case TokenType::OPERATOR: return "OPERATOR";
-            case TokenType::SEPARATOR: return "SEPARATOR";
-            case TokenType::UNKNOWN: return "UNKNOWN";
-            case TokenType::EMPTY: return "EMPTY";
-            default: return "UNKNOWN";
-        }
-    }
+    Syntax_Trace trace;
+    Token_Pipeline* pipeline = nullptr;
+    bool endOfInput = false; //lexer() ran out of tokens, the program is cut short
 
     Token lexer(bool print = false) {
+        //in pipelined mode, waits for the lexer thread to hand over more tokens
+        if (currentIndex >= tokens.size() && pipeline) {
+            pipeline->next_batch(tokens);
+        }
+
         // Check if there are more tokens to read
         if (currentIndex < tokens.size()) {
             Token token = tokens[currentIndex++];
+            symbolAndAssembly.at_token(currentIndex - 1);
 
             //will print the token type and value if the print is true
             if(print){
-                outSyntaxAnalyzer << "================================================================================" << endl;
-                outSyntaxAnalyzer << "\t\t\tToken:" << tokenTypeToString(token.type) << "\tLexeme:" << token.value << endl;
-                outSyntaxAnalyzer << "================================================================================" << endl;
+                trace.token(currentIndex - 1);
             }
 
             return token;
         } else {
             // Handle the case where there are no more tokens
+            endOfInput = true;
             return Token(TokenType::EMPTY, "");
         }
     }
 
+    //the next token without consuming it, EMPTY at the end of the input
+    Token peek() {
+        Token token = lexer();
+        if (token.type != TokenType::EMPTY) {
+            currentIndex--;
+        }
+        return token;
+    }
+
     //returns true if the token is $$
     bool check$$(Token token){
         if (token.type == TokenType::SEPARATOR && token.value == "$$") {
@@ -527,87 +1196,146 @@ private:
     }
 
 public: 
-    SyntaxAnalyzer(ostream& syntaxOut, ostream& symbolOut) 
-    : symbolAndAssembly(symbolOut),
-    outSyntaxAnalyzer(syntaxOut) {  
+    //traceCapacity 0 streams the whole derivation to syntaxOut,
+    //otherwise only the last traceCapacity steps are kept and written on errors
+    //memory is where the token list, tables and stacks are allocated (see Compilation_Arena)
+    SyntaxAnalyzer(ostream& syntaxOut, ostream& symbolOut, size_t traceCapacity = 0,
+                   pmr::memory_resource* memory = pmr::get_default_resource())
+    : symbolAndAssembly(symbolOut, memory),
+    tokens(memory),
+    trace(syntaxOut, tokens, currentIndex, traceCapacity) {
         if (!syntaxOut.good() || !symbolOut.good()) {
             throw runtime_error("Output stream(s) not in good state");
         }
     }
 
+    //writes the steps held by the flight recorder
+    void dump_trace() {
+        trace.dump();
+    }
+
+    void optimize(int level, unsigned peephole = 0, ostream* stats = nullptr,
+                  int unroll = Loop_Unrolling::UNROLL_FACTOR, bool linked = false) {
+        symbolAndAssembly.optimize(level, peephole, stats, unroll, linked);
+    }
+
+    void verify() {
+        symbolAndAssembly.verify();
+    }
+
+    //compiles for write_object(), calls to functions this file does not
+    //define are left to the linker
+    void object_code() {
+        symbolAndAssembly.object_code();
+    }
+
+    //writes a relocatable object file instead of the listing
+    void write_object(ostream& out) {
+        symbolAndAssembly.to_object().write(out);
+    }
+
+    //writes a bytecode file instead of the listing
+    void write_bytecode(ostream& out) {
+        symbolAndAssembly.write_bytecode(out);
+    }
+
+    void write_cfg(ostream& out) {
+        symbolAndAssembly.write_cfg(out);
+    }
+
+    Interpreter::Execution run(istream& in, ostream& out) {
+        return symbolAndAssembly.run(in, out);
+    }
+
+    //hands instructions to sink while parsing instead of keeping the whole table
+    void stream(Instruction_Sink& sink) {
+        symbolAndAssembly.stream(sink);
+    }
+
     void display_RPD() {
         symbolAndAssembly.display_instructions();
+        symbolAndAssembly.display_constant_pool();
         symbolAndAssembly.display_symbol_table();
     }
 
-    //reads all values from the file
-    void readFile(const string& input, const int& headerNumber) {
-        ifstream file(input);
-        string line;
-        string tokenValue, tokenType;
-
-        //skips the header information
-        for(int i = 0; i < headerNumber; i++){
-            getline(file, line);
-        }
-
-        //gets token type and token value from each line
-        while (getline(file, line)) {
-            istringstream lineStream(line);
-            lineStream >> tokenType >> tokenValue;
-            tokens.push_back(Token(stringToTokenType(tokenType), tokenValue));
-        }
+    //parses the tokens main.cpp lexed, they stay in the arena they were made in
+    void readTokens(pmr::vector<Token>&& lexed) {
+        tokens = std::move(lexed);
+    }
 
-        file.close();
+    //reads tokens straight from the lexer thread instead of Lexical_Analysis_Output.txt
+    void readPipeline(Token_Pipeline& source) {
+        pipeline = &source;
     }
 
     void Rat25S() {
         // $$ <Opt Function Definitions> $$ <Opt Declaration List> $$ <Statement List>$$
         Token token = lexer(true);
         if (check$$(token)) {
-            outSyntaxAnalyzer << "<Rat25S> -> $$ <Opt Function Definitions> $$ <Opt Declaration List> $$ <Statement List>$$" << endl;
-            outSyntaxAnalyzer << "<Rat25S> -> $$ <Opt Function Definitions>" << endl;
+            trace.line("<Rat25S> -> $$ <Opt Function Definitions> $$ <Opt Declaration List> $$ <Statement List>$$");
+            trace.line("<Rat25S> -> $$ <Opt Function Definitions>");
             Opt_Function_Definitions();
             token = lexer(true);
             if (check$$(token)) {
-                outSyntaxAnalyzer << "$$ <Opt Declaration List>" << endl;
+                trace.line("$$ <Opt Declaration List>");
                 Opt_Declaration_List();
                 token = lexer(true);
                 if (check$$(token)) {
-                    outSyntaxAnalyzer << "$$ <Statement List>" << endl;
+                    trace.line("$$ <Statement List>");
                     Statement_List();
                     token = lexer(true);
                     if (check$$(token)) {
-                        outSyntaxAnalyzer << "$$" << endl;
-                        outSyntaxAnalyzer << "Parse complete: Correct syntax" << endl;
+                        trace.line("$$");
+                        trace.line("Parse complete: Correct syntax");
                     } else {
-                        outSyntaxAnalyzer << "Error: Expected '$$' at the end of Statement_List";
+                        trace.error("Error: Expected '$$' at the end of Statement_List");
                     }
+                    symbolAndAssembly.resolve_calls();
                 } else {
-                    outSyntaxAnalyzer << "Error: Expected '$$' at the end of Opt_Declaration_List";
+                    trace.error("Error: Expected '$$' at the end of Opt_Declaration_List");
                 }
             } else {
-                outSyntaxAnalyzer << "Error: Expected '$$' at the end of Opt_Function_Definitions";
+                trace.error("Error: Expected '$$' at the end of Opt_Function_Definitions");
             }
         } else {
-            outSyntaxAnalyzer << "Error: Expected '$$' at the start of Opt_Function_Definitions";
+            trace.error("Error: Expected '$$' at the start of Opt_Function_Definitions");
+        }
+        if (endOfInput) {
+            throw runtime_error("Unexpected end of input");
         }
     }
 
     void Opt_Function_Definitions(){
         // <Function Definitions> | <Empty>
         if(!Empty()){
-            outSyntaxAnalyzer << "<Opt Function Definitions> -> <Function Definitions>" << endl;
-             Function_Definitions();
+            trace.line("<Opt Function Definitions> -> <Function Definitions>");
+            symbolAndAssembly.return_types(Return_Types<pmr::vector<Token>>::infer(function_definitions(), currentIndex,
+                                                                                 symbolAndAssembly.external_type()));
+            symbolAndAssembly.begin_functions();
+            Function_Definitions();
+            symbolAndAssembly.end_functions();
         }
         else{
-            outSyntaxAnalyzer << "<Opt Function Definitions> -> <Empty>" << endl;
+            trace.line("<Opt Function Definitions> -> <Empty>");
+        }
+    }
+
+    //tokens up to the $$ after the function definitions, in pipelined mode
+    //waits for the lexer thread to hand all of them over
+    const pmr::vector<Token>& function_definitions() {
+        size_t scanned = currentIndex;
+        while (pipeline && Return_Types<pmr::vector<Token>>::section_end(tokens, scanned) == tokens.size()) {
+            scanned = tokens.size();
+            if (!pipeline->next_batch(tokens)) {
+                break;
+            }
         }
+        return tokens;
     }
 
     void Function_Definitions(){
         //<Function> <fd>
-        outSyntaxAnalyzer << "<Function Definitions> -> <Function> <FD>" << endl;
+        trace.line("<Function Definitions> -> <Function> <FD>");
         Function();
         FD();
     }
@@ -615,11 +1343,11 @@ public:
     void FD(){
         //(ε | <Function Definitions>)
         if (!Empty()) {
-            outSyntaxAnalyzer << "<FD> -> <Function Definitions>" << endl;
+            trace.line("<FD> -> <Function Definitions>");
             Function_Definitions();
         }
         else{
-            outSyntaxAnalyzer << "<FD> -> ε" << endl;
+            trace.line("<FD> -> ε");
         }
     }
 
@@ -627,90 +1355,91 @@ public:
         // function <Identifier> ( <Opt Parameter List> ) <Opt Declaration List> <Body>
         Token token = lexer(true);
         if (token.type == TokenType::KEYWORD && token.value == "function") {
-            outSyntaxAnalyzer << "<Function> -> function <Identifier> ( <Opt Parameter List> ) <Opt Declaration List> <Body>" << endl;
-            outSyntaxAnalyzer << "<Function> -> function <Identifier>" << endl;   
+            trace.line("<Function> -> function <Identifier> ( <Opt Parameter List> ) <Opt Declaration List> <Body>");
+            trace.line("<Function> -> function <Identifier>");
+            size_t nameIndex = currentIndex;
             Identifier(Type(Type::UNDEFINED));
+            if (nameIndex < tokens.size() && tokens[nameIndex].type == TokenType::IDENTIFIER) {
+                symbolAndAssembly.generate_function(tokens[nameIndex].value);
+            }
             token = lexer(true);
             if(token.type == TokenType::SEPARATOR && token.value == "("){
-                outSyntaxAnalyzer << "( <Opt Parameter List>" << endl;   
+                trace.line("( <Opt Parameter List>");
                 Opt_Parameter_List();
                 token = lexer(true);
                 if(token.type == TokenType::SEPARATOR && token.value == ")"){
-                    outSyntaxAnalyzer << ") <Opt Declaration List>" << endl;
+                    trace.line(") <Opt Declaration List>");
                     Opt_Declaration_List();
-                    outSyntaxAnalyzer << "<Body>" << endl;
+                    trace.line("<Body>");
+                    symbolAndAssembly.begin_body();
                     Body();
-                    outSyntaxAnalyzer << "End of Function" << endl;
+                    symbolAndAssembly.end_body();
+                    trace.line("End of Function");
                 } else {
-                    outSyntaxAnalyzer << "Error: Expected ')' at the end of Function";
+                    trace.error("Error: Expected ')' at the end of Function");
                 }
             } else {
-                outSyntaxAnalyzer << "Error: Expected '(' at the start of Function";
+                trace.error("Error: Expected '(' at the start of Function");
             }
 
         } else {
-            outSyntaxAnalyzer << "Error: Expected 'function' at the start of Function";
+            trace.error("Error: Expected 'function' at the start of Function");
         }
     }
 
     void Opt_Parameter_List(){
         // Parameter_List() | Empty()
-        Token token = lexer();
-        currentIndex--;
+        Token token = peek();
         if(token.type != TokenType::SEPARATOR && (token.value != ")" || token.value != "$$")){
-            outSyntaxAnalyzer << "<Opt Parameter List> -> <Parameter List>" << endl;
+            trace.line("<Opt Parameter List> -> <Parameter List>");
             Parameter_List();
         }
         else{
-            outSyntaxAnalyzer << "<Opt Parameter List> -> <Empty>" << endl;
+            trace.line("<Opt Parameter List> -> <Empty>");
         }
     }
 
     void Parameter_List(){
         //<Parameter> <P>
-        outSyntaxAnalyzer << "<Parameter List> -> <Parameter> <P>" << endl;
+        trace.line("<Parameter List> -> <Parameter> <P>");
         Parameter();
         P();
     }
 
     void P(){
         // (ε |  , <Parameter List>)
-        Token token = lexer();
-        currentIndex--;
+        Token token = peek();
         if(token.type == TokenType::SEPARATOR && token.value == ","){
             Token token = lexer(true);
-            outSyntaxAnalyzer << "<P> -> , <Parameter List>" << endl;
+            trace.line("<P> -> , <Parameter List>");
             Parameter_List();
         }
         else{
-            outSyntaxAnalyzer << "<P> -> ε" << endl;
+            trace.line("<P> -> ε");
         }
     }
 
     void Parameter(){
         //<IDs> <Qualifier>
-        outSyntaxAnalyzer << "<Parameter> -> <IDs> <Qualifier>" << endl;
-        IDS();
-        Qualifier();
+        trace.line("<Parameter> -> <IDs> <Qualifier>");
+        vector<string> names;
+        IDS(names);
+        Type type = Qualifier();
+        for (const string& name : names) {
+            symbolAndAssembly.generate_parameter(name, type);
+        }
     }
 
     Type Qualifier(){
         // integer | boolean | real
         Token token = lexer(true);
-        if(token.type == TokenType::KEYWORD && token.value == "integer"){
-            outSyntaxAnalyzer << "<Qualifier> -> integer | boolean | real" << endl;
-            return Type(Type::INTEGER);
-        }
-        else if(token.type == TokenType::KEYWORD && token.value == "boolean"){
-            outSyntaxAnalyzer << "<Qualifier> -> integer | boolean | real" << endl;
-            return Type(Type::BOOLEAN);
-        }
-        else if(token.type == TokenType::KEYWORD && token.value == "real"){
-            outSyntaxAnalyzer << "<Qualifier> -> integer | boolean | real" << endl;
-            return Type(Type::UNDEFINED);
+        Type type = token.type == TokenType::KEYWORD ? qualifier_type(token.value) : Type::UNDEFINED;
+        if(type != Type::UNDEFINED){
+            trace.line("<Qualifier> -> integer | boolean | real");
+            return type;
         }
         else {
-            outSyntaxAnalyzer << "Error: Invalid Qualifier. Expected token type of integer, boolean, or real";
+            trace.error("Error: Invalid Qualifier. Expected token type of integer, boolean, or real");
             return Type(Type::UNDEFINED);
         }
     }
@@ -719,63 +1448,61 @@ public:
         // { < Statement List> }
         Token token = lexer(true);
         if (token.type == TokenType::SEPARATOR && token.value == "{") {
-            outSyntaxAnalyzer << "<Body> -> { <Statement List> }" << endl;
-            outSyntaxAnalyzer << "<Body> -> { <Statement List>" << endl;
+            trace.line("<Body> -> { <Statement List> }");
+            trace.line("<Body> -> { <Statement List>");
             Statement_List();
             Token token = lexer(true);
             if (token.type == TokenType::SEPARATOR && token.value == "}") {
-                outSyntaxAnalyzer << "}" << endl;
-                outSyntaxAnalyzer << "End of Body" << endl;
+                trace.line("}");
+                trace.line("End of Body");
             } else {
-                outSyntaxAnalyzer << "Error: Expected '}' at the end of Body";
+                trace.error("Error: Expected '}' at the end of Body");
             }
         } else {
-            outSyntaxAnalyzer << "Error: Expected '{' at the start of Body";
+            trace.error("Error: Expected '{' at the start of Body");
         }
     }
 
     void Opt_Declaration_List(){
         // Declaration_List() | Empty()
-        Token token = lexer();
-        currentIndex--;
-        if(token.type == TokenType::KEYWORD && (token.value == "integer" || token.value == "real" || token.value == "boolean")){
-            outSyntaxAnalyzer << "<Opt Declaration List> -> <Declaration List>" << endl;
+        Token token = peek();
+        if(token.type == TokenType::KEYWORD && qualifier_type(token.value) != Type::UNDEFINED){
+            trace.line("<Opt Declaration List> -> <Declaration List>");
             Declaration_List();
         }
         else{
-            outSyntaxAnalyzer << "<Opt Declaration List> -> <Empty>" << endl;
+            trace.line("<Opt Declaration List> -> <Empty>");
         }
     }
 
     void Declaration_List(){
         // <Declaration> ; <D>
-        outSyntaxAnalyzer << "<Declaration List> -> <Declaration> ; <D>" << endl;
+        trace.line("<Declaration List> -> <Declaration> ; <D>");
         Declaration();
         Token token = lexer(true);
         if(token.type == TokenType::SEPARATOR && token.value == ";"){
-            outSyntaxAnalyzer << "; <D>" << endl;
+            trace.line("; <D>");
             D();
         } else {
-            outSyntaxAnalyzer << "Error: Expected ';' at the end of Declaration_List";
+            trace.error("Error: Expected ';' at the end of Declaration_List");
         }
     }
 
     void D(){
         // (ε | <Declaration List>)
-        Token token = lexer();
-        currentIndex--;
+        Token token = peek();
         if(token.type != TokenType::SEPARATOR && (token.value != "{" || token.value != "$$")){
-            outSyntaxAnalyzer << "<D> -> <Declaration List>" << endl;
+            trace.line("<D> -> <Declaration List>");
             Declaration_List();
         }
         else{
-            outSyntaxAnalyzer << "<D> -> ε" << endl;
+            trace.line("<D> -> ε");
         }
     }
 
     void Declaration(){
         // <Qualifier > <IDs>
-        outSyntaxAnalyzer << "<Declaration> -> <Qualifier> <IDs>" << endl;
+        trace.line("<Declaration> -> <Qualifier> <IDs>");
         Type value = Qualifier();
         IDS(value);
     }
@@ -787,37 +1514,65 @@ public:
     }
 
     void IDS(Type value){
-        outSyntaxAnalyzer << "<IDs> -> <Identifier> <id>" << endl;
+        trace.line("<IDs> -> <Identifier> <id>");
         // <Identifier> <id>
         Identifier(value);
         id(value);
     }
 
+    //only collects the names, for parameters and call arguments
+    void IDS(vector<string>& names){
+        Identifier(names);
+        id(names);
+    }
+
+    void id(vector<string>& names){
+        //  (ε | , <IDs>)
+        Token token = peek();
+        if(token.type == TokenType::SEPARATOR && token.value == ","){
+            Token token = lexer(true);
+            trace.line("<id> -> , <IDs>");
+            IDS(names);
+        }
+        else{
+            trace.line("<id> -> ε");
+        }
+    }
+
+    void Identifier(vector<string>& names){
+        // <Identifier> ::= <IDENTIFIER>
+        Token token = lexer(true);
+        if(token.type == TokenType::IDENTIFIER) {
+            trace.line("<Identifier> -> Identifier");
+            names.push_back(token.value);
+        } else {
+            trace.error("Error: Invalid Identifier. Expected token type of IDENTIFIER");
+        }
+    }
+
     void id(){
         //  (ε | , <IDs>)
-        Token token = lexer();
-        currentIndex--;
+        Token token = peek();
         if(token.type == TokenType::SEPARATOR && token.value == ","){
             Token token = lexer(true);
-            outSyntaxAnalyzer << "<id> -> , <IDs>" << endl;
+            trace.line("<id> -> , <IDs>");
             IDS();
         }
         else{
-            outSyntaxAnalyzer << "<id> -> ε" << endl;
+            trace.line("<id> -> ε");
         }
     }
 
     void id(Type value){
         //  (ε | , <IDs>)
-        Token token = lexer();
-        currentIndex--;
+        Token token = peek();
         if(token.type == TokenType::SEPARATOR && token.value == ","){
             Token token = lexer(true);
-            outSyntaxAnalyzer << "<id> -> , <IDs>" << endl;
+            trace.line("<id> -> , <IDs>");
             IDS(value);
         }
         else{
-            outSyntaxAnalyzer << "<id> -> ε" << endl;
+            trace.line("<id> -> ε");
         }
     }
 
@@ -825,15 +1580,16 @@ public:
         // <Identifier> ::= <IDENTIFIER>
         Token token = lexer(true);
         if(token.type == TokenType::IDENTIFIER) {
-            outSyntaxAnalyzer << "<Identifier> -> Identifier" << endl;
-                if(!symbolAndAssembly.getAddress(token.value)){
-                    outSyntaxAnalyzer << "Error: Variable " << token.value << " not found in symbol table." << endl;
+            trace.line("<Identifier> -> Identifier");
+                int symbol = symbolAndAssembly.lookup(token.value);
+                if(symbol == Symbol_Table::NONE){
+                    trace.error_lexeme("Error: Variable % not found in symbol table.", currentIndex - 1);
                 }
                 else{
-                    symbolAndAssembly.SIN(token.value);
+                    symbolAndAssembly.SIN(symbol);
                 }
         } else {
-            outSyntaxAnalyzer << "Error: Invalid Identifier. Expected token type of IDENTIFIER";
+            trace.error("Error: Invalid Identifier. Expected token type of IDENTIFIER");
         }
     }
 
@@ -841,12 +1597,12 @@ public:
         // <Identifier> ::= <IDENTIFIER>
         Token token = lexer(true);
         if(token.type == TokenType::IDENTIFIER) {
-            outSyntaxAnalyzer << "<Identifier> -> Identifier" << endl;
+            trace.line("<Identifier> -> Identifier");
             if(valueType != Type::UNDEFINED){
                 symbolAndAssembly.generate_symbol(token.value, valueType);
             }
         } else {
-            outSyntaxAnalyzer << "Error: Invalid Identifier. Expected token type of IDENTIFIER";
+            trace.error("Error: Invalid Identifier. Expected token type of IDENTIFIER");
         }
     }
 
@@ -854,28 +1610,33 @@ public:
 
     void Statement_List(){
         //<Statement><S>
-        outSyntaxAnalyzer << "<Statement List> -> <Statement> <S>" << endl;
-        Statement();
-        S();
+        //the tail recursion through <S> is a loop, a long program does not nest
+        //a Statement() that reads nothing (e.g. at the end of the input) ends it too
+        size_t start;
+        do {
+            trace.line("<Statement List> -> <Statement> <S>");
+            start = currentIndex;
+            Statement();
+        } while (currentIndex != start && S());
     }
 
-    void S(){
+    bool S(){
         //  (ε | <Statement List>)
-        Token token = lexer();
-        currentIndex--;
-        if(token.type != TokenType::SEPARATOR && (token.value != "}" || token.value != "$$")){
-            outSyntaxAnalyzer << "<S> -> <Statement List>" << endl;
-            Statement_List();
+        Token token = peek();
+        if(token.type != TokenType::SEPARATOR && token.type != TokenType::EMPTY){
+            trace.line("<S> -> <Statement List>");
+            return true;
         }
         else{
-            outSyntaxAnalyzer << "<S> -> ε" << endl;
+            trace.line("<S> -> ε");
+            return false;
         }
     }
 
     void Statement(){
         // <Compound> | <Assign> | <If> | <Return> | <Print> | <Scan> | <While>
         Token token = lexer(true);
-        outSyntaxAnalyzer << "<Statement> -> ";
+        trace.text("<Statement> -> ");
 
         // <Compound> ::= { <Statement List> }
         // <Assign> ::= <Identifier> = <Expression> ;
@@ -885,122 +1646,122 @@ public:
         // <Scan> ::= scan ( <IDs> ) ;
         // <While> ::= while ( <Condition> ) <Statement> endwhile
         if(token.type == TokenType::SEPARATOR && token.value == "{"){
-            outSyntaxAnalyzer << "<Compound>" << endl;
-            outSyntaxAnalyzer << "<Compound> -> { <Statement List> }" << endl;
-            outSyntaxAnalyzer << "<Compound> -> { <Statement List>" << endl;
+            trace.line("<Compound>");
+            trace.line("<Compound> -> { <Statement List> }");
+            trace.line("<Compound> -> { <Statement List>");
             Statement_List();
             token = lexer(true);
             if(token.type == TokenType::SEPARATOR && token.value == "}"){
-                outSyntaxAnalyzer << "}" << endl;
-                outSyntaxAnalyzer << "End of Compound" << endl;
+                trace.line("}");
+                trace.line("End of Compound");
             }
             else{
-                outSyntaxAnalyzer << "Error in beggining '}' for <Compound>'";
+                trace.error("Error in beggining '}' for <Compound>'");
             }
 
         }
         else if(token.type == TokenType::KEYWORD && token.value == "if"){
-            outSyntaxAnalyzer << "<If>" << endl;
-            outSyntaxAnalyzer << "<If> -> if ( <Condition> ) <Statement> <if>" << endl;
-            outSyntaxAnalyzer << "<If> -> if" << endl;
+            trace.line("<If>");
+            trace.line("<If> -> if ( <Condition> ) <Statement> <if>");
+            trace.line("<If> -> if");
             token = lexer(true);
             if(token.type == TokenType::SEPARATOR && token.value == "("){
-                outSyntaxAnalyzer << "( <Condition>" << endl;
+                trace.line("( <Condition>");
                 Condition();
                 token = lexer(true);
                 if(token.type == TokenType::SEPARATOR && token.value == ")"){
-                    outSyntaxAnalyzer << ") <Statement> <if>" << endl;
+                    trace.line(") <Statement> <if>");
                     Statement();
                     _if();
                 }
                 else{
-                    outSyntaxAnalyzer << "Error in beginning ')' for <If>";
+                    trace.error("Error in beginning ')' for <If>");
                 }
             }
             else{
-                outSyntaxAnalyzer << "Error in beginning '(' for <If>";
+                trace.error("Error in beginning '(' for <If>");
             }
         }
         else if(token.type == TokenType::KEYWORD && token.value == "return"){
-            outSyntaxAnalyzer << "<Return>" << endl;
-            outSyntaxAnalyzer << "<Return> -> return <r>" << endl;
-            outSyntaxAnalyzer << "<Return> -> return" << endl;
+            trace.line("<Return>");
+            trace.line("<Return> -> return <r>");
+            trace.line("<Return> -> return");
             r();
         }
         else if(token.type == TokenType::KEYWORD && token.value == "print"){
-            outSyntaxAnalyzer << "<Print>" << endl;
-            outSyntaxAnalyzer << "<Print> -> print ( <Expression> )" << endl;
-            outSyntaxAnalyzer << "<Print> -> print" << endl;
+            trace.line("<Print>");
+            trace.line("<Print> -> print ( <Expression> )");
+            trace.line("<Print> -> print");
             token = lexer(true);
             if(token.type == TokenType::SEPARATOR && token.value == "("){
-                outSyntaxAnalyzer << "( <Expression>" << endl;
+                trace.line("( <Expression>");
                 Expression();
                 symbolAndAssembly.SOUT();
                 token = lexer(true);
                 if(token.type == TokenType::SEPARATOR && token.value == ")"){
-                    outSyntaxAnalyzer << ")" << endl;
+                    trace.line(")");
                     token = lexer(true);
                     if(token.type == TokenType::SEPARATOR && token.value == ";"){
-                        outSyntaxAnalyzer << ";" << endl;
-                        outSyntaxAnalyzer << "End of Print" << endl;
+                        trace.line(";");
+                        trace.line("End of Print");
                     }
                     else{
-                        outSyntaxAnalyzer << "Error in ';' for <Print>";
+                        trace.error("Error in ';' for <Print>");
                     }
                 }
                 else{
-                    outSyntaxAnalyzer << "Error in beginning ')' for <Print>";
+                    trace.error("Error in beginning ')' for <Print>");
                 }
             }
             else{
-                outSyntaxAnalyzer << "Error in beginning '(' for <Print>";
+                trace.error("Error in beginning '(' for <Print>");
             }
         }
         else if(token.type == TokenType::KEYWORD && token.value == "scan"){
-            outSyntaxAnalyzer << "<Scan>" << endl;
-            outSyntaxAnalyzer << "<Scan> -> scan ( <IDs> );" << endl;
-            outSyntaxAnalyzer << "<Scan> -> scan" << endl;
+            trace.line("<Scan>");
+            trace.line("<Scan> -> scan ( <IDs> );");
+            trace.line("<Scan> -> scan");
             token = lexer(true);
 
             if(token.type == TokenType::SEPARATOR && token.value == "("){
-                outSyntaxAnalyzer << "( <IDs>" << endl;
+                trace.line("( <IDs>");
                 IDS();
                 token = lexer(true);
 
                 if(token.type == TokenType::SEPARATOR && token.value == ")"){
                     
-                    outSyntaxAnalyzer << ")" << endl;
+                    trace.line(")");
                     token = lexer(true);
                     if(token.type == TokenType::SEPARATOR && token.value == ";"){
-                        outSyntaxAnalyzer << ";" << endl;
-                        outSyntaxAnalyzer << "End of Scan" << endl;
+                        trace.line(";");
+                        trace.line("End of Scan");
                     }
                     else{
-                        outSyntaxAnalyzer << "Error in ';' for <Scan>";
+                        trace.error("Error in ';' for <Scan>");
                     }
                 }
                 else{
-                    outSyntaxAnalyzer << "Error in beginning ')' for <Scan>";
+                    trace.error("Error in beginning ')' for <Scan>");
                 }
             }
             else{
-                outSyntaxAnalyzer << "Error in beginning '(' for <Scan>";
+                trace.error("Error in beginning '(' for <Scan>");
             }
         }
     
         else if(token.type == TokenType::KEYWORD && token.value == "while"){
-            outSyntaxAnalyzer << "<While>" << endl;
-            outSyntaxAnalyzer << "<While> -> while ( <Condition> ) <Statement> endwhile" << endl;
-            outSyntaxAnalyzer << "<While> -> while" << endl;
+            trace.line("<While>");
+            trace.line("<While> -> while ( <Condition> ) <Statement> endwhile");
+            trace.line("<While> -> while");
             int instruction_Addr = symbolAndAssembly.getInstructionAddr();
             symbolAndAssembly.LABEL();
             token = lexer(true);
             if(token.type == TokenType::SEPARATOR && token.value == "("){
-                outSyntaxAnalyzer << "( <Condition>" << endl;
+                trace.line("( <Condition>");
                 Condition();
                 token = lexer(true);
                 if(token.type == TokenType::SEPARATOR && token.value == ")"){
-                    outSyntaxAnalyzer << ") <Statement>" << endl;
+                    trace.line(") <Statement>");
                     Statement();
                     token = lexer(true);
 
@@ -1009,46 +1770,45 @@ public:
                     symbolAndAssembly.LABEL();
                     
                     if(token.type == TokenType::KEYWORD && token.value == "endwhile"){
-                    outSyntaxAnalyzer << "endwhile" << endl;
+                    trace.line("endwhile");
                     }
                     else{
-                    outSyntaxAnalyzer << "Error in 'endwhile' for <While>";
+                    trace.error("Error in 'endwhile' for <While>");
                     }
                 }
                 else{
-                    outSyntaxAnalyzer << "Error in beginning ')' for <While>";
+                    trace.error("Error in beginning ')' for <While>");
                 }
             }
             else{
-                outSyntaxAnalyzer << "Error in beginning '(' for <While>";
+                trace.error("Error in beginning '(' for <While>");
             }
         }
         else if(token.type == TokenType::IDENTIFIER){
-            outSyntaxAnalyzer << "<Assign>" << endl;
-            outSyntaxAnalyzer << "<Assign> -> <Identifier> = <Expression> ;" << endl;
-            outSyntaxAnalyzer << "<Assign> -> <Identifier>" << endl;
+            trace.line("<Assign>");
+            trace.line("<Assign> -> <Identifier> = <Expression> ;");
+            trace.line("<Assign> -> <Identifier>");
             string var = token.value; // Save the variable
             Token token = lexer(true);
                 if(token.type == TokenType::OPERATOR && token.value == "="){
-                    outSyntaxAnalyzer << "= <Expression> ;" << endl;
+                    trace.line("= <Expression> ;");
                     Expression();
                     token = lexer(true);
-                    int memoryLoc = symbolAndAssembly.getAddress(var);
-                    symbolAndAssembly.POPM(memoryLoc, var);
+                    symbolAndAssembly.pop_variable(symbolAndAssembly.resolve(var));
                     if(token.type == TokenType::SEPARATOR && token.value == ";"){
-                        outSyntaxAnalyzer << ";" << endl;
-                        outSyntaxAnalyzer << "End of Assign" << endl;
+                        trace.line(";");
+                        trace.line("End of Assign");
                     }
                     else{
-                        outSyntaxAnalyzer << "Error in ';' for <Assign>";
+                        trace.error("Error in ';' for <Assign>");
                     }
                 }
                 else{
-                    outSyntaxAnalyzer << "Error in '=' for <Assign>";
+                    trace.error("Error in '=' for <Assign>");
                 }
         }
         else{
-            outSyntaxAnalyzer << "Error: Invalid Statement. Expected statement type of <Compound>, <Assign>, <If>, <Return>, <Print>, <Scan>, or <While>";
+            trace.error("Error: Invalid Statement. Expected statement type of <Compound>, <Assign>, <If>, <Return>, <Print>, <Scan>, or <While>");
         }
 
     }
@@ -1059,234 +1819,289 @@ public:
         if(token.type == TokenType::KEYWORD && token.value == "endif"){
             symbolAndAssembly.back_patch(symbolAndAssembly.getInstructionAddr());
             symbolAndAssembly.LABEL();
-            outSyntaxAnalyzer << "<if> -> endif" << endl;
+            trace.line("<if> -> endif");
         }
         else if(token.type == TokenType::KEYWORD && token.value == "else"){
-            outSyntaxAnalyzer << "<if> -> else <Statement> endif" << endl;
+            trace.line("<if> -> else <Statement> endif");
             Statement();
             token = lexer(true);
             if(token.type == TokenType::KEYWORD && token.value == "endif"){
                 symbolAndAssembly.back_patch(symbolAndAssembly.getInstructionAddr());
                 symbolAndAssembly.LABEL();
-                outSyntaxAnalyzer << "endif" << endl;
-                outSyntaxAnalyzer << "End of <If>" << endl;
+                trace.line("endif");
+                trace.line("End of <If>");
             }
             else{
-                outSyntaxAnalyzer << "Error in 'endif' for <if>";
+                trace.error("Error in 'endif' for <if>");
             }
         }
         else{
-            outSyntaxAnalyzer << "Error, expected 'endif' or 'else' for <if>";
+            trace.error("Error, expected 'endif' or 'else' for <if>");
         }
 
     }
 
+    //the main code has no caller to return to, a return there is an error
     void r(){
         //  (; | <Expression> ;)
-        Token token = lexer();
-        currentIndex--;
+        if(!symbolAndAssembly.in_function()){
+            throw runtime_error("Return outside a function");
+        }
+        Token token = peek();
         if(token.type == TokenType::SEPARATOR && token.value == ";"){
             token = lexer(true);
-            outSyntaxAnalyzer << "<r> -> ;" << endl;
+            trace.line("<r> -> ;");
+            symbolAndAssembly.PUSHI(Type(Type::INTEGER), 0);
+            symbolAndAssembly.RET();
         }
         else{
-            outSyntaxAnalyzer << "<r> -> <Expression> ;" << endl;
+            trace.line("<r> -> <Expression> ;");
             Expression();
+            symbolAndAssembly.RET();
             token = lexer(true);
             if(token.type == TokenType::SEPARATOR && token.value == ";"){
-                outSyntaxAnalyzer << ";" << endl;
-                outSyntaxAnalyzer << "End of <Return>" << endl;
+                trace.line(";");
+                trace.line("End of <Return>");
             }
             else{
-                outSyntaxAnalyzer << "Error in ';' for <Return>";
+                trace.error("Error in ';' for <Return>");
             }
             
         }
 
     }
 
+    //leaves the branches taken when the condition is false for back_patch
     void Condition(){
-        //<Expression> <Relop> <Expression>
-        outSyntaxAnalyzer << "<Condition> -> <Expression> <Relop> <Expression>" << endl;
-        Expression();
-        Relop();
+        //<Disjunction>
+        trace.line("<Condition> -> <Disjunction>");
+        Disjunction();
+        symbolAndAssembly.end_condition();
+    }
+
+    void Disjunction(){
+        //<Conjunction> { or <Conjunction> }
+        trace.line("<Disjunction> -> <Conjunction> { or <Conjunction> }");
+        Conjunction();
+        while (next_is(TokenType::KEYWORD, "or")) {
+            lexer(true);
+            trace.line("or <Conjunction>");
+            symbolAndAssembly.begin_or();
+            Conjunction();
+            symbolAndAssembly.end_or();
+        }
+    }
+
+    void Conjunction(){
+        //<Negation> { and <Negation> }
+        trace.line("<Conjunction> -> <Negation> { and <Negation> }");
+        Negation();
+        while (next_is(TokenType::KEYWORD, "and")) {
+            lexer(true);
+            trace.line("and <Negation>");
+            symbolAndAssembly.begin_and();
+            Negation();
+            symbolAndAssembly.end_and();
+        }
+    }
+
+    void Negation(){
+        //not <Negation> | ( <Disjunction> ) | <Expression> <Relop> <Expression>
+        if (next_is(TokenType::KEYWORD, "not")) {
+            lexer(true);
+            trace.line("<Negation> -> not <Negation>");
+            Negation();
+            symbolAndAssembly.negate();
+        }
+        else if (next_is(TokenType::SEPARATOR, "(") && condition_group()) {
+            lexer(true);
+            trace.line("<Negation> -> ( <Disjunction> )");
+            Disjunction();
+            Token token = lexer(true);
+            if(token.type != TokenType::SEPARATOR || token.value != ")"){
+                trace.error("Error in Negation. Expected token type of ) for ( <Disjunction> )");
+            }
+        }
+        else {
+            trace.line("<Negation> -> <Expression> <Relop> <Expression>");
+            Expression();
+            Relop();
+        }
+    }
+
+    //the next token, without consuming it
+    bool next_is(TokenType type, const char* value){
+        size_t at = currentIndex;
+        Token token = lexer();
+        currentIndex = at;
+        return token.type == type && token.value == value;
+    }
+
+    //the ( ahead opens a condition rather than an expression: a relational
+    //operator, and, or or not appears inside it before its )
+    bool condition_group(){
+        size_t start = currentIndex;
+        int depth = 0;
+        bool found = false;
+        do {
+            Token token = lexer();
+            if (token.type == TokenType::EMPTY) {
+                break;
+            }
+            if (token.type == TokenType::SEPARATOR && (token.value == "(" || token.value == ")")) {
+                depth += token.value == "(" ? 1 : -1;
+            }
+            else if (depth == 1 && ((token.type == TokenType::OPERATOR && is_relop(token.value)) ||
+                                    (token.type == TokenType::KEYWORD && is_condition_keyword(token.value)))) {
+                found = true;
+            }
+        } while (depth > 0 && !found);
+        currentIndex = start;
+        return found;
     }
 
     void Relop(){
         // == | != | > | < | <= | =>
         Token token = lexer(true);
-        if(token.type == TokenType::OPERATOR && 
-            (token.value == "==" || token.value == "!=" || token.value == ">" || token.value == "<" || token.value == "<=" || token.value == "=>")){
-            outSyntaxAnalyzer << "<Relop> -> == | != | > | < | <= | =>" << endl;
+        if(token.type == TokenType::OPERATOR && is_relop(token.value)){
+            trace.line("<Relop> -> == | != | > | < | <= | =>");
             
             Expression();
-            if(token.value == ">"){
-                symbolAndAssembly.GRT();
-                symbolAndAssembly.push_JMPstack(symbolAndAssembly.getInstructionAddr() - 1);
-                symbolAndAssembly.JMP0();
-            }
-            else if(token.value == "<"){
-                symbolAndAssembly.LES();
-                symbolAndAssembly.push_JMPstack(symbolAndAssembly.getInstructionAddr() - 1);
-                symbolAndAssembly.JMP0();
-            }
-            else if(token.value == "=="){
-                symbolAndAssembly.EQU();
-                symbolAndAssembly.push_JMPstack(symbolAndAssembly.getInstructionAddr() - 1);
-                symbolAndAssembly.JMP0();
-            }
-            else if(token.value == "!="){
-                symbolAndAssembly.NEQ();
-                symbolAndAssembly.push_JMPstack(symbolAndAssembly.getInstructionAddr() - 1);
-                symbolAndAssembly.JMP0();
-            }
-            else if(token.value == "=>"){
-                symbolAndAssembly.GEQ();
-                symbolAndAssembly.push_JMPstack(symbolAndAssembly.getInstructionAddr() - 1);
-                symbolAndAssembly.JMP0();
-            }
-            else if(token.value == "<="){
-                symbolAndAssembly.LEQ();
-                symbolAndAssembly.push_JMPstack(symbolAndAssembly.getInstructionAddr() - 1);
-                symbolAndAssembly.JMP0();
-            }
+            symbolAndAssembly.binary_operator(*operator_opcode(RELOPS, token.value));
+            symbolAndAssembly.comparison_branch();
         }
         else{
-            outSyntaxAnalyzer << "Error in Relop. Expected token type of OPERATOR with value ==, !=, >, <, <=, or =>";
+            trace.error("Error in Relop. Expected token type of OPERATOR with value ==, !=, >, <, <=, or =>");
+            symbolAndAssembly.missing_comparison();
         }
     }
 
     void Expression(){
         //<Term> <E>
-        outSyntaxAnalyzer << "<Expression> -> <Term> <E>" << endl;
+        trace.line("<Expression> -> <Term> <E>");
         Term();
         E();
     }
 
     void E() {
         //  + <Term> <E> | - <Term><E> | ɛ
-        Token token = lexer();
-        string operator_addition_subtraction = token.value;
-        currentIndex--;
-        if(token.type == TokenType::OPERATOR &&
-            (token.value == "+" || token.value == "-")){
+        Token token = peek();
+        optional<Opcode> op = operator_opcode(ADDING_OPERATORS, token.value);
+        if(token.type == TokenType::OPERATOR && op){
             token = lexer(true);
-            outSyntaxAnalyzer << "<E> -> + <Term> <E> | - <Term><E>" << endl;
+            trace.line("<E> -> + <Term> <E> | - <Term><E>");
             Term();
-            if(operator_addition_subtraction == "+"){
-                symbolAndAssembly.A();
-            }
-            else if(operator_addition_subtraction == "-"){
-                symbolAndAssembly.S();
-            }
+            symbolAndAssembly.binary_operator(*op);
             E();
         }
         else{
-            outSyntaxAnalyzer << "<E> -> ε" << endl;
+            trace.line("<E> -> ε");
         }
 
     }
 
     void T(){
         // * <Factor> <T> | / <Factor> <T> | ɛ
-        Token token = lexer();
-        string var = token.value; //get a copy of the "*" or "/"
-        currentIndex--;
-        if(token.type == TokenType::OPERATOR &&
-            (token.value == "*" || token.value == "/")){
+        Token token = peek();
+        optional<Opcode> op = operator_opcode(MULTIPLYING_OPERATORS, token.value); //the "*" or "/"
+        if(token.type == TokenType::OPERATOR && op){
             token = lexer(true);
-            outSyntaxAnalyzer << "<T> -> * <Factor> <T> | / <Factor> <T>" << endl;
+            trace.line("<T> -> * <Factor> <T> | / <Factor> <T>");
             Factor();
-
-            if(var == "*"){
-                symbolAndAssembly.M();
-            }
-            else if(var == "/"){
-                symbolAndAssembly.D();
-            }
-
+            symbolAndAssembly.binary_operator(*op);
             T();
         } 
         else{
-            outSyntaxAnalyzer << "<T> -> ε" << endl;
+            trace.line("<T> -> ε");
         }
     }
 
     void Term(){
         // <Factor> <T>
-        outSyntaxAnalyzer << "<Term> -> <Factor> <T>" << endl;
+        trace.line("<Term> -> <Factor> <T>");
         Factor();
         T();
     }
     
     void Factor() {
         // - <Primary> | <Primary>
-        Token token = lexer();
-        currentIndex--;
+        Token token = peek();
         if(token.type == TokenType::OPERATOR && token.value == "-"){
             token = lexer(true);
-            outSyntaxAnalyzer << "<Factor> -> - <Primary>" << endl;
-            Primary();
+            trace.line("<Factor> -> - <Primary>");
+            Primary(true);
         } else {
-            outSyntaxAnalyzer << "<Factor> -> <Primary>" << endl;
+            trace.line("<Factor> -> <Primary>");
             Primary();
         }
     }
 
     
-    void Primary() {
+    //negative is set for - <Primary>: a literal carries the sign, any other
+    //primary is negated after it (see Symbol_and_Assembly::negate_value)
+    void Primary(bool negative = false) {
         // <Primary> ::= <Identifier> | <Integer> | <Identifier> ( <IDs> ) | ( <Expression> ) |
         //<Real> | true | false
          Token token = lexer(true);
          if(token.type == TokenType::IDENTIFIER){
             Token oldToken = token;
-             token = lexer();
-             currentIndex--;
+             token = peek();
              if (token.type == TokenType::SEPARATOR && token.value == "("){
                  token = lexer(true);
-                 outSyntaxAnalyzer << "<Identifier> ( <IDs> ) ->"; 
-                 outSyntaxAnalyzer << " <Identifier> (" << endl;
-                 IDS();
+                 trace.text("<Identifier> ( <IDs> ) ->");
+                 trace.line(" <Identifier> (");
+                 vector<string> arguments;
+                 IDS(arguments);
+                 for (const string& argument : arguments) {
+                     symbolAndAssembly.push_variable(symbolAndAssembly.resolve(argument));
+                 }
+                 symbolAndAssembly.CALL(oldToken.value, arguments.size());
  
                  token = lexer(true);
                  if(token.type == TokenType::SEPARATOR && token.value == ")"){
-                     outSyntaxAnalyzer << "<Identifier> ( <IDs> )" << endl;
+                     trace.line("<Identifier> ( <IDs> )");
                  }
                  else{
-                     outSyntaxAnalyzer << "Error in Primary. Expected token type of ) for <Identifier> ( <IDs> )" << endl;
+                     trace.error("Error in Primary. Expected token type of ) for <Identifier> ( <IDs> )", true);
                  }
              }
             else{
-                symbolAndAssembly.PUSHM(oldToken.value, symbolAndAssembly.getAddress(oldToken.value));
-                outSyntaxAnalyzer << "<Primary> -> <Identifier> | <Integer> | <Identifier> | true, false" << endl;
+                symbolAndAssembly.push_variable(symbolAndAssembly.resolve(oldToken.value));
+                trace.line("<Primary> -> <Identifier> | <Integer> | <Identifier> | true, false");
+            }
+            if (negative) {
+                symbolAndAssembly.negate_value();
             }
          }
          else if (token.type == TokenType::INTEGER) {
-            //ADD IN PUSHM for the identifier, PUSHI for the random Integers, CHANGE
-            symbolAndAssembly.PUSHI(Type(Type::INTEGER));
-            outSyntaxAnalyzer << "<Primary> -> <Identifier> | <Integer> | <Real> | true, false" << endl;
+            symbolAndAssembly.PUSHI(Type(Type::INTEGER), integer_literal(token.value, negative));
+            trace.line("<Primary> -> <Identifier> | <Integer> | <Real> | true, false");
         } 
         else if(token.type == TokenType::REAL){
-            outSyntaxAnalyzer << "<Primary> -> <Identifier> | <Integer> | <Real> | true, false" << endl;
+            symbolAndAssembly.PUSHF(real_literal(token.value, negative));
+            trace.line("<Primary> -> <Identifier> | <Integer> | <Real> | true, false");
         }
         else if(token.type == TokenType::KEYWORD && (token.value == "true" || token.value == "false")){
-            symbolAndAssembly.PUSHB(Type(Type::INTEGER));
-            outSyntaxAnalyzer << "<Primary> -> <Identifier> | <Integer> | <Real> | true, false" << endl;
+            symbolAndAssembly.PUSHB(Type(Type::BOOLEAN), token.value == "true");
+            trace.line("<Primary> -> <Identifier> | <Integer> | <Real> | true, false");
         }
         else if (token.type == TokenType::SEPARATOR && token.value == "("){
-             outSyntaxAnalyzer << "( <Expression> )" << endl;
-             outSyntaxAnalyzer << "( <Expression> ) -> (" << endl;
+             trace.line("( <Expression> )");
+             trace.line("( <Expression> ) -> (");
              Expression();
              token = lexer(true);
              if(token.type == TokenType::SEPARATOR && token.value == ")"){
-                 outSyntaxAnalyzer << "( <Expression> )" << endl;
+                 trace.line("( <Expression> )");
              }
              else{
-                 outSyntaxAnalyzer << "Error in Primary. Expected token type of ) for <Identifier> ( <IDs> )";
+                 trace.error("Error in Primary. Expected token type of ) for <Identifier> ( <IDs> )");
+             }
+             if (negative) {
+                 symbolAndAssembly.negate_value();
              }
          }
          else{
-             outSyntaxAnalyzer << "Error in Primary. <Identifier> | <Integer> | <Identifier> ( <IDs> ) | ( <Expression> ) | <Real> | true | false";
+             trace.error("Error in Primary. <Identifier> | <Integer> | <Identifier> ( <IDs> ) | ( <Expression> ) | <Real> | true | false");
          }
      }
 
@@ -0,0 +1,224 @@
+#ifndef RETURN_TYPES_H
+#define RETURN_TYPES_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "TokenType.h"
+#include "Type.h"
+#include "Instruction.h"
+#include "Grammar.h"
+using namespace std;
+
+//the return type of each function, read from the tokens of the function
+//definitions before any of their code is generated, so a call to a function
+//defined later pushes the type it returns
+//the first return decides a function's type (see Symbol_and_Assembly::RET);
+//while that one calls functions whose types are not known yet the next return
+//decides, and the types go around again until none changes
+//a function without a return is INTEGER (its body ends in PUSHI 0, RET), one
+//whose returns never get a type stays UNDEFINED and its RET throws
+//the code generation checks every return against the type found here
+//used by SyntaxAnalyzer and Constexpr_Compiler
+struct Return_Type {
+    string name;
+    Type type;
+};
+
+//Tokens is a vector of Token
+template <typename Tokens>
+class Return_Types {
+    struct Function {
+        vector<pair<string, Type>> variables; //parameters and locals
+        vector<size_t> returns;               //token after each return
+    };
+
+    const Tokens& tokens;
+    size_t end; //the $$ after the function definitions
+    Type external; //of a function defined in another object file
+    vector<Function> functions;
+    vector<Return_Type> types;
+
+    constexpr Return_Types(const Tokens& tokens, size_t begin, Type external)
+        : tokens(tokens), end(section_end(tokens, begin)), external(external) {
+        read(begin);
+    }
+
+    constexpr bool is(size_t i, TokenType type, string_view value) const {
+        return i < end && tokens[i].type == type && tokens[i].value == value;
+    }
+
+    //function <Identifier> ( <Opt Parameter List> ) <Opt Declaration List> <Body>
+    //a syntax error is left for the parser, only the types get lost
+    constexpr void read(size_t i) {
+        while (i < end) {
+            if (!is(i, TokenType::KEYWORD, "function")) {
+                i++;
+                continue;
+            }
+            Function function;
+            types.push_back({tokens[i + 1 < end ? i + 1 : i].value, Type::UNDEFINED});
+            i += 2;
+            //<Parameter> ::= <IDs> <Qualifier>, separated by ','
+            size_t named = 0;
+            for (; i < end && !is(i, TokenType::SEPARATOR, ")"); i++) {
+                if (tokens[i].type == TokenType::IDENTIFIER) {
+                    function.variables.push_back({tokens[i].value, Type::UNDEFINED});
+                }
+                else if (tokens[i].type == TokenType::KEYWORD) {
+                    for (; named < function.variables.size(); named++) {
+                        function.variables[named].second = qualifier_type(tokens[i].value);
+                    }
+                }
+            }
+            //<Declaration> ::= <Qualifier> <IDs>, ending in ';'
+            Type type = Type::UNDEFINED;
+            for (; i < end && !is(i, TokenType::SEPARATOR, "{"); i++) {
+                if (tokens[i].type == TokenType::KEYWORD) {
+                    type = qualifier_type(tokens[i].value);
+                }
+                else if (tokens[i].type == TokenType::IDENTIFIER) {
+                    function.variables.push_back({tokens[i].value, type});
+                }
+            }
+            //the body up to its matching }
+            int depth = 0;
+            for (; i < end; i++) {
+                if (is(i, TokenType::SEPARATOR, "{")) {
+                    depth++;
+                }
+                else if (is(i, TokenType::SEPARATOR, "}") && --depth == 0) {
+                    i++;
+                    break;
+                }
+                else if (is(i, TokenType::KEYWORD, "return")) {
+                    function.returns.push_back(i + 1);
+                }
+            }
+            functions.push_back(std::move(function));
+        }
+    }
+
+    constexpr Type function_type(const string& name) const {
+        for (const Return_Type& function : types) {
+            if (function.name == name) {
+                return function.type;
+            }
+        }
+        return external;
+    }
+
+    constexpr Type variable_type(const Function& function, const string& name) const {
+        for (size_t v = function.variables.size(); v-- > 0;) {
+            if (function.variables[v].first == name) {
+                return function.variables[v].second;
+            }
+        }
+        return Type::UNDEFINED;
+    }
+
+    //the type of the <Expression> at i, which moves past it; UNDEFINED when it
+    //calls a function whose type is not known yet or does not type check
+    constexpr Type expression(const Function& function, size_t& i) const {
+        Type type = term(function, i);
+        while (i < end && tokens[i].type == TokenType::OPERATOR &&
+               operator_opcode(ADDING_OPERATORS, tokens[i].value)) {
+            Opcode op = *operator_opcode(ADDING_OPERATORS, tokens[i++].value);
+            type = result_type(opcode_info(op).rule, term(function, i), type);
+        }
+        return type;
+    }
+
+    constexpr Type term(const Function& function, size_t& i) const {
+        Type type = factor(function, i);
+        while (i < end && tokens[i].type == TokenType::OPERATOR &&
+               operator_opcode(MULTIPLYING_OPERATORS, tokens[i].value)) {
+            Opcode op = *operator_opcode(MULTIPLYING_OPERATORS, tokens[i++].value);
+            type = result_type(opcode_info(op).rule, factor(function, i), type);
+        }
+        return type;
+    }
+
+    constexpr Type factor(const Function& function, size_t& i) const {
+        if (is(i, TokenType::OPERATOR, "-")) {
+            i++;
+        }
+        if (i >= end) {
+            return Type::UNDEFINED;
+        }
+        const auto& token = tokens[i++];
+        if (token.type == TokenType::IDENTIFIER) {
+            if (!is(i, TokenType::SEPARATOR, "(")) {
+                return variable_type(function, token.value);
+            }
+            while (i < end && !is(i, TokenType::SEPARATOR, ")")) {
+                i++;
+            }
+            i++;
+            return function_type(token.value);
+        }
+        if (token.type == TokenType::INTEGER) {
+            return Type::INTEGER;
+        }
+        if (token.type == TokenType::REAL) {
+            return Type::REAL;
+        }
+        if (token.type == TokenType::KEYWORD && (token.value == "true" || token.value == "false")) {
+            return Type::BOOLEAN;
+        }
+        if (token.type == TokenType::SEPARATOR && token.value == "(") {
+            Type type = expression(function, i);
+            i++;
+            return type;
+        }
+        return Type::UNDEFINED;
+    }
+
+    //gives every function the type of its first return that has one, true
+    //when some type changed
+    constexpr bool settle() {
+        bool changed = false;
+        for (size_t f = 0; f < functions.size(); f++) {
+            Type type = functions[f].returns.empty() ? Type::INTEGER : Type::UNDEFINED;
+            for (size_t i : functions[f].returns) {
+                //return ; returns 0
+                type = is(i, TokenType::SEPARATOR, ";") ? Type::INTEGER : expression(functions[f], i);
+                if (type != Type::UNDEFINED) {
+                    break;
+                }
+            }
+            if (type != types[f].type) {
+                types[f].type = type;
+                changed = true;
+            }
+        }
+        return changed;
+    }
+
+public:
+    //index of the $$ that ends the function definitions starting at begin,
+    //tokens.size() while it is not there
+    static constexpr size_t section_end(const Tokens& tokens, size_t begin) {
+        for (size_t i = begin; i < tokens.size(); i++) {
+            if (tokens[i].type == TokenType::SEPARATOR && tokens[i].value == "$$") {
+                return i;
+            }
+        }
+        return tokens.size();
+    }
+
+    //the functions defined from begin up to the next $$, in order
+    //in a program that type checks a function's type, once known, does not
+    //change, so each round settles at least one more function
+    //a call to a name no definition has returns external
+    static constexpr vector<Return_Type> infer(const Tokens& tokens, size_t begin, Type external = Type::UNDEFINED) {
+        Return_Types inference(tokens, begin, external);
+        for (size_t round = 0; round <= inference.functions.size() && inference.settle(); round++) {
+        }
+        return inference.types;
+    }
+};
+
+#endif
@@ -0,0 +1,483 @@
+#ifndef STACK_VERIFIER_H
+#define STACK_VERIFIER_H
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <memory_resource>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Instruction.h"
+using namespace std;
+
+//operand stack depth before every instruction, the same on every path to it
+//depths count from where the code of an entry starts: 0 for the program and
+//for a function the position below its arguments, which its first
+//instructions pop (so they go negative)
+//a function's arity is not stored anywhere, it follows from its code: RET
+//must leave only the returned value, so 1 - (depth at a RET) arguments were
+//passed, and a CALL to it pops that many
+//a CALL to a function whose arity is not known yet waits until a RET of that
+//function has been reached (the path to the base case of a recursion)
+//rejects (runtime_error) a program where two paths meet with different
+//depths, an instruction pops more than its code pushed or was passed, or a
+//jump leaves its function
+//max_depth() bounds the whole stack over every chain of calls, so an
+//executor can allocate it once and skip per-instruction checks; it is
+//UNBOUNDED when functions can call themselves, then each CALL needs room for
+//frame_depth() of its callee
+//a CALL to another object file (see external_call) pops the arguments given
+//for it and pushes the result, what the callee needs on top is checked once
+//the program is linked
+class Stack_Verifier {
+public:
+    static constexpr int UNKNOWN = INT_MIN;
+    static constexpr long UNBOUNDED = -1;
+
+private:
+    const pmr::vector<Instruction>& code;
+    vector<int> depths;  //before each instruction, UNKNOWN when no path reaches it
+    vector<int> owners;  //entry index of the code each instruction belongs to
+    vector<int> entryList;             //addresses, the program's first
+    unordered_map<int, int> entryOf;   //address -> entry index
+    vector<int> arities;               //per entry, -1 until a RET is reached
+    vector<int> frames;                //per entry, deepest point counted from below the arguments
+    vector<int> externals;             //arguments of each function of another object file
+    long maxDepth = 0;
+
+public:
+    //entries are instruction addresses, the program's first (address 1) and
+    //then every function's
+    Stack_Verifier(const pmr::vector<Instruction>& code, const vector<int>& entries, vector<int> externals = {})
+        : code(code), depths(code.size(), UNKNOWN), owners(code.size(), -1), entryList(entries),
+          arities(entries.size(), -1), frames(entries.size(), 0), externals(std::move(externals)) {
+        for (size_t e = 0; e < entryList.size(); e++) {
+            entryOf.emplace(entryList[e], e);
+        }
+        if (!entryList.empty()) {
+            arities[0] = 0;
+        }
+        propagate();
+        check_underflow();
+        bound();
+    }
+
+    int depth(size_t index) const {
+        return depths[index];
+    }
+
+    //arguments the function at address takes, -1 when it never returns
+    int arity(int address) const {
+        auto it = entryOf.find(address);
+        return it == entryOf.end() ? -1 : arities[it->second];
+    }
+
+    //stack entries the function at address uses while it runs, its arguments
+    //included and its callees not
+    int frame_depth(int address) const {
+        auto it = entryOf.find(address);
+        return it == entryOf.end() ? 0 : frames[it->second];
+    }
+
+    //entries the whole program can need, UNBOUNDED with recursion
+    long max_depth() const {
+        return maxDepth;
+    }
+
+private:
+    [[noreturn]] static void reject(const string& message, size_t index) {
+        throw runtime_error(message + " at instruction " + to_string(index + 1));
+    }
+
+    //the entry index of the function a CALL goes to
+    int callee(size_t index) const {
+        auto it = entryOf.find(code[index].Operand);
+        if (it == entryOf.end() || it->second == 0) {
+            reject("CALL to an address that is not a function", index);
+        }
+        return it->second;
+    }
+
+    //arguments a CALL pops, -1 while its callee has not returned yet
+    int arguments(size_t index) const {
+        if (!is_external_call(code[index])) {
+            return arities[callee(index)];
+        }
+        if (code[index].Operand < 0 || size_t(code[index].Operand) >= externals.size()) {
+            reject("CALL without a function", index);
+        }
+        return externals[code[index].Operand];
+    }
+
+    void propagate() {
+        vector<size_t> work;
+        unordered_map<int, vector<size_t>> waiting; //callee entry index -> CALLs
+        auto reach = [&](size_t from, long to, int depth) {
+            int owner = owners[from];
+            if (to == long(code.size()) && owner == 0) {
+                return; //the program ends
+            }
+            if (to < 0 || to >= long(code.size())) {
+                reject("Jump out of the code", from);
+            }
+            if (owners[to] >= 0 && owners[to] != owner) {
+                reject("Jump into another function", from);
+            }
+            if (depths[to] == UNKNOWN) {
+                depths[to] = depth;
+                owners[to] = owner;
+                work.push_back(to);
+            }
+            else if (depths[to] != depth) {
+                reject("Stack depth " + to_string(depth) + " where another path has " + to_string(depths[to]), to);
+            }
+        };
+
+        for (size_t e = 0; e < entryList.size(); e++) {
+            size_t index = entryList[e] - 1;
+            if (index >= code.size()) {
+                continue;
+            }
+            if (owners[index] >= 0) {
+                reject("Entry inside other code", index);
+            }
+            depths[index] = 0;
+            owners[index] = e;
+            work.push_back(index);
+        }
+
+        while (!work.empty()) {
+            size_t i = work.back();
+            work.pop_back();
+            const Instruction& instr = code[i];
+            const Opcode_Info& info = instr.info();
+            int depth = depths[i];
+            switch (instr.Operator) {
+                case Opcode::JMP:
+                    reach(i, long(instr.Operand) - 1, depth);
+                    break;
+                case Opcode::JMP0:
+                case Opcode::JMP1:
+                    reach(i, i + 1, depth - 1);
+                    reach(i, long(instr.Operand) - 1, depth - 1);
+                    break;
+                case Opcode::RET: {
+                    int owner = owners[i];
+                    if (owner == 0) {
+                        reject("RET outside a function", i);
+                    }
+                    int arity = 1 - depth;
+                    if (arity < 0) {
+                        reject("RET leaves " + to_string(depth - 1) + " values on the stack", i);
+                    }
+                    if (arities[owner] >= 0 && arities[owner] != arity) {
+                        reject("RET with a different stack depth than the function's other returns", i);
+                    }
+                    if (arities[owner] < 0) {
+                        arities[owner] = arity;
+                        for (size_t call : waiting[owner]) {
+                            reach(call, call + 1, depths[call] - arity + 1);
+                        }
+                        waiting.erase(owner);
+                    }
+                    break;
+                }
+                case Opcode::CALL: {
+                    if (arguments(i) < 0) {
+                        waiting[callee(i)].push_back(i);
+                    }
+                    else {
+                        reach(i, i + 1, depth - arguments(i) + 1);
+                    }
+                    break;
+                }
+                default:
+                    reach(i, i + 1, depth - info.pops + info.pushes);
+                    break;
+            }
+        }
+    }
+
+    //no instruction pops below what its entry starts with
+    void check_underflow() {
+        for (size_t i = 0; i < code.size(); i++) {
+            if (depths[i] == UNKNOWN) {
+                continue;
+            }
+            int owner = owners[i];
+            int pops = code[i].Operator == Opcode::CALL ? max(arguments(i), 0) : code[i].info().pops;
+            int pushes = code[i].info().pushes;
+            //a function that never returns is not known to have arguments
+            int floor = arities[owner] >= 0 ? -arities[owner] : INT_MIN / 2;
+            if (depths[i] - pops < floor) {
+                reject("Stack underflow", i);
+            }
+            int base = arities[owner] >= 0 ? arities[owner] : 0;
+            frames[owner] = max({frames[owner], depths[i] + base, depths[i] - pops + pushes + base});
+        }
+    }
+
+    //deepest stack over every chain of calls from the program's entry
+    void bound() {
+        if (entryList.empty()) {
+            return;
+        }
+        //per entry, deepest point of a call made from it (its own frame
+        //counted from below its arguments)
+        vector<vector<pair<int, int>>> calls(entryList.size()); //{depth below the callee's arguments, callee}
+        for (size_t i = 0; i < code.size(); i++) {
+            if (depths[i] != UNKNOWN && code[i].Operator == Opcode::CALL && !is_external_call(code[i])) {
+                int owner = owners[i];
+                int function = callee(i);
+                int base = arities[owner] >= 0 ? arities[owner] : 0;
+                calls[owner].push_back({depths[i] + base - max(arities[function], 0), function});
+            }
+        }
+        maxDepth = chain_depth(frames, calls);
+    }
+
+public:
+    //deepest stack over every chain of calls from entry 0, given the frame
+    //of each entry and the calls it makes ({depth below the callee's
+    //arguments, callee}), UNBOUNDED when one can reach itself
+    static long chain_depth(const vector<int>& frames, const vector<vector<pair<int, int>>>& calls) {
+        enum State : char { NEW, ACTIVE, DONE };
+        vector<char> state(frames.size(), NEW);
+        vector<long> total(frames.size(), 0);
+        //iterative depth-first search, a call to an ACTIVE entry is a cycle
+        vector<pair<int, size_t>> path = { {0, 0} };
+        state[0] = ACTIVE;
+        total[0] = frames[0];
+        while (!path.empty()) {
+            auto& [entry, next] = path.back();
+            if (next < calls[entry].size()) {
+                auto [below, function] = calls[entry][next++];
+                if (state[function] == ACTIVE) {
+                    return UNBOUNDED;
+                }
+                if (state[function] == NEW) {
+                    state[function] = ACTIVE;
+                    total[function] = frames[function];
+                    path.push_back({function, 0});
+                }
+                continue;
+            }
+            //every callee is DONE now
+            for (auto [below, function] : calls[entry]) {
+                total[entry] = max(total[entry], below + total[function]);
+            }
+            state[entry] = DONE;
+            path.pop_back();
+        }
+        return total[0];
+    }
+};
+
+//Stack_Verifier for a program whose instructions are streamed (see
+//Symbol_and_Assembly::stream): each block is checked once, in order, when it
+//is written, and max_depth() is known after the last one
+//relies on the order Symbol_and_Assembly generates code in: a function's
+//code is contiguous from its entry, a jump goes back only to a LABEL already
+//written and the only operands patched after they are written are those of
+//forward CALLs and of the JMP over the function bodies (see patch())
+//the generator tells the arity of each function and the arguments of each
+//forward CALL, since such a CALL has no operand yet when it is checked
+//keeps the depth at every LABEL and branch target and the calls per
+//function, not the code
+class Stream_Stack_Verifier {
+    static constexpr int UNKNOWN = Stack_Verifier::UNKNOWN;
+
+    unordered_map<int, int> functions;        //entry address -> arity
+    unordered_map<size_t, int> callArguments; //index of a CALL without an operand -> arguments
+
+    int depth = 0;  //before the next instruction, UNKNOWN when only a jump reaches it
+    int owner = 0;  //entry index of the code being checked
+    struct Target {
+        int depth;
+        int owner;
+    };
+    unordered_map<size_t, Target> targets;   //index -> depth every jump to it has, and its code
+    unordered_map<size_t, Target> unpatched; //jump without an operand yet -> the same for its target
+    vector<int> entryList = { 1 };       //addresses, the program's first
+    vector<int> arities = { 0 };
+    vector<int> frames = { 0 };
+    vector<vector<pair<int, int>>> calls = { {} }; //per entry, {depth below the callee's arguments, callee address}
+    unordered_map<size_t, pair<int, size_t>> callAt; //index of a CALL -> its place in calls
+
+    [[noreturn]] static void reject(const string& message, size_t index) {
+        throw runtime_error(message + " at instruction " + to_string(index + 1));
+    }
+
+    int arguments(size_t index, const Instruction& call) {
+        if (call.hasOperand) {
+            auto callee = functions.find(call.Operand);
+            if (callee == functions.end()) {
+                reject("CALL to an address that is not a function", index);
+            }
+            return callee->second;
+        }
+        auto arguments = callArguments.find(index);
+        if (arguments == callArguments.end()) {
+            reject("CALL without a function", index);
+        }
+        int count = arguments->second;
+        callArguments.erase(arguments);
+        return count;
+    }
+
+    //a jump from index to the instruction at address
+    void jump(size_t index, int address, Target from) {
+        size_t to = size_t(address) - 1;
+        auto known = targets.find(to);
+        if (known == targets.end()) {
+            if (to <= index) {
+                reject("Jump back to an instruction that is not a LABEL", index);
+            }
+            targets[to] = from;
+            return;
+        }
+        if (known->second.owner != from.owner) {
+            reject("Jump into another function", index);
+        }
+        if (known->second.depth != from.depth) {
+            reject("Stack depth " + to_string(from.depth) + " where another path has " +
+                   to_string(known->second.depth), to);
+        }
+    }
+
+public:
+    //the function whose code starts at address takes arity arguments
+    void function(int address, int arity) {
+        functions[address] = arity;
+    }
+
+    //the CALL at index passes arguments, for one written before its operand is known
+    void call(size_t index, int arguments) {
+        callArguments[index] = arguments;
+    }
+
+    //the instructions starting at index (see Instruction_Sink::write)
+    void write(size_t index, span<const Instruction> code) {
+        for (size_t k = 0; k < code.size(); k++, index++) {
+            const Instruction& instr = code[k];
+            auto entry = functions.find(int(index) + 1);
+            if (entry != functions.end()) {
+                if (depth != UNKNOWN) {
+                    reject("Entry inside other code", index);
+                }
+                owner = entryList.size();
+                entryList.push_back(index + 1);
+                arities.push_back(entry->second);
+                frames.push_back(entry->second);
+                calls.emplace_back();
+                depth = 0;
+            }
+            auto target = targets.find(index);
+            if (target != targets.end()) {
+                if (depth != UNKNOWN && owner != target->second.owner) {
+                    reject("Jump into another function", index);
+                }
+                if (depth != UNKNOWN && depth != target->second.depth) {
+                    reject("Stack depth " + to_string(depth) + " where another path has " +
+                           to_string(target->second.depth), index);
+                }
+                depth = target->second.depth;
+                owner = target->second.owner;
+                if (instr.Operator != Opcode::LABEL) {
+                    targets.erase(target);
+                }
+            }
+            else if (instr.Operator == Opcode::LABEL && depth != UNKNOWN) {
+                targets[index] = {depth, owner}; //for a jump back to it
+            }
+            if (depth == UNKNOWN) {
+                continue; //no path reaches it
+            }
+
+            int pops = instr.info().pops;
+            if (instr.Operator == Opcode::CALL) {
+                pops = arguments(index, instr);
+            }
+            int pushes = instr.info().pushes;
+            if (depth - pops < -arities[owner]) {
+                reject("Stack underflow", index);
+            }
+            frames[owner] = max({frames[owner], depth + arities[owner], depth - pops + pushes + arities[owner]});
+            switch (instr.Operator) {
+                case Opcode::JMP:
+                    if (instr.hasOperand) {
+                        jump(index, instr.Operand, {depth, owner});
+                    }
+                    else {
+                        unpatched[index] = {depth, owner};
+                    }
+                    depth = UNKNOWN;
+                    break;
+                case Opcode::JMP0:
+                case Opcode::JMP1:
+                    depth--;
+                    jump(index, instr.Operand, {depth, owner});
+                    break;
+                case Opcode::RET:
+                    if (owner == 0) {
+                        reject("RET outside a function", index);
+                    }
+                    if (1 - depth != arities[owner]) {
+                        reject("RET with " + to_string(depth) + " values above the function's arguments", index);
+                    }
+                    depth = UNKNOWN;
+                    break;
+                case Opcode::CALL:
+                    callAt[index] = {owner, calls[owner].size()};
+                    calls[owner].push_back({depth + arities[owner] - pops, instr.hasOperand ? instr.Operand : 0});
+                    depth += pushes - pops;
+                    break;
+                default:
+                    depth += pushes - pops;
+                    break;
+            }
+        }
+    }
+
+    //an instruction that was already written got its operand
+    void patch(size_t index, const Instruction& instr) {
+        if (instr.Operator == Opcode::CALL) {
+            auto call = callAt.find(index);
+            if (call != callAt.end()) {
+                calls[call->second.first][call->second.second].second = instr.Operand;
+            }
+            return;
+        }
+        auto jumped = unpatched.find(index);
+        if (jumped != unpatched.end()) {
+            jump(index, instr.Operand, jumped->second);
+            unpatched.erase(jumped);
+        }
+    }
+
+    //entries the whole program can need once every block has been written,
+    //Stack_Verifier::UNBOUNDED with recursion
+    long max_depth() const {
+        unordered_map<int, int> entryOf;
+        for (size_t e = 0; e < entryList.size(); e++) {
+            entryOf.emplace(entryList[e], e);
+        }
+        vector<vector<pair<int, int>>> callees(calls.size());
+        for (size_t e = 0; e < calls.size(); e++) {
+            for (auto [below, address] : calls[e]) {
+                auto callee = entryOf.find(address);
+                if (callee == entryOf.end() || callee->second == 0) {
+                    throw runtime_error("CALL to an address that is not a function");
+                }
+                callees[e].push_back({below, callee->second});
+            }
+        }
+        return Stack_Verifier::chain_depth(frames, callees);
+    }
+};
+
+#endif
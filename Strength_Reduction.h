@@ -0,0 +1,335 @@
+#ifndef STRENGTH_REDUCTION_H
+#define STRENGTH_REDUCTION_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <utility>
+#include <vector>
+#include "Instruction.h"
+#include "Code_Rewriter.h"
+#include "CFG.h"
+using namespace std;
+
+//-O1: replaces M and D by cheaper instructions (see opcode_cost())
+//run(): a multiply by a power of two 2^k becomes a SHL by k and a divide by
+//2^k a SHR by k, after adding 2^k - 1 to a negative dividend so the quotient
+//still rounds toward zero:
+//    x DUP 63 SHR 2^k-1 AND A k SHR
+//induction(): in a loop without a CALL, a variable whose every store in the
+//loop is i = i + c or i = i - c (c literal) is an induction variable, and
+//i * k (k literal) is kept in a temporary t instead: t = i * k before the
+//loop, t = t + c * k after every store to i and each i * k reads t
+//a product is reduced only when that costs less per iteration than the
+//multiplies it saves
+class Strength_Reduction {
+    Constant_Pool& pool;
+    //one temporary per reduced product, given the index of the instruction
+    //that pushes its value, which has the temporary's type
+    function<int(size_t)> temporary;
+
+    using Loop = Control_Flow_Graph::Loop;
+
+    //i * k in a loop
+    struct Product {
+        int variable;     //key of i, see key()
+        Instruction load; //PUSHM or PUSHL of i
+        int64_t factor;
+        vector<size_t> uses; //index of the first of its three instructions
+    };
+
+public:
+    size_t shifts = 0;     //multiplies made SHL
+    size_t divisions = 0;  //divides made SHR
+    size_t inductions = 0; //products of an induction variable kept in a temporary
+
+    Strength_Reduction(Constant_Pool& pool, function<int(size_t)> temporary)
+        : pool(pool), temporary(std::move(temporary)) {}
+
+    //returns the number of M and D replaced
+    size_t run(Code_Rewriter& rewriter) {
+        const auto& code = rewriter.code();
+        auto& out = rewriter.emitted();
+        size_t before = shifts + divisions;
+        for (size_t i = 0; i < code.size(); i++) {
+            rewriter.begin(i);
+            const Instruction& instr = code[i];
+            int64_t value = 0;
+            int k = 0;
+            bool rhs = !out.empty() && literal(out.back(), value) && (k = power_of_two(value)) > 0;
+
+            if (instr.Operator == Opcode::M && rhs) {
+                out.back() = Instruction(Opcode::PUSHI, k);
+                rewriter.emit(Instruction(Opcode::SHL));
+                shifts++;
+                continue;
+            }
+            if (instr.Operator == Opcode::D && rhs) {
+                rewriter.erase(out.size() - 1);
+                rewriter.emit(Instruction(Opcode::DUP));
+                rewriter.emit(Instruction(Opcode::PUSHI, 63));
+                rewriter.emit(Instruction(Opcode::SHR));
+                rewriter.emit(integer((int64_t(1) << k) - 1));
+                rewriter.emit(Instruction(Opcode::AND));
+                rewriter.emit(Instruction(Opcode::A));
+                rewriter.emit(Instruction(Opcode::PUSHI, k));
+                rewriter.emit(Instruction(Opcode::SHR));
+                divisions++;
+                continue;
+            }
+            if (instr.Operator == Opcode::M) {
+                //2^k * x, the literal is just below the code computing x
+                long start = operand_start(out);
+                if (start > 0 && literal(out[start - 1], value) && (k = power_of_two(value)) > 0) {
+                    rewriter.erase(start - 1);
+                    rewriter.emit(Instruction(Opcode::PUSHI, k));
+                    rewriter.emit(Instruction(Opcode::SHL));
+                    shifts++;
+                    continue;
+                }
+            }
+            rewriter.emit(instr);
+        }
+        return shifts + divisions - before;
+    }
+
+    //entries are the addresses control starts from (see Control_Flow_Graph)
+    //reduces the products of one loop in each nest, the innermost one that has
+    //any, so the caller runs it again while anything is reduced
+    //returns the number of products reduced
+    size_t induction(Code_Rewriter& rewriter, const vector<int>& entries) {
+        const auto& code = rewriter.code();
+        Control_Flow_Graph cfg(code, entries);
+        vector<Loop> loops = cfg.loops(code);
+        sort(loops.begin(), loops.end(), [](const Loop& a, const Loop& b) {
+            return a.last - a.header < b.last - b.header;
+        });
+
+        vector<char> changed(cfg.size(), 0); //blocks of loops reduced in this run
+        vector<vector<Instruction>> preheader(code.size());
+        vector<vector<Instruction>> after(code.size()); //emitted after a store
+        vector<int> replaced(code.size(), -1);          //first index of a product -> temporary
+        size_t before = inductions;
+        for (const Loop& loop : loops) {
+            if (any_of(changed.begin() + loop.header, changed.begin() + loop.last + 1, [](char c) { return c; })) {
+                continue;
+            }
+            size_t first = cfg[loop.header].begin;
+            size_t end = cfg[loop.last].end;
+            map<int, int64_t> steps = induction_variables(code, cfg, first, end);
+            bool reduced = false;
+            for (const Product& product : products(code, cfg, first, end, steps)) {
+                int t = temporary(product.uses.front() + 2);
+                preheader[first].push_back(product.load);
+                preheader[first].push_back(integer(product.factor));
+                preheader[first].push_back(Instruction(Opcode::M));
+                preheader[first].push_back(Instruction(Opcode::POPM, t));
+                for (size_t use : product.uses) {
+                    replaced[use] = t;
+                }
+                int64_t increment = int64_t(uint64_t(steps[product.variable]) * uint64_t(product.factor));
+                for (size_t i = first; i < end; i++) {
+                    if (is_store(code[i]) && key(code[i]) == product.variable) {
+                        after[i].push_back(Instruction(Opcode::PUSHM, t));
+                        after[i].push_back(integer(increment));
+                        after[i].push_back(Instruction(Opcode::A));
+                        after[i].push_back(Instruction(Opcode::POPM, t));
+                    }
+                }
+                inductions += product.uses.size();
+                reduced = true;
+            }
+            if (reduced) {
+                fill(changed.begin() + loop.header, changed.begin() + loop.last + 1, 1);
+            }
+        }
+
+        for (size_t i = 0; i < code.size(); i++) {
+            rewriter.begin(i);
+            if (!preheader[i].empty()) {
+                for (const Instruction& instr : preheader[i]) {
+                    rewriter.emit(instr);
+                }
+                //the back edge still goes to the header
+                rewriter.merge(i, rewriter.emitted().size());
+            }
+            if (replaced[i] >= 0) {
+                rewriter.emit(Instruction(Opcode::PUSHM, replaced[i]));
+                rewriter.begin(++i);
+                rewriter.begin(++i);
+                continue;
+            }
+            rewriter.emit(code[i]);
+            for (const Instruction& instr : after[i]) {
+                rewriter.emit(instr);
+            }
+        }
+        return inductions - before;
+    }
+
+private:
+    //literal value of a PUSHI or PUSHK
+    bool literal(const Instruction& instr, int64_t& value) const {
+        if (instr.Operator == Opcode::PUSHI) {
+            value = instr.Operand;
+            return true;
+        }
+        if (instr.Operator == Opcode::PUSHK) {
+            value = pool[instr.Operand];
+            return true;
+        }
+        return false;
+    }
+
+    Instruction integer(int64_t value) {
+        return fits_operand(value) ? Instruction(Opcode::PUSHI, int(value))
+                                   : Instruction(Opcode::PUSHK, pool.index(value));
+    }
+
+    //k when value is 2^k for k from 1 to 62, 0 otherwise
+    static int power_of_two(int64_t value) {
+        if (value < 2 || (value & (value - 1)) != 0 || value > (int64_t(1) << 62)) {
+            return 0;
+        }
+        return __builtin_ctzll(value);
+    }
+
+    //emitted index where the value on top of the stack starts being computed,
+    //-1 when that is not straight-line code without side effects
+    static long operand_start(const vector<Instruction>& out) {
+        int needed = 1;
+        for (size_t k = out.size(); k-- > 0;) {
+            const Opcode_Info& info = out[k].info();
+            if (!is_pure(out, k) || info.pushes > needed) {
+                return -1;
+            }
+            needed += info.pops - info.pushes;
+            if (needed == 0) {
+                return k;
+            }
+        }
+        return -1;
+    }
+
+    static bool is_load(const Instruction& instr) {
+        return instr.Operator == Opcode::PUSHM || instr.Operator == Opcode::PUSHL;
+    }
+
+    static bool is_store(const Instruction& instr) {
+        return instr.Operator == Opcode::POPM || instr.Operator == Opcode::POPL;
+    }
+
+    //memory addresses as they are, slot n as -(n + 1)
+    static int key(const Instruction& instr) {
+        return instr.info().operand == Operand_Kind::SLOT ? -(instr.Operand + 1) : instr.Operand;
+    }
+
+    //instructions first..last are in one block
+    static bool straight(const Control_Flow_Graph& cfg, size_t first, size_t last) {
+        return cfg.block_of(first) == cfg.block_of(last);
+    }
+
+    //induction variables of the loop spanning instructions first..end - 1,
+    //with the value each store adds
+    map<int, int64_t> induction_variables(const pmr::vector<Instruction>& code, const Control_Flow_Graph& cfg,
+                                          size_t first, size_t end) const {
+        map<int, int64_t> steps;
+        map<int, bool> induction;
+        for (size_t i = first; i < end; i++) {
+            if (code[i].Operator == Opcode::CALL) {
+                return {};
+            }
+            if (!is_store(code[i])) {
+                continue;
+            }
+            int variable = key(code[i]);
+            int64_t step = 0;
+            bool increments = i >= first + 3 && straight(cfg, i - 3, i) && increment(code, i, step);
+            auto known = steps.find(variable);
+            if (!increments || (known != steps.end() && known->second != step)) {
+                induction[variable] = false;
+                continue;
+            }
+            steps[variable] = step;
+            induction.emplace(variable, true);
+        }
+        for (const auto& [variable, is] : induction) {
+            if (!is) {
+                steps.erase(variable);
+            }
+        }
+        return steps;
+    }
+
+    //code[store - 3..store] is i c A i, c i A i or i c S i, step is what it adds
+    bool increment(const pmr::vector<Instruction>& code, size_t store, int64_t& step) const {
+        const Instruction& op = code[store - 1];
+        const Instruction& a = code[store - 3];
+        const Instruction& b = code[store - 2];
+        int variable = key(code[store]);
+        int64_t value = 0;
+        Opcode load = code[store].Operator == Opcode::POPM ? Opcode::PUSHM : Opcode::PUSHL;
+        if (a.Operator == load && key(a) == variable && literal(b, value)) {
+            if (op.Operator == Opcode::A) {
+                step = value;
+                return true;
+            }
+            if (op.Operator == Opcode::S) {
+                step = int64_t(0 - uint64_t(value));
+                return true;
+            }
+        }
+        if (op.Operator == Opcode::A && b.Operator == load && key(b) == variable && literal(a, value)) {
+            step = value;
+            return true;
+        }
+        return false;
+    }
+
+    //products of an induction variable and a literal that are worth keeping
+    //in a temporary
+    vector<Product> products(const pmr::vector<Instruction>& code, const Control_Flow_Graph& cfg,
+                             size_t first, size_t end, const map<int, int64_t>& steps) const {
+        map<pair<int, int64_t>, vector<size_t>> found;
+        map<int, Instruction> loads;
+        for (size_t i = first; i + 2 < end; i++) {
+            if (code[i + 2].Operator != Opcode::M || !straight(cfg, i, i + 2)) {
+                continue;
+            }
+            int64_t factor = 0;
+            const Instruction* load = nullptr;
+            if (is_load(code[i]) && literal(code[i + 1], factor)) {
+                load = &code[i];
+            }
+            else if (literal(code[i], factor) && is_load(code[i + 1])) {
+                load = &code[i + 1];
+            }
+            if (load && steps.count(key(*load))) {
+                found[{key(*load), factor}].push_back(i);
+                loads[key(*load)] = *load;
+                i += 2;
+            }
+        }
+
+        vector<Product> worth;
+        for (auto& [product, uses] : found) {
+            size_t stores = 0;
+            for (size_t i = first; i < end; i++) {
+                stores += is_store(code[i]) && key(code[i]) == product.first;
+            }
+            //what run() would leave of the multiply
+            int multiply = power_of_two(product.second) > 0 ? opcode_cost(Opcode::SHL) : opcode_cost(Opcode::M);
+            long saved = long(uses.size()) * (opcode_cost(Opcode::PUSHI) + multiply);
+            long added = long(stores) * (opcode_cost(Opcode::PUSHM) + opcode_cost(Opcode::PUSHI) +
+                                         opcode_cost(Opcode::A) + opcode_cost(Opcode::POPM));
+            if (saved > added) {
+                worth.push_back({product.first, loads[product.first], product.second, std::move(uses)});
+            }
+        }
+        return worth;
+    }
+};
+
+#endif
@@ -0,0 +1,217 @@
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Type.h"
+using namespace std;
+
+//identifier spellings, each distinct name gets a dense id in order of first use
+//found through an open-addressing index (linear probing, at most half full)
+class Name_Table {
+    struct Slot {
+        uint32_t hash;
+        int32_t name; //-1 when empty
+    };
+
+    pmr::vector<pmr::string> names;
+    pmr::vector<Slot> slots;
+
+    static uint32_t hash_of(string_view name) {
+        return uint32_t(hash<string_view>()(name));
+    }
+
+    //slot holding name, or the empty slot where it would go
+    size_t probe(string_view name, uint32_t hash) const {
+        size_t mask = slots.size() - 1;
+        size_t i = hash & mask;
+        while (slots[i].name >= 0 && (slots[i].hash != hash || names[slots[i].name] != name)) {
+            i = (i + 1) & mask;
+        }
+        return i;
+    }
+
+    void grow() {
+        pmr::vector<Slot> old(slots.size() * 2, Slot{0, -1}, slots.get_allocator());
+        old.swap(slots);
+        for (const Slot& slot : old) {
+            if (slot.name >= 0) {
+                slots[probe(names[slot.name], slot.hash)] = slot;
+            }
+        }
+    }
+
+public:
+    static constexpr int NONE = -1;
+
+    explicit Name_Table(pmr::memory_resource* memory = pmr::get_default_resource())
+        : names(memory), slots(16, Slot{0, -1}, memory) {}
+
+    //id of name, NONE if it was never interned
+    int find(string_view name) const {
+        return slots[probe(name, hash_of(name))].name;
+    }
+
+    //id of name, added if it is new
+    int intern(string_view name) {
+        uint32_t hash = hash_of(name);
+        size_t i = probe(name, hash);
+        if (slots[i].name >= 0) {
+            return slots[i].name;
+        }
+        int id = names.size();
+        names.emplace_back(name);
+        slots[i] = {hash, id};
+        if (names.size() * 2 > slots.size()) {
+            grow();
+        }
+        return id;
+    }
+
+    const pmr::string& operator[](int id) const {
+        return names[id];
+    }
+
+    size_t size() const {
+        return names.size();
+    }
+
+    void clear() {
+        names.clear();
+        slots.assign(16, Slot{0, -1});
+    }
+};
+
+//variables in declaration order, referred to by a dense symbol id
+//the parser resolves a name once with find(), after that every access is indexing
+//a function's parameters and declarations are locals of its scope: they hide
+//globals of the same name until end_scope() and live in frame slots
+class Symbol_Table {
+public:
+    struct Symbol {
+        int name;        //id in names()
+        int memoryADDR;  //frame slot for a local
+        Type type;
+        int scope;       //0 for globals, otherwise the scope given to begin_scope()
+    };
+
+    static constexpr int NONE = -1;
+
+private:
+    Name_Table nameTable;
+    pmr::vector<Symbol> symbols;
+    pmr::vector<int> symbolOfName; //name id -> global symbol id or NONE
+    pmr::vector<int> localOfName;  //name id -> local symbol id of the open scope or NONE
+    pmr::vector<int> scopeNames;   //name ids bound in the open scope
+    int openScope = 0;
+
+    static int bound(const pmr::vector<int>& table, int id) {
+        return id == Name_Table::NONE || size_t(id) >= table.size() ? NONE : table[id];
+    }
+
+    int bind(pmr::vector<int>& table, int id, int memoryADDR, Type type, int scope) {
+        if (size_t(id) >= table.size()) {
+            table.resize(id + 1, NONE);
+        }
+        if (table[id] == NONE) {
+            table[id] = symbols.size();
+            symbols.push_back({id, memoryADDR, type, scope});
+        }
+        else {
+            symbols[table[id]].memoryADDR = memoryADDR;
+            symbols[table[id]].type = type;
+        }
+        return table[id];
+    }
+
+public:
+    explicit Symbol_Table(pmr::memory_resource* memory = pmr::get_default_resource())
+        : nameTable(memory), symbols(memory), symbolOfName(memory), localOfName(memory), scopeNames(memory) {}
+
+    //symbol id of a variable, a local of the open scope first, NONE if it was not declared
+    int find(string_view name) const {
+        int id = nameTable.find(name);
+        int local = openScope ? bound(localOfName, id) : NONE;
+        return local != NONE ? local : bound(symbolOfName, id);
+    }
+
+    //starts a scope, scope must be greater than 0
+    void begin_scope(int scope) {
+        openScope = scope;
+    }
+
+    void end_scope() {
+        for (int id : scopeNames) {
+            localOfName[id] = NONE;
+        }
+        scopeNames.clear();
+        openScope = 0;
+    }
+
+    //declares name in the open scope at a frame slot
+    int declare_local(string_view name, int slot, Type type) {
+        int id = nameTable.intern(name);
+        if (bound(localOfName, id) == NONE) {
+            scopeNames.push_back(id);
+        }
+        return bind(localOfName, id, slot, type, openScope);
+    }
+
+    bool is_local(int symbol) const {
+        return symbols[symbol].scope != 0;
+    }
+
+    //declares a global name at memoryADDR, a second declaration of a name moves it
+    int declare(string_view name, int memoryADDR, Type type) {
+        return bind(symbolOfName, nameTable.intern(name), memoryADDR, type, 0);
+    }
+
+    Symbol& operator[](int symbol) {
+        return symbols[symbol];
+    }
+
+    const Symbol& operator[](int symbol) const {
+        return symbols[symbol];
+    }
+
+    const pmr::string& name(int symbol) const {
+        return nameTable[symbols[symbol].name];
+    }
+
+    //shared with other tables keyed by name (e.g. functions)
+    Name_Table& names() {
+        return nameTable;
+    }
+
+    const Name_Table& names() const {
+        return nameTable;
+    }
+
+    size_t size() const {
+        return symbols.size();
+    }
+
+    auto begin() const {
+        return symbols.begin();
+    }
+
+    auto end() const {
+        return symbols.end();
+    }
+
+    void clear() {
+        nameTable.clear();
+        symbols.clear();
+        symbolOfName.clear();
+        localOfName.clear();
+        scopeNames.clear();
+        openScope = 0;
+    }
+};
+
+#endif
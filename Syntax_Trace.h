@@ -0,0 +1,142 @@
+#ifndef SYNTAX_TRACE_H
+#define SYNTAX_TRACE_H
+
+#include <cstdint>
+#include <ostream>
+#include <memory_resource>
+#include <vector>
+#include "TokenType.h"
+using namespace std;
+
+//derivation trace of SyntaxAnalyzer
+//streaming mode writes every step to the syntax output file as it happens
+//flight-recorder mode keeps only the last N steps in memory and writes them out
+//when an error is reached or when dump() is called
+class Syntax_Trace {
+    //the production text is a string literal, so its address doubles as the production ID
+    struct Record {
+        const char* text;
+        uint32_t tokenIndex;
+        uint8_t flags;
+    };
+
+    enum : uint8_t {
+        NEWLINE = 1, //text ends the line
+        LEXEME = 2,  //'%' in text is replaced by the lexeme at tokenIndex
+        TOKEN = 4    //token banner for the token at tokenIndex
+    };
+
+    ostream& out;
+    const pmr::vector<Token>& tokens;
+    const size_t& currentIndex; //parser position, recorded with every step
+    vector<Record> ring;
+    size_t next = 0;     //ring slot the next record goes into
+    size_t recorded = 0; //records since the last dump
+
+    void record(const char* text, size_t tokenIndex, uint8_t flags) {
+        if (ring.empty()) {
+            write(Record{text, uint32_t(tokenIndex), flags});
+            return;
+        }
+        ring[next] = Record{text, uint32_t(tokenIndex), flags};
+        next = (next + 1) % ring.size();
+        recorded++;
+    }
+
+    void write(const Record& rec) {
+        if (rec.flags & TOKEN) {
+            const Token& token = tokens[rec.tokenIndex];
+            out << "================================================================================\n";
+            out << "\t\t\tToken:" << tokenTypeToString(token.type) << "\tLexeme:" << token.value << "\n";
+            out << "================================================================================\n";
+            return;
+        }
+
+        if (rec.flags & LEXEME) {
+            for (const char* c = rec.text; *c; c++) {
+                if (*c == '%') {
+                    out << tokens[rec.tokenIndex].value;
+                }
+                else {
+                    out << *c;
+                }
+            }
+        }
+        else {
+            out << rec.text;
+        }
+
+        if (rec.flags & NEWLINE) {
+            out << "\n";
+        }
+    }
+
+public:
+    //capacity 0 streams everything, otherwise only the last capacity steps are kept
+    Syntax_Trace(ostream& out, const pmr::vector<Token>& tokens, const size_t& currentIndex, size_t capacity = 0)
+        : out(out), tokens(tokens), currentIndex(currentIndex), ring(capacity) {}
+
+    // Converts TokenType to string for printing
+    static string tokenTypeToString(TokenType type) {
+        switch (type) {
+            case TokenType::KEYWORD: return "KEYWORD";
+            case TokenType::IDENTIFIER: return "IDENTIFIER";
+            case TokenType::INTEGER: return "INTEGER";
+            case TokenType::REAL: return "REAL";
+            case TokenType::OPERATOR: return "OPERATOR";
+            case TokenType::SEPARATOR: return "SEPARATOR";
+            case TokenType::UNKNOWN: return "UNKNOWN";
+            case TokenType::EMPTY: return "EMPTY";
+            default: return "UNKNOWN";
+        }
+    }
+
+    //one full line of the trace
+    void line(const char* text) {
+        record(text, currentIndex, NEWLINE);
+    }
+
+    //text that the next record continues on the same line
+    void text(const char* text) {
+        record(text, currentIndex, 0);
+    }
+
+    //banner for a token the parser consumed
+    void token(size_t tokenIndex) {
+        record(nullptr, tokenIndex, TOKEN);
+    }
+
+    //error messages flush the flight recorder so the failing context is kept
+    void error(const char* text, bool newline = false) {
+        record(text, currentIndex, newline ? NEWLINE : 0);
+        dump();
+    }
+
+    //same as error(), with '%' replaced by the lexeme at tokenIndex
+    void error_lexeme(const char* text, size_t tokenIndex) {
+        record(text, tokenIndex, NEWLINE | LEXEME);
+        dump();
+    }
+
+    //writes the records kept in the ring (a no-op when streaming)
+    void dump() {
+        if (ring.empty()) {
+            out.flush();
+            return;
+        }
+
+        size_t kept = recorded < ring.size() ? recorded : ring.size();
+        if (recorded > kept) {
+            out << "[flight recorder: last " << kept << " of " << recorded << " steps]\n";
+        }
+
+        size_t start = (next + ring.size() - kept) % ring.size();
+        for (size_t i = 0; i < kept; i++) {
+            write(ring[(start + i) % ring.size()]);
+        }
+        out.flush();
+        recorded = 0;
+    }
+};
+
+#endif
@@ -17,7 +17,7 @@ enum class TokenType {
 struct Token {
     TokenType type;
     std::string value;
-    Token(TokenType type, string value) : type(type), value(value) {}
+    constexpr Token(TokenType type, string value) : type(type), value(value) {}
 };
 
 #endif
\ No newline at end of file
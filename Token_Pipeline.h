@@ -0,0 +1,152 @@
+#ifndef TOKEN_PIPELINE_H
+#define TOKEN_PIPELINE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <ostream>
+#include <thread>
+#include <utility>
+#include <memory_resource>
+#include <vector>
+#include "TokenType.h"
+#include "Lexical_Analyzer.h"
+using namespace std;
+
+//lock-free ring for exactly one producer thread and one consumer thread
+//head and tail live on separate cache lines so the two threads never share one
+template <typename T, size_t Capacity>
+class SPSC_Queue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "SPSC_Queue capacity must be a power of two");
+    static constexpr size_t CACHE_LINE = 64;
+
+    //consumer side: next slot to read and the last tail it saw
+    alignas(CACHE_LINE) atomic<size_t> head{0};
+    size_t cachedTail = 0;
+
+    //producer side: next slot to write and the last head it saw
+    alignas(CACHE_LINE) atomic<size_t> tail{0};
+    size_t cachedHead = 0;
+
+    alignas(CACHE_LINE) array<T, Capacity> slots;
+
+public:
+    //returns false if the ring is full
+    bool try_push(T&& item) {
+        size_t t = tail.load(memory_order_relaxed);
+        if (t - cachedHead == Capacity) {
+            cachedHead = head.load(memory_order_acquire);
+            if (t - cachedHead == Capacity) {
+                return false;
+            }
+        }
+        slots[t & (Capacity - 1)] = std::move(item);
+        tail.store(t + 1, memory_order_release);
+        return true;
+    }
+
+    //returns false if the ring is empty
+    bool try_pop(T& item) {
+        size_t h = head.load(memory_order_relaxed);
+        if (h == cachedTail) {
+            cachedTail = tail.load(memory_order_acquire);
+            if (h == cachedTail) {
+                return false;
+            }
+        }
+        item = std::move(slots[h & (Capacity - 1)]);
+        head.store(h + 1, memory_order_release);
+        return true;
+    }
+
+    void push(T&& item) {
+        while (!try_push(std::move(item))) {
+            this_thread::yield();
+        }
+    }
+
+    void pop(T& item) {
+        while (!try_pop(item)) {
+            this_thread::yield();
+        }
+    }
+};
+
+//runs the lexer on its own thread and hands tokens to the parser in batches
+//an empty batch marks the end of the input
+class Token_Pipeline {
+    static constexpr size_t BATCH_SIZE = 256;
+    static constexpr size_t RING_SIZE = 64;
+
+    SPSC_Queue<vector<Token>, RING_SIZE> queue;
+    bool finished = false;
+    thread producer;
+
+    void run(FILE* filePointer, ostream* lexicalOut) {
+        LexicalAnalyzer la;
+        vector<Token> batch;
+        batch.reserve(BATCH_SIZE);
+
+        while (true) {
+            Token token = la.lexer(filePointer);
+            if (token.value.empty()) {
+                break;
+            }
+            if (lexicalOut) {
+                write_lexical_row(*lexicalOut, token);
+            }
+            batch.push_back(std::move(token));
+            if (batch.size() == BATCH_SIZE) {
+                queue.push(std::move(batch));
+                batch = vector<Token>();
+                batch.reserve(BATCH_SIZE);
+            }
+        }
+
+        if (!batch.empty()) {
+            queue.push(std::move(batch));
+        }
+        queue.push(vector<Token>());
+    }
+
+public:
+    //starts lexing right away, the file must stay open until join()
+    Token_Pipeline(FILE* filePointer, ostream* lexicalOut = nullptr)
+        : producer(&Token_Pipeline::run, this, filePointer, lexicalOut) {}
+
+    ~Token_Pipeline() {
+        join();
+    }
+
+    Token_Pipeline(const Token_Pipeline&) = delete;
+    Token_Pipeline& operator=(const Token_Pipeline&) = delete;
+
+    //appends the next batch to tokens, returns false once the lexer is done
+    bool next_batch(pmr::vector<Token>& tokens) {
+        if (finished) {
+            return false;
+        }
+        vector<Token> batch;
+        queue.pop(batch);
+        if (batch.empty()) {
+            finished = true;
+            return false;
+        }
+        tokens.insert(tokens.end(), make_move_iterator(batch.begin()), make_move_iterator(batch.end()));
+        return true;
+    }
+
+    //drains whatever the parser did not read so the lexer thread can finish
+    void join() {
+        pmr::vector<Token> rest;
+        while (next_batch(rest)) {
+            rest.clear();
+        }
+        if (producer.joinable()) {
+            producer.join();
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef TYPE_H
+#define TYPE_H
+
+//types tracked by Symbol_and_Assembly for variables and stack entries
+enum Type { INTEGER, BOOLEAN, UNDEFINED, REAL };
+
+constexpr const char* type_name(Type type) {
+    return type == INTEGER ? "Integer" : type == BOOLEAN ? "Boolean" : type == REAL ? "Real" : "Undefined";
+}
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef UNREACHABLE_CODE_H
+#define UNREACHABLE_CODE_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "Instruction.h"
+#include "Code_Rewriter.h"
+#include "CFG.h"
+using namespace std;
+
+//-O1: drops the basic blocks no entry reaches, e.g. statements after a return
+//or the side of an if the constant folder decided
+//a removed instruction's address goes to the next instruction kept, only
+//unreachable code can have jumped to it
+class Unreachable_Code {
+    vector<int> entries;
+
+public:
+    size_t blocks = 0;       //blocks removed
+    size_t instructions = 0; //instructions removed
+
+    explicit Unreachable_Code(vector<int> entries) : entries(std::move(entries)) {}
+
+    //returns the number of instructions removed
+    size_t run(Code_Rewriter& rewriter) {
+        const auto& code = rewriter.code();
+        Control_Flow_Graph cfg(code, entries);
+        size_t before = instructions;
+        for (size_t b = 0; b < cfg.size(); b++) {
+            bool keep = cfg.reachable(b);
+            if (!keep) {
+                blocks++;
+                instructions += cfg[b].end - cfg[b].begin;
+            }
+            for (size_t i = cfg[b].begin; i < cfg[b].end; i++) {
+                rewriter.begin(i);
+                if (keep) {
+                    rewriter.emit(code[i]);
+                }
+            }
+        }
+        return instructions - before;
+    }
+};
+
+#endif
@@ -0,0 +1,269 @@
+#ifndef VALUE_NUMBERING_H
+#define VALUE_NUMBERING_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "Instruction.h"
+#include "Code_Rewriter.h"
+#include "CFG.h"
+using namespace std;
+
+//-O1: local value numbering, an expression computed again in the same block
+//is not recomputed
+//values are numbered by what computes them: a literal, a variable as it was
+//since its last store, or an operator and the numbers of its operands (in
+//either order for A, M, AND, EQU, NEQ and their B and F forms), so a POPM
+//or POPL makes the variable a new value and the result of a SIN, SINF or
+//CALL is always new
+//the first computation is copied into a temporary (DUP POPM t) and each later
+//one becomes PUSHM t, or a DUP when it is the only one and follows right
+//after, as in (a + b) * (a + b)
+//a CALL forgets the values before it: the callee may store to any global,
+//and may run this block again, overwriting its temporaries
+//a value is reused only when that costs less than recomputing it (see
+//opcode_cost())
+class Value_Numbering {
+    //one temporary per reused value, given the index of the instruction
+    //that pushes it, which has the temporary's type
+    function<int(size_t)> temporary;
+
+    //a stack entry while numbering a block
+    struct Value {
+        int number;
+        long begin; //first instruction computing it, -1 when not one contiguous expression
+        size_t end; //the instruction that pushed it
+    };
+
+    //a later computation of a value, instructions begin..end
+    struct Reuse {
+        size_t begin;
+        size_t end;
+        int cost;
+    };
+
+    //a value computed more than once
+    struct Known {
+        int number;
+        size_t first; //the instruction that computed it first
+        vector<Reuse> reuses;
+    };
+
+public:
+    size_t values = 0;   //values reused
+    size_t reused = 0;   //computations replaced
+    size_t temporaries = 0;
+
+    explicit Value_Numbering(function<int(size_t)> temporary) : temporary(std::move(temporary)) {}
+
+    //entries are the addresses control starts from (see Control_Flow_Graph)
+    //returns the number of computations replaced
+    size_t run(Code_Rewriter& rewriter, const vector<int>& entries) {
+        const auto& code = rewriter.code();
+        Control_Flow_Graph cfg(code, entries);
+        vector<long> copyAfter(code.size(), -1);   //first computation -> temporary
+        vector<long> replacedBy(code.size(), -2);  //reuse begin -> temporary, -1 for a DUP
+        vector<size_t> replacedEnd(code.size(), 0);
+        vector<char> covered(code.size(), 0);      //in a replaced computation
+        size_t before = reused;
+        for (size_t b = 0; b < cfg.size(); b++) {
+            for (Known& known : numbered(code, cfg[b].begin, cfg[b].end)) {
+                choose(known, copyAfter, replacedBy, replacedEnd, covered);
+            }
+        }
+
+        for (size_t i = 0; i < code.size(); i++) {
+            rewriter.begin(i);
+            if (replacedBy[i] == -2) {
+                rewriter.emit(code[i]);
+                if (copyAfter[i] >= 0) {
+                    rewriter.emit(Instruction(Opcode::DUP));
+                    rewriter.emit(Instruction(Opcode::POPM, int(copyAfter[i])));
+                }
+                continue;
+            }
+            rewriter.emit(replacedBy[i] < 0 ? Instruction(Opcode::DUP) : Instruction(Opcode::PUSHM, int(replacedBy[i])));
+            for (size_t end = replacedEnd[i]; i < end;) {
+                rewriter.begin(++i);
+            }
+        }
+        return reused - before;
+    }
+
+private:
+    static bool commutative(Opcode op) {
+        return op == Opcode::A || op == Opcode::M || op == Opcode::AND || op == Opcode::EQU || op == Opcode::NEQ ||
+               op == Opcode::EQUB || op == Opcode::NEQB || op == Opcode::AF || op == Opcode::MF ||
+               op == Opcode::EQUF || op == Opcode::NEQF;
+    }
+
+    //the values of instructions begin..end - 1 computed more than once, an
+    //expression after the values it encloses
+    static vector<Known> numbered(const pmr::vector<Instruction>& code, size_t begin, size_t end) {
+        map<tuple<int, int64_t, int64_t>, int> numberOf;
+        map<int, int> versions; //variable key -> version, bumped by a store
+        int next = 0;
+        auto number = [&](int kind, int64_t a, int64_t b) {
+            auto [it, added] = numberOf.emplace(make_tuple(kind, a, b), next);
+            next += added;
+            return it->second;
+        };
+        auto fresh = [&]() {
+            return number(-1, next, 0);
+        };
+        //memory addresses as they are, slot n as -(n + 1)
+        auto key = [](const Instruction& instr) {
+            return instr.info().operand == Operand_Kind::SLOT ? -(instr.Operand + 1) : instr.Operand;
+        };
+
+        map<int, Known> known;
+        vector<Known> found;
+        auto forget = [&]() {
+            for (auto& [value, what] : known) {
+                if (!what.reuses.empty()) {
+                    found.push_back(std::move(what));
+                }
+            }
+            known.clear();
+        };
+        vector<Value> stack;
+        auto pop = [&]() {
+            Value value = {fresh(), -1, 0};
+            if (!stack.empty()) {
+                value = stack.back();
+                stack.pop_back();
+            }
+            return value;
+        };
+        for (size_t i = begin; i < end; i++) {
+            const Instruction& instr = code[i];
+            const Opcode_Info& info = instr.info();
+            switch (instr.Operator) {
+                case Opcode::PUSHI:
+                case Opcode::PUSHB:
+                case Opcode::PUSHU:
+                case Opcode::PUSHK:
+                case Opcode::PUSHF:
+                    stack.push_back({number(int(instr.Operator), instr.Operand, 0), long(i), i});
+                    continue;
+                case Opcode::PUSHM:
+                case Opcode::PUSHL:
+                    stack.push_back({number(int(instr.Operator), key(instr), versions[key(instr)]), long(i), i});
+                    continue;
+                case Opcode::POPM:
+                case Opcode::POPL:
+                    pop();
+                    versions[key(instr)] = ++next; //never the 0 of a variable not stored yet
+                    continue;
+                case Opcode::DUP: {
+                    Value value = pop();
+                    stack.push_back(value);
+                    stack.push_back({value.number, -1, i});
+                    continue;
+                }
+                case Opcode::CALL:
+                    //how many arguments it pops is not known here
+                    stack.clear();
+                    forget();
+                    numberOf.clear();
+                    versions.clear();
+                    stack.push_back({fresh(), -1, i});
+                    continue;
+                default:
+                    break;
+            }
+            if (info.rule == Type_Rule::NONE) {
+                for (int k = 0; k < info.pops; k++) {
+                    pop();
+                }
+                for (int k = 0; k < info.pushes; k++) {
+                    stack.push_back({fresh(), -1, i});
+                }
+                continue;
+            }
+
+            Value second = pop();
+            Value first = pop(); //below
+            int a = first.number, b = second.number;
+            if (commutative(instr.Operator) && a > b) {
+                swap(a, b);
+            }
+            //operands pushed by the instructions right before, one after the other
+            bool contiguous = first.begin >= 0 && second.begin >= 0 && size_t(second.begin) == first.end + 1 &&
+                              second.end + 1 == i;
+            Value result = {number(int(instr.Operator), a, b), contiguous ? first.begin : -1, i};
+            auto seen = known.find(result.number);
+            if (seen == known.end()) {
+                known.emplace(result.number, Known{result.number, i, {}});
+            }
+            else if (result.begin >= 0) {
+                int cost = 0;
+                for (size_t k = result.begin; k <= i; k++) {
+                    cost += opcode_cost(code[k].Operator);
+                }
+                seen->second.reuses.push_back({size_t(result.begin), i, cost});
+            }
+            stack.push_back(result);
+        }
+
+        forget();
+        //an expression is numbered after its operands
+        sort(found.begin(), found.end(), [](const Known& a, const Known& b) {
+            return a.number > b.number;
+        });
+        return found;
+    }
+
+    //keeps the reuses of known that do not lie in an expression already
+    //replaced and are worth it
+    void choose(const Known& known, vector<long>& copyAfter, vector<long>& replacedBy, vector<size_t>& replacedEnd,
+                vector<char>& covered) {
+        if (covered[known.first]) {
+            return;
+        }
+        vector<Reuse> kept;
+        for (const Reuse& reuse : known.reuses) {
+            //the values enclosing this one were chosen first
+            if (none_of(covered.begin() + reuse.begin, covered.begin() + reuse.end + 1, [](char c) { return c; }) &&
+                none_of(copyAfter.begin() + reuse.begin, copyAfter.begin() + reuse.end + 1, [](long t) { return t >= 0; })) {
+                kept.push_back(reuse);
+            }
+        }
+        if (kept.empty()) {
+            return;
+        }
+        auto replace = [&](const Reuse& reuse, long by) {
+            replacedBy[reuse.begin] = by;
+            replacedEnd[reuse.begin] = reuse.end;
+            fill(covered.begin() + reuse.begin, covered.begin() + reuse.end + 1, 1);
+        };
+        if (kept.size() == 1 && kept[0].begin == known.first + 1 && copyAfter[known.first] < 0) {
+            replace(kept[0], -1);
+            values++;
+            reused++;
+            return;
+        }
+        long saved = 0;
+        for (const Reuse& reuse : kept) {
+            saved += reuse.cost - opcode_cost(Opcode::PUSHM);
+        }
+        if (saved <= opcode_cost(Opcode::DUP) + opcode_cost(Opcode::POPM)) {
+            return;
+        }
+        int t = temporary(known.first);
+        copyAfter[known.first] = t;
+        for (const Reuse& reuse : kept) {
+            replace(reuse, t);
+        }
+        values++;
+        temporaries++;
+        reused += kept.size();
+    }
+};
+
+#endif
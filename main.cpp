@@ -1,84 +1,178 @@
 #include <iostream>
 #include <fstream> //for output files
 #include <sstream>
+#include <chrono>
+#include <cstring>
+#include <cctype>
+#include <filesystem>
+#include <memory>
+#include <new>
+#include <atomic>
+#include <cstdlib>
 #include "RPD.h"
 #include "Lexical_Analyzer.h"
+#include "Token_Pipeline.h"
+#include "Arena.h"
+#include "Linker.h"
+#include "Bytecode.h"
+#include "Constexpr_Compiler.h"
 using namespace std;
 
-int main(){
+//every operator new in the process, --stats reports those of each compilation
+//(the arena only sees what is routed through it)
+static atomic<size_t> heapAllocations{0};
 
-    //get's file name and reads file
-    string FILE_NAME;
-    cout << "Please enter the file name (t1.txt, t2.txt, t3.txt, t4.txt, t5.txt): ";
-    cin >> FILE_NAME;
-
-    FILE* filePointer = fopen(FILE_NAME.c_str(), "r");
-
-    if (!filePointer) {
-        std::cout << "Error: Cannot open file " << FILE_NAME << std::endl;
-        return 1;
+void* operator new(size_t size) {
+    heapAllocations.fetch_add(1, memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) {
+        return p;
     }
+    throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
 
-    //initializes class and vector
-    LexicalAnalyzer la;
-    std::vector<Token> tokens;
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
 
-    //calls lexer and pushes tokens inside the vector
-    while (true) {
-        Token token = la.lexer(filePointer);
-        if (token.value.empty()) {
-            break;
-        }
-        tokens.push_back(token);
+//pmr::new_delete_resource() allocates with an alignment
+void* operator new(size_t size, align_val_t alignment) {
+    heapAllocations.fetch_add(1, memory_order_relaxed);
+    size_t align = size_t(alignment);
+    //aligned_alloc takes a multiple of the alignment
+    if (void* p = aligned_alloc(align, max<size_t>(1, (size + align - 1) / align) * align)) {
+        return p;
     }
+    throw bad_alloc();
+}
 
-    //closes file
-    fclose(filePointer);
-
-    //get's file name and writes to file
-    string outputFileName = "Lexical_Analysis_Output.txt";
+void operator delete(void* p, align_val_t) noexcept {
+    free(p);
+}
 
-    ofstream outFile(outputFileName);
-    if (!outFile) {
-        std::cerr << "Error opening output file for writing" << std::endl;
-        return 1;
-    }
+void operator delete(void* p, size_t, align_val_t) noexcept {
+    free(p);
+}
 
-    outFile << "\nOutput:\n";
-    outFile << "                    token                             lexeme\n";
-    outFile << "------------------------------------------------------------\n";
+//command line flags
+struct Options {
+    bool pipelined = false; //lexer and parser run on separate threads
+    bool timing = false;    //prints the lex + parse wall-clock time
+    size_t traceRing = 0;   //keeps only the last N syntax steps, 0 streams the full trace
+    bool dumpTrace = false; //writes the kept steps even when the parse succeeds
+    bool arena = false;     //one Compilation_Arena per input instead of the global heap
+    bool stats = false;     //prints allocation statistics and latency per input
+    int optimize = 0;       //-O level, 0 leaves the generated code as it is
+    unsigned peephole = 0;  //--peephole rules (see Peephole.h), -O2 turns on all of them
+    int unroll = Loop_Unrolling::UNROLL_FACTOR; //--unroll=N: -O2 unrolls counted loops N times, 1 only fully, 0 not at all
+    bool compileOnly = false; //-c: writes relocatable object files instead of listings
+    bool bytecode = false;  //--bytecode: writes bytecode files (see Bytecode.h) instead of listings
+    bool disassemble = false; //--disassemble: the input files are bytecode files to list
+    bool stream = false;    //--stream: instructions are written while parsing instead of kept until the end
+    bool cfg = false;       //--cfg: also writes the control flow graph to <output>.dot (Graphviz)
+    bool run = false;       //--run: executes the program after writing it, scan() reads standard input
+    string linkOutput;      //--link: links the object files given into this listing
+    vector<string> files;   //input/output pairs (object files when linking), prompted for when empty
+};
 
-    //outputs using the vector
-    for (size_t i = 0; i < tokens.size(); ++i) {
-        string type;
-        switch (tokens[i].type) {
-        case TokenType::KEYWORD: type = "keyword";
-            break;
-        case TokenType::IDENTIFIER: type = "identifier";
-            break;
-        case TokenType::INTEGER: type = "integer";
-            break;
-        case TokenType::REAL: type = "real";
-            break;
-        case TokenType::OPERATOR: type = "operator";
-            break;
-        case TokenType::SEPARATOR: type = "separator";
-            break;
-        default: type = "unknown";
-            break;
+Options parse_options(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--pipeline") == 0) {
+            options.pipelined = true;
+        }
+        else if (strcmp(argv[i], "--time") == 0) {
+            options.timing = true;
+        }
+        else if (strcmp(argv[i], "--trace-ring") == 0) {
+            options.traceRing = 256;
+        }
+        else if (strncmp(argv[i], "--trace-ring=", 13) == 0) {
+            options.traceRing = stoul(argv[i] + 13);
+        }
+        else if (strcmp(argv[i], "--dump-trace") == 0) {
+            options.dumpTrace = true;
+        }
+        else if (strcmp(argv[i], "--arena") == 0) {
+            options.arena = true;
+        }
+        else if (strcmp(argv[i], "--stats") == 0) {
+            options.stats = true;
+        }
+        else if (strcmp(argv[i], "-O") == 0) {
+            options.optimize = 1;
+        }
+        else if (strncmp(argv[i], "-O", 2) == 0 && isdigit(argv[i][2])) {
+            options.optimize = stoi(argv[i] + 2);
+        }
+        else if (strcmp(argv[i], "--peephole") == 0) {
+            options.peephole = PEEPHOLE_ALL;
+        }
+        else if (strncmp(argv[i], "--peephole=", 11) == 0) {
+            options.peephole = peephole_rules(argv[i] + 11);
+        }
+        else if (strncmp(argv[i], "--unroll=", 9) == 0) {
+            options.unroll = stoi(argv[i] + 9);
+        }
+        else if (strcmp(argv[i], "-c") == 0) {
+            options.compileOnly = true;
+        }
+        else if (strcmp(argv[i], "--bytecode") == 0) {
+            options.bytecode = true;
+        }
+        else if (strcmp(argv[i], "--disassemble") == 0) {
+            options.disassemble = true;
         }
+        else if (strcmp(argv[i], "--stream") == 0) {
+            options.stream = true;
+        }
+        else if (strcmp(argv[i], "--cfg") == 0) {
+            options.cfg = true;
+        }
+        else if (strcmp(argv[i], "--run") == 0) {
+            options.run = true;
+        }
+        else if (strcmp(argv[i], "--link") == 0 && i + 1 < argc) {
+            options.linkOutput = argv[++i];
+        }
+        else if (argv[i][0] == '-') {
+            throw runtime_error(string("Unknown option ") + argv[i]);
+        }
+        else {
+            options.files.push_back(argv[i]);
+        }
+    }
+    if (options.optimize >= 2) {
+        options.peephole = PEEPHOLE_ALL;
+    }
+    if (options.stream && (options.optimize || options.peephole || options.compileOnly || options.cfg || options.run)) {
+        throw runtime_error("--stream writes unoptimized listings and bytecode only");
+    }
+    if (options.linkOutput.empty() && options.files.size() % 2 != 0) {
+        throw runtime_error("Expected input and output file names in pairs");
+    }
+    return options;
+}
+
+//lexes FILE_NAME, parses it and writes the instruction and symbol tables to RPD_File
+int compile(const string& FILE_NAME, const string& RPD_File, const Options& options, Compilation_Arena& arena) {
+    FILE* filePointer = fopen(FILE_NAME.c_str(), "r");
 
-        outFile << "                   " << left << setw(35) << type << tokens[i].value << endl;
+    if (!filePointer) {
+        std::cout << "Error: Cannot open file " << FILE_NAME << std::endl;
+        return 1;
     }
 
+    //the output is written to a temporary file that replaces RPD_File only
+    //when the compile succeeds, a failed -c must not leave an object file
+    //that looks up to date
+    string partialFile = RPD_File + ".part";
     try {
-        // Get RPD filename from user
-        string RPD_File;
-        cout << "Please enter the file name (o1.txt, o2.txt, o3.txt, o4.txt, o5.txt): ";
-        cin >> RPD_File;
-        
         // Open output files
-        ofstream symbol_assembly_file(RPD_File);
+        ofstream symbol_assembly_file(partialFile, options.bytecode ? ios::out | ios::binary : ios::out);
         if (!symbol_assembly_file.is_open()) {
             throw runtime_error("Failed to open RPD output file");
         }
@@ -89,20 +183,228 @@ int main(){
             throw runtime_error("Failed to open syntax output file");
         }
 
+        //get's file name and writes to file
+        string outputFileName = "Lexical_Analysis_Output.txt";
+        ofstream outFile(outputFileName);
+        if (!outFile) {
+            throw runtime_error("Error opening output file for writing");
+        }
+        write_lexical_header(outFile);
+
+        auto start = chrono::steady_clock::now();
+        size_t heapBefore = heapAllocations.load(memory_order_relaxed);
+
         // Initialize analyzer with both streams
-        SyntaxAnalyzer analyzer(outSyn_A_File, symbol_assembly_file);
-        
-        // Process files
-        analyzer.readFile("Lexical_Analysis_Output.txt", 4); 
-        analyzer.Rat25S();
-        analyzer.display_RPD();
+        SyntaxAnalyzer analyzer(outSyn_A_File, symbol_assembly_file, options.traceRing, arena.resource());
+        if (options.compileOnly) {
+            analyzer.object_code();
+        }
+
+        unique_ptr<Instruction_Sink> sink;
+        if (options.stream) {
+            if (options.bytecode) {
+                sink = make_unique<Bytecode_Sink>(symbol_assembly_file);
+            }
+            else {
+                sink = make_unique<Listing_Sink>(symbol_assembly_file);
+            }
+            analyzer.stream(*sink);
+        }
+
+        if (options.pipelined) {
+            //lexer thread feeds the parser while it writes Lexical_Analysis_Output.txt
+            Token_Pipeline pipeline(filePointer, &outFile);
+            analyzer.readPipeline(pipeline);
+            analyzer.Rat25S();
+        }
+        else {
+            //initializes class and vector
+            LexicalAnalyzer la;
+            pmr::vector<Token> tokens(arena.resource());
+
+            //calls lexer and pushes tokens inside the vector
+            while (true) {
+                Token token = la.lexer(filePointer);
+                if (token.value.empty()) {
+                    break;
+                }
+                tokens.push_back(std::move(token));
+            }
+
+            //outputs using the vector
+            for (size_t i = 0; i < tokens.size(); ++i) {
+                write_lexical_row(outFile, tokens[i]);
+            }
+            outFile.close();
+
+            //the parser takes the vector as it is, the output file is only a trace
+            analyzer.readTokens(std::move(tokens));
+            analyzer.Rat25S();
+        }
+
+        auto elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start);
+        if (options.timing) {
+            cout << "\nlex + parse (" << (options.pipelined ? "pipelined" : "sequential") << "): "
+                 << elapsed.count() << " ms" << endl;
+        }
+        if (options.dumpTrace) {
+            analyzer.dump_trace();
+        }
+
+        analyzer.optimize(options.optimize, options.peephole, options.stats ? &cout : nullptr, options.unroll,
+                          options.compileOnly);
+        analyzer.verify();
+
+        if (options.cfg) {
+            ofstream dot(RPD_File + ".dot");
+            if (!dot.is_open()) {
+                throw runtime_error("Failed to open control flow graph file");
+            }
+            analyzer.write_cfg(dot);
+        }
+
+        if (options.compileOnly) {
+            analyzer.write_object(symbol_assembly_file);
+        }
+        else if (options.bytecode) {
+            analyzer.write_bytecode(symbol_assembly_file);
+        }
+        else {
+            analyzer.display_RPD();
+        }
+        symbol_assembly_file.close();
+        if (!symbol_assembly_file) {
+            throw runtime_error("Failed to write " + RPD_File);
+        }
+        filesystem::rename(partialFile, RPD_File);
+
+        if (options.run) {
+            Interpreter::Execution executed = analyzer.run(cin, cout);
+            if (options.stats) {
+                cout << "executed: " << executed.instructions << " instructions\tjumps: " << executed.jumps
+                     << "\tcost: " << executed.cost << "\n";
+            }
+        }
+
+        if (options.stats) {
+            elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start);
+            cout << FILE_NAME << ": " << elapsed.count() << " ms\t";
+            arena.write_stats(cout, heapAllocations.load(memory_order_relaxed) - heapBefore);
+        }
 
         // Files will auto-close when going out of scope
-    } 
+    }
+    catch (const exception& e) {
+        fclose(filePointer);
+        error_code ec;
+        filesystem::remove(partialFile, ec);
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+
+    fclose(filePointer);
+    return 0;
+}
+
+//an object file newer than its source does not need to be compiled again
+bool up_to_date(const string& source, const string& object) {
+    error_code ec;
+    auto objectTime = filesystem::last_write_time(object, ec);
+    if (ec) {
+        return false;
+    }
+    auto sourceTime = filesystem::last_write_time(source, ec);
+    return !ec && objectTime >= sourceTime;
+}
+
+//links the object files in options.files into one instruction and symbol table
+int link(const Options& options) {
+    try {
+        Linker linker;
+        for (const auto& objectName : options.files) {
+            ifstream objectFile(objectName);
+            if (!objectFile.is_open()) {
+                throw runtime_error("Cannot open object file " + objectName);
+            }
+            linker.add(Object_File::read(objectFile));
+        }
+
+        ofstream symbol_assembly_file(options.linkOutput);
+        if (!symbol_assembly_file.is_open()) {
+            throw runtime_error("Failed to open RPD output file");
+        }
+
+        Symbol_and_Assembly program(symbol_assembly_file);
+        program.load(linker.finish());
+        program.verify();
+        program.display_instructions();
+        program.display_constant_pool();
+        program.display_symbol_table();
+    }
     catch (const exception& e) {
         cerr << "Error: " << e.what() << endl;
         return 1;
     }
+    return 0;
+}
 
+//writes the listing of a bytecode file
+int disassemble(const string& bytecodeName, const string& listingName) {
+    try {
+        Bytecode_Image image(bytecodeName);
+        ofstream listing(listingName);
+        if (!listing.is_open()) {
+            throw runtime_error("Failed to open RPD output file");
+        }
+        image.disassemble(listing);
+    }
+    catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
     return 0;
 }
+
+int main(int argc, char* argv[]){
+
+    Options options;
+    try {
+        options = parse_options(argc, argv);
+    }
+    catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+
+    if (!options.linkOutput.empty()) {
+        return link(options);
+    }
+
+    if (options.files.empty()) {
+        //get's file names from the user
+        string FILE_NAME, RPD_File;
+        cout << "Please enter the file name (t1.txt, t2.txt, t3.txt, t4.txt, t5.txt): ";
+        cin >> FILE_NAME;
+        cout << "Please enter the file name (o1.txt, o2.txt, o3.txt, o4.txt, o5.txt): ";
+        cin >> RPD_File;
+        options.files = { FILE_NAME, RPD_File };
+    }
+
+    //one arena for the whole run, reset between inputs
+    Compilation_Arena arena(options.arena);
+    int status = 0;
+    for (size_t i = 0; i < options.files.size(); i += 2) {
+        if (options.disassemble) {
+            status |= disassemble(options.files[i], options.files[i + 1]);
+            continue;
+        }
+        if (options.compileOnly && up_to_date(options.files[i], options.files[i + 1])) {
+            cout << options.files[i + 1] << " is up to date" << endl;
+            continue;
+        }
+        status |= compile(options.files[i], options.files[i + 1], options, arena);
+        arena.reset();
+    }
+
+    return status;
+}
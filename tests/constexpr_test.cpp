@@ -0,0 +1,60 @@
+//compiles every program run.sh lists with compile_rat25s and compares the
+//instruction table and constant pool with the listing rat25s writes for it
+//(o1..o5 for t1..t5), so the constexpr parser cannot drift from SyntaxAnalyzer
+//built by tests/run.sh, which wraps each program in a raw string literal as
+//NAME.inc and writes programs.inc, defining program_NAME for each one, and
+//checks.inc, calling check() for each one
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../Constexpr_Compiler.h"
+#include "../Listing.h"
+using namespace std;
+
+#include "programs.inc"
+
+//the part of listing from the line starting with begin up to the one starting with end
+static string section(const string& listing, const string& begin, const string& end) {
+    size_t from = listing.find("\n" + begin);
+    if (from == string::npos) {
+        return "";
+    }
+    size_t to = listing.find("\n" + end, from + 1);
+    return listing.substr(from, to == string::npos ? string::npos : to - from);
+}
+
+template <typename Program>
+static bool check(const string& name, const Program& program, const string& listingFile) {
+    ifstream file(listingFile);
+    if (!file) {
+        cerr << name << ": cannot open " << listingFile << "\n";
+        return false;
+    }
+    stringstream expected;
+    expected << file.rdbuf();
+
+    //the pool entries PUSHF refers to are listed as reals
+    vector<char> reals(program.constants.size(), 0);
+    for (const Instruction& instr : program.code) {
+        if (instr.Operator == Opcode::PUSHF) {
+            reals[instr.Operand] = 1;
+        }
+    }
+    ostringstream code, constants;
+    write_instruction_listing(code, program.code);
+    write_constant_listing(constants, program.constants, reals);
+    bool same = code.str() == section(expected.str(), "=== INSTRUCTION TABLE", "===") &&
+                constants.str() == section(expected.str(), "=== CONSTANT POOL", "===");
+    if (!same) {
+        cerr << name << ": compile_rat25s differs from " << listingFile << "\n" << code.str() << constants.str();
+    }
+    return same;
+}
+
+int main() {
+    bool passed = true;
+#include "checks.inc"
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+#!/bin/bash
+# tests/run.sh [rat25s]: the listings of t1..t5 against o1..o5, the same
+# streamed, compile_rat25s against the listings of t1..t5 and of the
+# programs in tests/ (tests/constexpr_test.cpp), programs cut short,
+# separately compiled files linked together and the programs in tests/
+# runs in a temporary directory, rat25s writes its trace files to the current one
+cd "$(dirname "$0")/.." || exit 1
+ROOT=$(pwd)
+RAT25S=$(realpath "${1:-rat25s}")
+CXX=${CXX:-g++}
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+failed=0
+
+fail() {
+    echo "FAIL $1"
+    failed=1
+}
+
+cd "$WORK" || exit 1
+for i in 1 2 3 4 5; do
+    if ! "$RAT25S" "$ROOT/t$i.txt" "out$i.txt" >/dev/null 2>&1 || ! diff -q "out$i.txt" "$ROOT/o$i.txt" >/dev/null; then
+        fail "t$i listing"
+    fi
+done
+
+# --stream writes the same listing and bytecode, checked block by block
+for program in "$ROOT"/t[1-5].txt "$ROOT"/tests/*.txt; do
+    name=$(basename "$program" .txt)
+    "$RAT25S" "$program" whole.txt >/dev/null 2>&1 || continue
+    "$RAT25S" --stream "$program" streamed.txt >/dev/null 2>&1
+    diff -q whole.txt streamed.txt >/dev/null || fail "$name --stream listing"
+    "$RAT25S" --bytecode "$program" whole.bin >/dev/null 2>&1 &&
+        "$RAT25S" --disassemble whole.bin whole.txt >/dev/null 2>&1
+    "$RAT25S" --stream --bytecode "$program" streamed.bin >/dev/null 2>&1 &&
+        "$RAT25S" --disassemble streamed.bin streamed.txt >/dev/null 2>&1
+    diff -q whole.txt streamed.txt >/dev/null || fail "$name --stream --bytecode"
+done
+
+# a program cut short before its last $$ fails with a diagnostic, and does not
+# hang or fill the disk with its trace
+for program in "$ROOT"/t[1-5].txt; do
+    name=$(basename "$program" .txt)
+    last=$(grep -n '\$\$' "$program" | tail -1 | cut -d: -f1)
+    for ((lines = 1; lines < last; lines++)); do
+        head -n $lines "$program" > cut.txt
+        for mode in "" --pipeline; do
+            timeout 10 "$RAT25S" $mode cut.txt cut.lst > /dev/null 2> err.txt
+            status=$?
+            [ $status = 1 ] && grep -q "^Error: " err.txt ||
+                fail "$name cut after line $lines ${mode:-sequential}: exit $status"
+        done
+    done
+done
+
+# compile_rat25s of each program rat25s compiles, as a raw string literal,
+# against its listing
+: > programs.inc
+: > checks.inc
+for program in "$ROOT"/t[1-5].txt "$ROOT"/tests/*.txt; do
+    name=$(basename "$program" .txt)
+    listing="$name.lst"
+    case $name in t[1-5]) listing="$ROOT/o${name#t}.txt" ;; esac
+    "$RAT25S" "$program" "$name.lst" >/dev/null 2>&1 || continue
+    { printf 'R"rat25s('; cat "$program"; printf ')rat25s"\n'; } > "$name.inc"
+    printf 'constexpr auto program_%s = compile_rat25s<\n#include "%s.inc"\n>();\n' "$name" "$name" >> programs.inc
+    printf 'passed &= check("%s", program_%s, "%s");\n' "$name" "$name" "$listing" >> checks.inc
+done
+if ! $CXX -std=c++20 -fconstexpr-ops-limit=1000000000 -fconstexpr-loop-limit=100000000 -I "$WORK" \
+        "$ROOT/tests/constexpr_test.cpp" -o constexpr_test; then
+    fail "constexpr_test build"
+elif ! ./constexpr_test; then
+    fail "constexpr_test"
+fi
+
+# tests/link: app.txt calls functions of lib.txt, each compiled with -c,
+# and they link into linked.lst; NAME.txt calling lib.txt wrongly fails to
+# link with NAME.err
+LINK="$ROOT/tests/link"
+if "$RAT25S" -c -O2 "$LINK/app.txt" app.o "$LINK/lib.txt" lib.o >/dev/null 2>&1 &&
+        "$RAT25S" --link linked.lst app.o lib.o >/dev/null 2>&1; then
+    diff -q linked.lst "$LINK/linked.lst" >/dev/null || fail "link listing"
+else
+    fail "link"
+fi
+for expected in "$LINK"/*.err; do
+    name=$(basename "$expected" .err)
+    "$RAT25S" -c "$LINK/$name.txt" "$name.o" >/dev/null 2>&1 || fail "link $name compile"
+    "$RAT25S" --link "$name.lst" "$name.o" lib.o >/dev/null 2> err.txt && fail "link $name"
+    diff -q err.txt "$expected" >/dev/null || fail "link $name error"
+done
+
+# tests/NAME.txt runs with --run at -O0, -O1 and -O2, reading tests/NAME.in
+# when there is one; what it prints has to be tests/NAME.out, and with
+# tests/NAME.err the run has to fail with that message
+# each line of tests/NAME.stats has to be in what -O1 --stats prints, and each
+# line of tests/NAME.listing in the -O1 listing
+for program in "$ROOT"/tests/*.txt; do
+    name=$(basename "$program" .txt)
+    expected="$ROOT/tests/$name"
+    input=/dev/null
+    [ -f "$expected.in" ] && input="$expected.in"
+    for level in -O0 -O1 -O2; do
+        "$RAT25S" $level --run "$program" "$name.lst" < "$input" > out.txt 2> err.txt
+        status=$?
+        if [ -f "$expected.err" ]; then
+            [ $status != 0 ] && diff -q err.txt "$expected.err" >/dev/null || fail "$name $level error"
+        else
+            [ $status = 0 ] || fail "$name $level exit $status: $(cat err.txt)"
+        fi
+        if [ -f "$expected.out" ] && ! diff -q out.txt "$expected.out" >/dev/null; then
+            fail "$name $level output"
+            diff out.txt "$expected.out" | head -10
+        fi
+    done
+    if [ -f "$expected.stats" ]; then
+        "$RAT25S" -O1 --stats --run "$program" "$name.lst" < "$input" > stats.txt 2>&1
+        while IFS= read -r line; do
+            grep -qxF "$line" stats.txt || fail "$name stats: $line"
+        done < "$expected.stats"
+    fi
+    if [ -f "$expected.listing" ]; then
+        "$RAT25S" -O1 "$program" "$name.lst" >/dev/null 2>&1
+        while IFS= read -r line; do
+            grep -qxF "$line" "$name.lst" || fail "$name listing: $line"
+        done < "$expected.listing"
+    fi
+done
+
+[ $failed = 0 ] && echo "tests passed"
+exit $failed